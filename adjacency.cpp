@@ -0,0 +1,206 @@
+#include "adjacency.h"
+#include "edges.h"
+#include "parallel.h"
+#include "radix_sort.h"
+#include <algorithm>
+#include <cstdint>
+
+// Function to count the bits needed to store values below count
+static int bitsFor(size_t count) {
+    int bits = 1;
+    while (bits < 64 && (static_cast<uint64_t>(1) << bits) < count) {
+        bits++;
+    }
+    return bits;
+}
+
+// Function to turn sorted keys, whose row sits above bit rowShift, into CSR
+// offsets. Row r starts at the first key in row r or later; every row change
+// fills the offsets of the rows it skips.
+static void fillRowOffsets(const std::vector<uint64_t>& keys, int rowShift, size_t rowCount,
+                           std::vector<unsigned int>& offsets) {
+    const size_t entryCount = keys.size();
+    offsets.resize(rowCount + 1);
+    parallelFor(entryCount + 1, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint64_t previous = (i == 0) ? 0 : (keys[i - 1] >> rowShift) + 1;
+            uint64_t current = (i == entryCount) ? rowCount : (keys[i] >> rowShift);
+            for (uint64_t r = previous; r <= current; ++r) {
+                offsets[r] = static_cast<unsigned int>(i);
+            }
+        }
+    });
+}
+
+Adjacency buildVertexFaceAdjacency(size_t vertexCount, const FaceArray& faces) {
+    Adjacency adjacency;
+    const size_t entryCount = faces.size() * 3;
+    std::vector<uint64_t> keys(entryCount);
+    adjacency.indices.resize(entryCount);
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            keys[f * 3 + 0] = static_cast<uint64_t>(faces[f].v1);
+            keys[f * 3 + 1] = static_cast<uint64_t>(faces[f].v2);
+            keys[f * 3 + 2] = static_cast<uint64_t>(faces[f].v3);
+            for (int k = 0; k < 3; ++k) {
+                adjacency.indices[f * 3 + k] = static_cast<unsigned int>(f);
+            }
+        }
+    });
+
+    // Stable sort by vertex keeps each row in face order
+    radixSortPairs64(keys, adjacency.indices, 0, bitsFor(vertexCount));
+
+    fillRowOffsets(keys, 0, vertexCount, adjacency.offsets);
+    return adjacency;
+}
+
+Adjacency buildVertexAdjacency(size_t vertexCount, const FaceArray& faces) {
+    Adjacency adjacency;
+    std::vector<Edge> edges = extractUniqueEdges(faces);
+    // Degenerate faces produce edges from a vertex to itself
+    edges.erase(std::remove_if(edges.begin(), edges.end(), [](const Edge& e) { return e.v0 == e.v1; }), edges.end());
+
+    // Both directions of every edge as (row << 32 | neighbor), sorted as a whole
+    std::vector<uint64_t> keys(edges.size() * 2);
+    parallelFor(edges.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t e = begin; e < end; ++e) {
+            uint64_t a = static_cast<uint32_t>(edges[e].v0);
+            uint64_t b = static_cast<uint32_t>(edges[e].v1);
+            keys[e * 2 + 0] = (a << 32) | b;
+            keys[e * 2 + 1] = (b << 32) | a;
+        }
+    });
+    int bits = bitsFor(vertexCount);
+    radixSort64(keys, 0, 32 + bits);
+
+    adjacency.indices.resize(keys.size());
+    parallelFor(keys.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            adjacency.indices[i] = static_cast<unsigned int>(keys[i] & 0xffffffffu);
+        }
+    });
+    fillRowOffsets(keys, 32, vertexCount, adjacency.offsets);
+    return adjacency;
+}
+
+static uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Random but fixed priority; the index in the low bits makes every priority unique
+static uint64_t colorPriority(unsigned int v) {
+    return (static_cast<uint64_t>(hash32(v)) << 32) | v;
+}
+
+// Function to find the smallest color no colored neighbor of v uses,
+// scanning the colors 64 at a time
+static int smallestFreeColor(const Adjacency& graph, const std::vector<int>& colors, unsigned int v) {
+    for (int base = 0;; base += 64) {
+        uint64_t used = 0;
+        for (unsigned int k = graph.offsets[v]; k < graph.offsets[v + 1]; ++k) {
+            int c = colors[graph.indices[k]] - base;
+            if (c >= 0 && c < 64) {
+                used |= static_cast<uint64_t>(1) << c;
+            }
+        }
+        if (used != ~static_cast<uint64_t>(0)) {
+            int bit = 0;
+            while (used & (static_cast<uint64_t>(1) << bit)) {
+                bit++;
+            }
+            return base + bit;
+        }
+    }
+}
+
+GraphColoring colorGraph(const Adjacency& graph) {
+    GraphColoring coloring;
+    const size_t vertexCount = graph.offsets.empty() ? 0 : graph.offsets.size() - 1;
+    coloring.colors.assign(vertexCount, -1);
+    std::vector<int>& colors = coloring.colors;
+
+    std::vector<unsigned int> remaining(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        remaining[v] = static_cast<unsigned int>(v);
+    }
+    std::vector<unsigned int> next;
+    std::vector<unsigned char> winner;
+
+    const size_t kBlockSize = 4096;
+    while (!remaining.empty()) {
+        // Pick the local maxima first and color them in a second pass. Winners
+        // are never adjacent, so each one reads only colors that stay fixed.
+        winner.assign(remaining.size(), 0);
+        parallelFor(remaining.size(), 1 << 12, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                unsigned int v = remaining[i];
+                uint64_t priority = colorPriority(v);
+                bool isMax = true;
+                for (unsigned int k = graph.offsets[v]; k < graph.offsets[v + 1] && isMax; ++k) {
+                    unsigned int u = graph.indices[k];
+                    isMax = colors[u] >= 0 || colorPriority(u) < priority;
+                }
+                winner[i] = isMax ? 1 : 0;
+            }
+        });
+        parallelFor(remaining.size(), 1 << 12, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (winner[i]) {
+                    colors[remaining[i]] = smallestFreeColor(graph, colors, remaining[i]);
+                }
+            }
+        });
+
+        // Keep the uncolored vertices in order, one output range per block
+        size_t blockCount = (remaining.size() + kBlockSize - 1) / kBlockSize;
+        std::vector<size_t> blockOffsets(blockCount + 1, 0);
+        parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t last = std::min(remaining.size(), (b + 1) * kBlockSize);
+                size_t count = 0;
+                for (size_t i = b * kBlockSize; i < last; ++i) {
+                    count += winner[i] ? 0 : 1;
+                }
+                blockOffsets[b + 1] = count;
+            }
+        });
+        for (size_t b = 0; b < blockCount; ++b) {
+            blockOffsets[b + 1] += blockOffsets[b];
+        }
+        next.resize(blockOffsets[blockCount]);
+        parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t last = std::min(remaining.size(), (b + 1) * kBlockSize);
+                size_t out = blockOffsets[b];
+                for (size_t i = b * kBlockSize; i < last; ++i) {
+                    if (!winner[i]) {
+                        next[out++] = remaining[i];
+                    }
+                }
+            }
+        });
+        remaining.swap(next);
+    }
+
+    // Group the vertices by color, in vertex order within each class
+    for (size_t v = 0; v < vertexCount; ++v) {
+        coloring.colorCount = std::max(coloring.colorCount, colors[v] + 1);
+    }
+    std::vector<uint64_t> keys(vertexCount);
+    coloring.classes.indices.resize(vertexCount);
+    parallelFor(vertexCount, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            keys[v] = static_cast<uint64_t>(colors[v]);
+            coloring.classes.indices[v] = static_cast<unsigned int>(v);
+        }
+    });
+    radixSortPairs64(keys, coloring.classes.indices, 0, bitsFor(coloring.colorCount));
+    fillRowOffsets(keys, 0, coloring.colorCount, coloring.classes.offsets);
+    return coloring;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "mesh.h"
+
+// Compressed sparse rows: the entries of row i are indices[offsets[i], offsets[i + 1])
+struct Adjacency {
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> indices;
+};
+
+// Function to list the faces around every vertex, in increasing face order.
+// Built with one radix sort of (vertex, face) pairs, so it is cheap enough to
+// rebuild after every topology change and cache in between.
+Adjacency buildVertexFaceAdjacency(size_t vertexCount, const FaceArray& faces);
+
+// Function to list the distinct neighbors of every vertex (the vertices it
+// shares an edge with), each row sorted by vertex index
+Adjacency buildVertexAdjacency(size_t vertexCount, const FaceArray& faces);
+
+// A proper coloring of a graph: no two adjacent vertices share a color.
+// The vertices of color c are classes.indices[classes.offsets[c], classes.offsets[c + 1]).
+struct GraphColoring {
+    std::vector<int> colors;
+    Adjacency classes;
+    int colorCount = 0;
+};
+
+// Function to color a symmetric graph with the parallel Jones-Plassmann
+// algorithm: each round, every uncolored vertex whose random priority beats
+// all its uncolored neighbors takes the smallest color its neighbors do not
+// use. The result is deterministic and uses at most maxDegree + 1 colors.
+GraphColoring colorGraph(const Adjacency& graph);
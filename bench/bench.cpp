@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "adjacency.h"
+#include "generators.h"
+#include "mesh.h"
+#include "mesh_io.h"
+#include "parallel.h"
+#include "scratch.h"
+#include "smoothing.h"
+
+// Benchmarks every mesh kernel over bunny.obj and generated meshes, at each
+// requested thread count, and optionally compares the medians against an
+// earlier run to catch regressions.
+//
+// Usage: bench [--mesh bunny.obj] [--shape knot] [--sizes 10000,100000,1000000]
+//              [--full] [--generate icosphere:20M,...] [--threads 1,8] [--min-time 0.25] [--json results.json]
+//              [--compare baseline.json] [--tolerance 0.1]
+
+// Synthetic meshes above this size are not written out to time loadOBJ
+const size_t kOBJMaxFaces = 10000000;
+
+struct BenchMesh {
+    std::string name;
+    VertexArray vertices;
+    FaceArray faces;
+    std::string objPath; // empty if loadOBJ is not timed on this mesh
+    bool temporaryOBJ = false;
+};
+
+struct BenchResult {
+    std::string kernel;
+    std::string mesh;
+    size_t faces = 0;
+    unsigned int threads = 0;
+    size_t repetitions = 0;
+    double minMs = 0, p50Ms = 0, p90Ms = 0, p99Ms = 0, maxMs = 0;
+    double elementsPerSecond = 0;
+    double gigabytesPerSecond = 0;
+    // Heap allocations per repetition, after the warm-up
+    double allocationsPerRun = 0;
+};
+
+struct BenchOptions {
+    std::string meshPath = "bunny.obj";
+    std::string shape = "knot";
+    std::vector<size_t> sizes = {10000, 100000, 1000000};
+    std::vector<std::string> generated;
+    std::vector<unsigned int> threadCounts;
+    double minSeconds = 0.25;
+    std::string jsonPath;
+    std::string comparePath;
+    double tolerance = 0.1;
+};
+
+// Function to write a mesh as OBJ for the loader benchmark. loadOBJ scales
+// positions on the way in, which does not matter for timing.
+static bool writeBenchOBJ(const std::string& path, const VertexArray& vertices, const FaceArray& faces) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    for (const Vertex& v : vertices) {
+        std::fprintf(file, "v %.6f %.6f %.6f\n", v.x, v.y, v.z);
+    }
+    for (const Face& f : faces) {
+        std::fprintf(file, "f %d %d %d\n", f.v1 + 1, f.v2 + 1, f.v3 + 1);
+    }
+    return std::fclose(file) == 0;
+}
+
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// Function to time run until it has taken minSeconds and at least three
+// repetitions, after one untimed warm-up. elements and bytes are per
+// repetition; bytes counts each input read and each output written once.
+static BenchResult timeKernel(const std::string& kernel, const BenchMesh& mesh, size_t elements, double bytes,
+                              double minSeconds, const std::function<void()>& run) {
+    run();
+    std::vector<double> times;
+    times.reserve(1000);
+    double total = 0.0;
+    AllocationCounters allocationStart = allocationCounters();
+    while (times.size() < 3 || (total < minSeconds && times.size() < 1000)) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        times.push_back(seconds);
+        total += seconds;
+    }
+    AllocationCounters allocations = allocationsSince(allocationStart);
+    std::sort(times.begin(), times.end());
+
+    BenchResult result;
+    result.kernel = kernel;
+    result.mesh = mesh.name;
+    result.faces = mesh.faces.size();
+    result.threads = parallelThreadCount();
+    result.repetitions = times.size();
+    result.minMs = times.front() * 1e3;
+    result.p50Ms = percentile(times, 0.5) * 1e3;
+    result.p90Ms = percentile(times, 0.9) * 1e3;
+    result.p99Ms = percentile(times, 0.99) * 1e3;
+    result.maxMs = times.back() * 1e3;
+    result.elementsPerSecond = elements / percentile(times, 0.5);
+    result.gigabytesPerSecond = bytes / percentile(times, 0.5) / 1e9;
+    result.allocationsPerRun = static_cast<double>(allocations.allocations) / times.size();
+    return result;
+}
+
+static void printResult(const BenchResult& r) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-22s %-14s %3u  %9.3f %9.3f %9.3f %9.3f  %10.3g  %7.2f  %7.1f  (%zu reps)",
+                  r.kernel.c_str(), r.mesh.c_str(), r.threads, r.minMs, r.p50Ms, r.p90Ms, r.p99Ms,
+                  r.elementsPerSecond, r.gigabytesPerSecond, r.allocationsPerRun, r.repetitions);
+    std::cout << line << std::endl;
+}
+
+// Function to run every kernel on one mesh at the current thread count
+static void benchMesh(const BenchMesh& mesh, double minSeconds, std::vector<BenchResult>& results) {
+    const size_t V = mesh.vertices.size();
+    const size_t F = mesh.faces.size();
+    const double vertexBytes = sizeof(Vertex) * static_cast<double>(V);
+    const double faceBytes = sizeof(Face) * static_cast<double>(F);
+    auto add = [&](const BenchResult& result) {
+        printResult(result);
+        results.push_back(result);
+    };
+
+    if (!mesh.objPath.empty()) {
+        double fileBytes = static_cast<double>(std::filesystem::file_size(mesh.objPath));
+        add(timeKernel("loadOBJ", mesh, F, fileBytes, minSeconds, [&]() {
+            VertexArray vertices;
+            FaceArray faces;
+            loadOBJ(mesh.objPath, vertices, faces);
+        }));
+    }
+
+    std::vector<Normal> faceNormals(F);
+    add(timeKernel("faceNormals", mesh, F, faceBytes + vertexBytes + sizeof(Normal) * static_cast<double>(F),
+                   minSeconds, [&]() { calculateFaceNormals(mesh.vertices, mesh.faces, faceNormals.data()); }));
+
+    std::vector<Normal> vertexNormals;
+    add(timeKernel("vertexNormals", mesh, F, faceBytes + 2 * vertexBytes, minSeconds,
+                   [&]() { calculateVertexNormals(mesh.vertices, mesh.faces, vertexNormals); }));
+
+    VertexArray vertices = mesh.vertices;
+    add(timeKernel("addNoiseToVertices", mesh, V, 3 * vertexBytes, minSeconds,
+                   [&]() { addNoiseToVertices(vertices, vertexNormals, 0.001f); }));
+
+    vertices = mesh.vertices;
+    add(timeKernel("laplacianSmoothing", mesh, V, faceBytes + 3 * vertexBytes, minSeconds,
+                   [&]() { laplacianSmoothing(vertices, mesh.faces, 0.5f); }));
+
+    SmoothingGraph graph;
+    graph.neighbors = buildVertexAdjacency(V, mesh.faces);
+    graph.coloring = colorGraph(graph.neighbors);
+    double graphBytes = sizeof(int) * static_cast<double>(graph.neighbors.indices.size() + graph.neighbors.offsets.size());
+    vertices = mesh.vertices;
+    add(timeKernel("gaussSeidelSmoothing", mesh, V, graphBytes + 2 * vertexBytes, minSeconds,
+                   [&]() { gaussSeidelSmoothing(vertices, graph.neighbors, graph.coloring, 0.5f); }));
+
+    std::vector<float> meshData;
+    add(timeKernel("packVertexData", mesh, V, 4 * vertexBytes, minSeconds,
+                   [&]() { packVertexData(mesh.vertices, vertexNormals, meshData); }));
+}
+
+static void writeResultJSON(std::ostream& out, const BenchResult& r) {
+    out << "{\"kernel\":\"" << r.kernel << "\",\"mesh\":\"" << r.mesh << "\",\"faces\":" << r.faces
+        << ",\"threads\":" << r.threads << ",\"repetitions\":" << r.repetitions << ",\"min_ms\":" << r.minMs
+        << ",\"p50_ms\":" << r.p50Ms << ",\"p90_ms\":" << r.p90Ms << ",\"p99_ms\":" << r.p99Ms
+        << ",\"max_ms\":" << r.maxMs << ",\"elements_per_s\":" << r.elementsPerSecond
+        << ",\"gb_per_s\":" << r.gigabytesPerSecond << ",\"allocations\":" << r.allocationsPerRun << "}";
+}
+
+// Function to write the results as JSON, one result per line
+static bool writeResults(const std::vector<BenchResult>& results, const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    file.precision(6);
+    file << "{\"hardware_threads\":" << std::max(1u, std::thread::hardware_concurrency()) << ",\"results\":[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        writeResultJSON(file, results[i]);
+        file << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    file << "]}\n";
+    return static_cast<bool>(file);
+}
+
+// Function to find "key": in a line written by writeResultJSON and read the value after it
+static std::string jsonField(const std::string& line, const std::string& key) {
+    std::string pattern = "\"" + key + "\":";
+    size_t at = line.find(pattern);
+    if (at == std::string::npos) {
+        return "";
+    }
+    at += pattern.size();
+    if (line[at] == '"') {
+        size_t end = line.find('"', at + 1);
+        return line.substr(at + 1, end - at - 1);
+    }
+    size_t end = line.find_first_of(",}", at);
+    return line.substr(at, end - at);
+}
+
+// Function to compare the medians against a baseline written by an earlier
+// run. Returns the number of kernels that got slower by more than tolerance.
+static int compareResults(const std::vector<BenchResult>& results, const std::string& path, double tolerance) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return -1;
+    }
+    int regressions = 0;
+    size_t matched = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string kernel = jsonField(line, "kernel");
+        if (kernel.empty()) {
+            continue;
+        }
+        std::string mesh = jsonField(line, "mesh");
+        unsigned int threads = static_cast<unsigned int>(std::atoi(jsonField(line, "threads").c_str()));
+        double baseline = std::atof(jsonField(line, "p50_ms").c_str());
+        for (const BenchResult& r : results) {
+            if (r.kernel != kernel || r.mesh != mesh || r.threads != threads || baseline <= 0.0) {
+                continue;
+            }
+            matched++;
+            double change = r.p50Ms / baseline - 1.0;
+            if (change > tolerance) {
+                regressions++;
+                std::cout << "REGRESSION " << kernel << " on " << mesh << " with " << threads << " threads: "
+                          << baseline << " ms -> " << r.p50Ms << " ms (+" << change * 100.0 << "%)" << std::endl;
+            } else if (change < -tolerance) {
+                std::cout << "improved   " << kernel << " on " << mesh << " with " << threads << " threads: "
+                          << baseline << " ms -> " << r.p50Ms << " ms (" << change * 100.0 << "%)" << std::endl;
+            }
+        }
+    }
+    std::cout << "Compared " << matched << " results against " << path << ": " << regressions
+              << " regressions beyond " << tolerance * 100.0 << "%." << std::endl;
+    return regressions;
+}
+
+template <typename T>
+static std::vector<T> parseList(const std::string& text) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(static_cast<T>(std::strtoull(item.c_str(), nullptr, 10)));
+    }
+    return values;
+}
+
+static std::string sizeName(size_t faces) {
+    if (faces % 1000000 == 0) {
+        return std::to_string(faces / 1000000) + "M";
+    }
+    if (faces % 1000 == 0) {
+        return std::to_string(faces / 1000) + "K";
+    }
+    return std::to_string(faces);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--mesh" && i + 1 < argc) {
+            options.meshPath = argv[++i];
+        } else if (arg == "--shape" && i + 1 < argc) {
+            options.shape = argv[++i];
+        } else if (arg == "--generate" && i + 1 < argc) {
+            std::stringstream specs(argv[++i]);
+            std::string spec;
+            while (std::getline(specs, spec, ',')) {
+                options.generated.push_back(spec);
+            }
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            options.sizes = parseList<size_t>(argv[++i]);
+        } else if (arg == "--full") {
+            options.sizes = {10000, 100000, 1000000, 10000000, 50000000};
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threadCounts = parseList<unsigned int>(argv[++i]);
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.minSeconds = std::atof(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.jsonPath = argv[++i];
+        } else if (arg == "--compare" && i + 1 < argc) {
+            options.comparePath = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            options.tolerance = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 2;
+        }
+    }
+    if (options.threadCounts.empty()) {
+        options.threadCounts = {1, std::max(1u, std::thread::hardware_concurrency())};
+        if (options.threadCounts[1] == 1) {
+            options.threadCounts.pop_back();
+        }
+    }
+
+    std::vector<BenchMesh> meshes;
+    BenchMesh scanned;
+    if (loadOBJ(options.meshPath, scanned.vertices, scanned.faces)) {
+        scanned.name = std::filesystem::path(options.meshPath).stem().string();
+        scanned.objPath = options.meshPath;
+        meshes.push_back(std::move(scanned));
+    } else {
+        std::cerr << "Skipping " << options.meshPath << std::endl;
+    }
+    std::vector<std::string> specs = options.generated;
+    for (size_t size : options.sizes) {
+        specs.push_back(options.shape + ":" + sizeName(size));
+    }
+    for (const std::string& spec : specs) {
+        BenchMesh mesh;
+        if (!generateMesh(spec, mesh.vertices, mesh.faces)) {
+            return 2;
+        }
+        mesh.name = spec;
+        if (mesh.faces.size() <= kOBJMaxFaces) {
+            std::string path = (std::filesystem::temp_directory_path() / ("mesh_bench_" + std::to_string(meshes.size()) + ".obj")).string();
+            if (writeBenchOBJ(path, mesh.vertices, mesh.faces)) {
+                mesh.objPath = path;
+                mesh.temporaryOBJ = true;
+            }
+        }
+        meshes.push_back(std::move(mesh));
+    }
+
+    std::vector<BenchResult> results;
+    std::cout << "kernel                 mesh           thr     min ms    p50 ms    p90 ms    p99 ms  elements/s     GB/s   allocs" << std::endl;
+    for (unsigned int threads : options.threadCounts) {
+        setParallelThreadCount(threads);
+        for (const BenchMesh& mesh : meshes) {
+            benchMesh(mesh, options.minSeconds, results);
+        }
+    }
+    for (const BenchMesh& mesh : meshes) {
+        if (mesh.temporaryOBJ) {
+            std::filesystem::remove(mesh.objPath);
+        }
+    }
+
+    // Speedup of the median over the first thread count
+    if (options.threadCounts.size() > 1) {
+        std::cout << std::endl << "Scaling (p50 speedup over " << options.threadCounts[0] << " threads):" << std::endl;
+        for (const BenchResult& base : results) {
+            if (base.threads != options.threadCounts[0]) {
+                continue;
+            }
+            std::cout << "  " << base.kernel << " on " << base.mesh << ":";
+            for (const BenchResult& r : results) {
+                if (r.kernel == base.kernel && r.mesh == base.mesh && r.threads != base.threads) {
+                    std::cout << " " << r.threads << "t " << base.p50Ms / r.p50Ms << "x";
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    if (!options.jsonPath.empty() && !writeResults(results, options.jsonPath)) {
+        return 2;
+    }
+    if (!options.comparePath.empty()) {
+        int regressions = compareResults(results, options.comparePath, options.tolerance);
+        if (regressions != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,683 @@
+#include "bvh.h"
+#include "parallel.h"
+#include "simd.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+static const int kBinCount = 16;
+
+// Node ranges larger than this bin their primitives with parallelFor
+static const size_t kParallelBinThreshold = 1 << 16;
+// Subtrees larger than this are built as separate tasks
+static const size_t kParallelTaskThreshold = 1 << 12;
+
+struct AABB {
+    glm::vec3 min = glm::vec3(INFINITY);
+    glm::vec3 max = glm::vec3(-INFINITY);
+
+    void grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void grow(const AABB& box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+    float area() const {
+        glm::vec3 e = max - min;
+        return (e.x < 0.0f) ? 0.0f : 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+struct Bin {
+    AABB bounds;
+    AABB centroidBounds;
+    size_t count = 0;
+};
+
+// Primitive record that is partitioned in place, so the build never chases indices
+struct BuildPrim {
+    glm::vec3 min;
+    unsigned int face;
+    glm::vec3 max;
+    float padding;
+
+    glm::vec3 centroid() const { return (min + max) * 0.5f; }
+};
+
+struct BuildContext {
+    std::vector<BuildPrim> prims;
+    std::vector<BVHNode>& nodes;
+    std::atomic<unsigned int> nodeCount;
+    unsigned int maxLeaf;
+
+    explicit BuildContext(std::vector<BVHNode>& n) : nodes(n), nodeCount(0), maxLeaf(kBVHMaxLeafTriangles) {}
+};
+
+static glm::vec3 position(const Vertex& v) {
+    return glm::vec3(v.x, v.y, v.z);
+}
+
+static void setNodeBounds(BVHNode& node, const AABB& box) {
+    node.boundsMin[0] = box.min.x;
+    node.boundsMin[1] = box.min.y;
+    node.boundsMin[2] = box.min.z;
+    node.boundsMax[0] = box.max.x;
+    node.boundsMax[1] = box.max.y;
+    node.boundsMax[2] = box.max.z;
+}
+
+static AABB nodeBounds(const BVHNode& node) {
+    AABB box;
+    box.min = glm::vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]);
+    box.max = glm::vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]);
+    return box;
+}
+
+static int binIndex(const glm::vec3& centroid, int axis, float binMin, float binScale) {
+    return std::min(kBinCount - 1, std::max(0, static_cast<int>((centroid[axis] - binMin) * binScale)));
+}
+
+static void binRange(const BuildContext& ctx, size_t begin, size_t end, int axis, float binMin, float binScale, Bin* bins) {
+    for (size_t i = begin; i < end; ++i) {
+        const BuildPrim& prim = ctx.prims[i];
+        glm::vec3 c = prim.centroid();
+        Bin& bin = bins[binIndex(c, axis, binMin, binScale)];
+        bin.bounds.min = glm::min(bin.bounds.min, prim.min);
+        bin.bounds.max = glm::max(bin.bounds.max, prim.max);
+        bin.centroidBounds.grow(c);
+        bin.count++;
+    }
+}
+
+// Bin prims[begin, end) by centroid, in parallel for large ranges
+static void gatherBins(const BuildContext& ctx, size_t begin, size_t end, int axis, float binMin, float binScale,
+                       Bin* bins) {
+    if (end - begin < kParallelBinThreshold) {
+        binRange(ctx, begin, end, axis, binMin, binScale, bins);
+        return;
+    }
+    std::mutex mutex;
+    parallelFor(end - begin, kParallelBinThreshold / 4, [&](size_t first, size_t last) {
+        Bin localBins[kBinCount];
+        binRange(ctx, begin + first, begin + last, axis, binMin, binScale, localBins);
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int b = 0; b < kBinCount; ++b) {
+            bins[b].bounds.grow(localBins[b].bounds);
+            bins[b].centroidBounds.grow(localBins[b].centroidBounds);
+            bins[b].count += localBins[b].count;
+        }
+    });
+}
+
+static void rangeBounds(const BuildContext& ctx, size_t begin, size_t end, AABB& bounds, AABB& centroidBounds) {
+    for (size_t i = begin; i < end; ++i) {
+        bounds.min = glm::min(bounds.min, ctx.prims[i].min);
+        bounds.max = glm::max(bounds.max, ctx.prims[i].max);
+        centroidBounds.grow(ctx.prims[i].centroid());
+    }
+}
+
+// Build the subtree for prims[begin, end); the caller passes in their bounds
+static void buildNode(BuildContext& ctx, unsigned int nodeIndex, unsigned int depth, size_t begin, size_t end,
+                      const AABB& bounds, const AABB& centroidBounds) {
+    BVHNode& node = ctx.nodes[nodeIndex];
+    size_t count = end - begin;
+    setNodeBounds(node, bounds);
+
+    if (count <= ctx.maxLeaf) {
+        node.leftFirst = static_cast<unsigned int>(begin); // replaced by the block index later
+        node.count = static_cast<unsigned int>(count);
+        return;
+    }
+
+    // Binned SAH along the widest centroid axis
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+    size_t mid = begin;
+    AABB leftBounds, leftCentroids, rightBounds, rightCentroids;
+
+    // Deep in a degenerate tree: median splits need at most 31 more levels
+    // for the 2^32 faces an index can address, keeping within kBVHMaxDepth
+    if (depth >= kBVHMaxDepth / 2) {
+        mid = begin + count / 2;
+        std::nth_element(ctx.prims.begin() + begin, ctx.prims.begin() + mid, ctx.prims.begin() + end,
+                         [axis](const BuildPrim& a, const BuildPrim& b) { return a.centroid()[axis] < b.centroid()[axis]; });
+        rangeBounds(ctx, begin, mid, leftBounds, leftCentroids);
+        rangeBounds(ctx, mid, end, rightBounds, rightCentroids);
+    } else if (extent[axis] > 0.0f) {
+        float binMin = centroidBounds.min[axis];
+        float binScale = kBinCount / extent[axis];
+        Bin bins[kBinCount];
+        gatherBins(ctx, begin, end, axis, binMin, binScale, bins);
+
+        // Sweep from the right to get the cost of every split plane
+        float rightCost[kBinCount];
+        AABB rightBox;
+        size_t rightCount = 0;
+        for (int b = kBinCount - 1; b > 0; --b) {
+            rightBox.grow(bins[b].bounds);
+            rightCount += bins[b].count;
+            rightCost[b] = rightBox.area() * rightCount;
+        }
+
+        float bestCost = INFINITY;
+        int bestSplit = -1;
+        AABB leftBox;
+        size_t leftCount = 0;
+        for (int b = 0; b < kBinCount - 1; ++b) {
+            leftBox.grow(bins[b].bounds);
+            leftCount += bins[b].count;
+            float cost = leftBox.area() * leftCount + rightCost[b + 1];
+            if (leftCount > 0 && leftCount < count && cost < bestCost) {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        if (bestSplit >= 0) {
+            auto split = std::partition(ctx.prims.begin() + begin, ctx.prims.begin() + end, [&](const BuildPrim& prim) {
+                return binIndex(prim.centroid(), axis, binMin, binScale) <= bestSplit;
+            });
+            mid = split - ctx.prims.begin();
+            for (int b = 0; b < kBinCount; ++b) {
+                AABB& box = (b <= bestSplit) ? leftBounds : rightBounds;
+                AABB& centroids = (b <= bestSplit) ? leftCentroids : rightCentroids;
+                box.grow(bins[b].bounds);
+                centroids.grow(bins[b].centroidBounds);
+            }
+        }
+    }
+
+    // Coincident centroids: fall back to an even split of the range
+    if (mid == begin || mid == end) {
+        mid = begin + count / 2;
+        leftBounds = leftCentroids = rightBounds = rightCentroids = AABB();
+        rangeBounds(ctx, begin, mid, leftBounds, leftCentroids);
+        rangeBounds(ctx, mid, end, rightBounds, rightCentroids);
+    }
+
+    unsigned int left = ctx.nodeCount.fetch_add(2);
+    node.leftFirst = left;
+    node.count = 0;
+
+    if (count > kParallelTaskThreshold) {
+        parallelInvoke([&]() { buildNode(ctx, left, depth + 1, begin, mid, leftBounds, leftCentroids); },
+                       [&]() { buildNode(ctx, left + 1, depth + 1, mid, end, rightBounds, rightCentroids); });
+    } else {
+        buildNode(ctx, left, depth + 1, begin, mid, leftBounds, leftCentroids);
+        buildNode(ctx, left + 1, depth + 1, mid, end, rightBounds, rightCentroids);
+    }
+}
+
+// Write the corner and edges of every lane of a block from the current vertex positions
+static void fillBlock(TriangleBlock4& block, const VertexArray& vertices, const FaceArray& faces) {
+    for (int lane = 0; lane < 4; ++lane) {
+        glm::vec3 v0(0.0f), e1(0.0f), e2(0.0f);
+        if (block.faces[lane] != ~0u) {
+            const Face& face = faces[block.faces[lane]];
+            v0 = position(vertices[face.v1]);
+            e1 = position(vertices[face.v2]) - v0;
+            e2 = position(vertices[face.v3]) - v0;
+        }
+        block.v0x[lane] = v0.x;
+        block.v0y[lane] = v0.y;
+        block.v0z[lane] = v0.z;
+        block.e1x[lane] = e1.x;
+        block.e1y[lane] = e1.y;
+        block.e1z[lane] = e1.z;
+        block.e2x[lane] = e2.x;
+        block.e2y[lane] = e2.y;
+        block.e2z[lane] = e2.z;
+    }
+}
+
+TriangleBVH buildBVH(const VertexArray& vertices, const FaceArray& faces, unsigned int maxLeafTriangles) {
+    TriangleBVH bvh;
+    if (faces.empty()) {
+        return bvh;
+    }
+
+    bvh.nodes.resize(faces.size() * 2);
+    BuildContext ctx(bvh.nodes);
+    ctx.maxLeaf = (maxLeafTriangles >= 8) ? 8 : 4;
+    ctx.prims.resize(faces.size());
+
+    AABB rootBounds, rootCentroids;
+    std::mutex mutex;
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        AABB localBounds, localCentroids;
+        for (size_t i = begin; i < end; ++i) {
+            const Face& face = faces[i];
+            AABB box;
+            box.grow(position(vertices[face.v1]));
+            box.grow(position(vertices[face.v2]));
+            box.grow(position(vertices[face.v3]));
+            BuildPrim& prim = ctx.prims[i];
+            prim.min = box.min;
+            prim.max = box.max;
+            prim.face = static_cast<unsigned int>(i);
+            prim.padding = 0.0f;
+            localBounds.grow(box);
+            localCentroids.grow(prim.centroid());
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        rootBounds.grow(localBounds);
+        rootCentroids.grow(localCentroids);
+    });
+
+    ctx.nodeCount = 1;
+    buildNode(ctx, 0, 0, 0, faces.size(), rootBounds, rootCentroids);
+    bvh.nodes.resize(ctx.nodeCount);
+
+    // Give every leaf a run of triangle blocks, in node order
+    size_t blockCount = 0;
+    std::vector<unsigned int> leafFirstPrim(bvh.nodes.size(), 0);
+    for (size_t i = 0; i < bvh.nodes.size(); ++i) {
+        BVHNode& node = bvh.nodes[i];
+        if (node.count > 0) {
+            leafFirstPrim[i] = node.leftFirst;
+            node.leftFirst = static_cast<unsigned int>(blockCount);
+            blockCount += (node.count + 3) / 4;
+        }
+    }
+
+    bvh.blocks.resize(blockCount);
+    parallelFor(bvh.nodes.size(), 1 << 12, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const BVHNode& node = bvh.nodes[i];
+            for (unsigned int k = 0; k < node.count; k += 4) {
+                TriangleBlock4& block = bvh.blocks[node.leftFirst + k / 4];
+                for (unsigned int lane = 0; lane < 4; ++lane) {
+                    block.faces[lane] = (k + lane < node.count) ? ctx.prims[leafFirstPrim[i] + k + lane].face : ~0u;
+                }
+                fillBlock(block, vertices, faces);
+            }
+        }
+    });
+
+    // Breadth-first walk to group nodes by depth for the parallel refit
+    bvh.levelNodes.reserve(bvh.nodes.size());
+    bvh.levelNodes.push_back(0);
+    bvh.levelOffsets.push_back(0);
+    size_t levelBegin = 0;
+    while (levelBegin < bvh.levelNodes.size()) {
+        size_t levelEnd = bvh.levelNodes.size();
+        bvh.levelOffsets.push_back(static_cast<unsigned int>(levelEnd));
+        for (size_t i = levelBegin; i < levelEnd; ++i) {
+            const BVHNode& node = bvh.nodes[bvh.levelNodes[i]];
+            if (node.count == 0) {
+                bvh.levelNodes.push_back(node.leftFirst);
+                bvh.levelNodes.push_back(node.leftFirst + 1);
+            }
+        }
+        levelBegin = levelEnd;
+    }
+    assert(bvh.levelOffsets.size() - 2 <= kBVHMaxDepth);
+
+    bvh.buildCost = bvh.cost = computeSAHCost(bvh);
+    return bvh;
+}
+
+static AABB leafBounds(const TriangleBVH& bvh, const BVHNode& node) {
+    AABB box;
+    for (unsigned int k = 0; k < node.count; ++k) {
+        const TriangleBlock4& block = bvh.blocks[node.leftFirst + k / 4];
+        unsigned int lane = k % 4;
+        glm::vec3 v0(block.v0x[lane], block.v0y[lane], block.v0z[lane]);
+        box.grow(v0);
+        box.grow(v0 + glm::vec3(block.e1x[lane], block.e1y[lane], block.e1z[lane]));
+        box.grow(v0 + glm::vec3(block.e2x[lane], block.e2y[lane], block.e2z[lane]));
+    }
+    return box;
+}
+
+void refitBVH(TriangleBVH& bvh, const VertexArray& vertices, const FaceArray& faces) {
+    parallelFor(bvh.blocks.size(), 1 << 12, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            fillBlock(bvh.blocks[i], vertices, faces);
+        }
+    });
+
+    // Deepest level first; nodes within a level are independent
+    for (size_t level = bvh.levelOffsets.size() - 1; level-- > 0;) {
+        size_t first = bvh.levelOffsets[level];
+        size_t count = bvh.levelOffsets[level + 1] - first;
+        parallelFor(count, 1 << 11, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                BVHNode& node = bvh.nodes[bvh.levelNodes[first + i]];
+                AABB box;
+                if (node.count > 0) {
+                    box = leafBounds(bvh, node);
+                } else {
+                    box = nodeBounds(bvh.nodes[node.leftFirst]);
+                    box.grow(nodeBounds(bvh.nodes[node.leftFirst + 1]));
+                }
+                setNodeBounds(node, box);
+            }
+        });
+    }
+
+    bvh.cost = computeSAHCost(bvh);
+}
+
+float computeSAHCost(const TriangleBVH& bvh) {
+    if (bvh.nodes.empty()) {
+        return 0.0f;
+    }
+    float rootArea = nodeBounds(bvh.nodes[0]).area();
+    if (rootArea <= 0.0f) {
+        return 0.0f;
+    }
+
+    double total = 0.0;
+    std::mutex mutex;
+    parallelFor(bvh.nodes.size(), 1 << 14, [&](size_t begin, size_t end) {
+        double sum = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+            const BVHNode& node = bvh.nodes[i];
+            // Interior nodes cost one traversal step, leaves one test per block
+            float weight = (node.count > 0) ? static_cast<float>((node.count + 3) / 4) : 1.0f;
+            sum += nodeBounds(node).area() * weight;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        total += sum;
+    });
+    return static_cast<float>(total / rootArea);
+}
+
+void resetDynamicBVH(DynamicBVH& dynamic, const VertexArray& vertices, const FaceArray& faces) {
+    if (dynamic.pendingRebuild.valid()) {
+        dynamic.pendingRebuild.wait();
+        dynamic.pendingRebuild = std::future<TriangleBVH>();
+    }
+    dynamic.bvh = buildBVH(vertices, faces);
+    dynamic.movedSinceSnapshot = false;
+}
+
+void refitDynamicBVH(DynamicBVH& dynamic, const VertexArray& vertices, const FaceArray& faces) {
+    refitBVH(dynamic.bvh, vertices, faces);
+
+    if (dynamic.pendingRebuild.valid()) {
+        dynamic.movedSinceSnapshot = true;
+        return;
+    }
+
+    if (dynamic.bvh.buildCost > 0.0f && dynamic.bvh.cost > dynamic.bvh.buildCost * dynamic.rebuildThreshold) {
+        // The rebuild works on its own copy of the mesh, so the caller may
+        // change the faces while it runs
+        std::shared_ptr<const VertexArray> snapshot = std::make_shared<const VertexArray>(vertices);
+        std::shared_ptr<const FaceArray> faceSnapshot = std::make_shared<const FaceArray>(faces);
+        dynamic.pendingRebuild = std::async(std::launch::async, [snapshot, faceSnapshot]() {
+            return buildBVH(*snapshot, *faceSnapshot);
+        });
+        dynamic.movedSinceSnapshot = false;
+    }
+}
+
+bool pollDynamicBVH(DynamicBVH& dynamic, const VertexArray& vertices, const FaceArray& faces) {
+    if (!dynamic.pendingRebuild.valid() ||
+        dynamic.pendingRebuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+
+    dynamic.bvh = dynamic.pendingRebuild.get();
+    if (dynamic.movedSinceSnapshot) {
+        // Catch up with edits made while the rebuild was running
+        refitBVH(dynamic.bvh, vertices, faces);
+        dynamic.movedSinceSnapshot = false;
+    }
+    return true;
+}
+
+// Slab test; returns the entry distance or INFINITY on a miss
+static float intersectNode(const BVHNode& node, const glm::vec3& origin, const glm::vec3& invDir, float tMin, float tMax) {
+    float tx1 = (node.boundsMin[0] - origin.x) * invDir.x;
+    float tx2 = (node.boundsMax[0] - origin.x) * invDir.x;
+    float ty1 = (node.boundsMin[1] - origin.y) * invDir.y;
+    float ty2 = (node.boundsMax[1] - origin.y) * invDir.y;
+    float tz1 = (node.boundsMin[2] - origin.z) * invDir.z;
+    float tz2 = (node.boundsMax[2] - origin.z) * invDir.z;
+    float tNear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), tMin));
+    float tFar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tMax));
+    return (tNear <= tFar) ? tNear : INFINITY;
+}
+
+// Moller-Trumbore against four triangles at once
+static void intersectBlock(const TriangleBlock4& block, const Ray& ray, float tMin, RayHit& hit) {
+    Float4 dx = splat4(ray.direction.x), dy = splat4(ray.direction.y), dz = splat4(ray.direction.z);
+    Float4 e1x = load4(block.e1x), e1y = load4(block.e1y), e1z = load4(block.e1z);
+    Float4 e2x = load4(block.e2x), e2y = load4(block.e2y), e2z = load4(block.e2z);
+
+    // pvec = dir x e2
+    Float4 px = dy * e2z - dz * e2y;
+    Float4 py = dz * e2x - dx * e2z;
+    Float4 pz = dx * e2y - dy * e2x;
+    Float4 det = e1x * px + e1y * py + e1z * pz;
+    Float4 epsilon = splat4(1e-12f);
+    Mask4 valid = (det > epsilon) | (det < splat4(-1e-12f));
+    Float4 invDet = splat4(1.0f) / select4(valid, det, splat4(1.0f));
+
+    Float4 tx = splat4(ray.origin.x) - load4(block.v0x);
+    Float4 ty = splat4(ray.origin.y) - load4(block.v0y);
+    Float4 tz = splat4(ray.origin.z) - load4(block.v0z);
+    Float4 u = (tx * px + ty * py + tz * pz) * invDet;
+
+    // qvec = tvec x e1
+    Float4 qx = ty * e1z - tz * e1y;
+    Float4 qy = tz * e1x - tx * e1z;
+    Float4 qz = tx * e1y - ty * e1x;
+    Float4 v = (dx * qx + dy * qy + dz * qz) * invDet;
+    Float4 t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+    Float4 zero = splat4(0.0f);
+    valid = valid & (u >= zero) & (v >= zero) & ((u + v) <= splat4(1.0f));
+    valid = valid & (t > splat4(tMin)) & (t < splat4(hit.t));
+
+    int bits = maskBits4(valid);
+    if (!bits) {
+        return;
+    }
+    float tLanes[4], uLanes[4], vLanes[4];
+    store4(tLanes, t);
+    store4(uLanes, u);
+    store4(vLanes, v);
+    while (bits) {
+        int lane = lowestLane(bits);
+        bits &= bits - 1;
+        if (tLanes[lane] < hit.t) {
+            hit.t = tLanes[lane];
+            hit.u = uLanes[lane];
+            hit.v = vLanes[lane];
+            hit.face = block.faces[lane];
+        }
+    }
+}
+
+bool intersectBVH(const TriangleBVH& bvh, const Ray& ray, RayHit& hit, float tMin, float tMax) {
+    hit.t = tMax;
+    hit.face = ~0u;
+    hit.u = hit.v = 0.0f;
+    if (bvh.nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    if (intersectNode(bvh.nodes[0], ray.origin, invDir, tMin, hit.t) == INFINITY) {
+        return false;
+    }
+
+    // The stack never holds more nodes than the current depth
+    unsigned int stack[kBVHMaxDepth];
+    int stackSize = 0;
+    unsigned int current = 0;
+    for (;;) {
+        const BVHNode& node = bvh.nodes[current];
+        if (node.count > 0) {
+            for (unsigned int k = 0; k < node.count; k += 4) {
+                intersectBlock(bvh.blocks[node.leftFirst + k / 4], ray, tMin, hit);
+            }
+        } else {
+            // Visit the nearer child first and defer the other one
+            unsigned int left = node.leftFirst, right = node.leftFirst + 1;
+            float tLeft = intersectNode(bvh.nodes[left], ray.origin, invDir, tMin, hit.t);
+            float tRight = intersectNode(bvh.nodes[right], ray.origin, invDir, tMin, hit.t);
+            if (tLeft > tRight) {
+                std::swap(tLeft, tRight);
+                std::swap(left, right);
+            }
+            if (tLeft != INFINITY) {
+                if (tRight != INFINITY) {
+                    assert(stackSize < static_cast<int>(kBVHMaxDepth));
+                    stack[stackSize++] = right;
+                }
+                current = left;
+                continue;
+            }
+        }
+
+        // Pop the next deferred node that can still beat the closest hit
+        bool found = false;
+        while (stackSize > 0) {
+            unsigned int candidate = stack[--stackSize];
+            if (intersectNode(bvh.nodes[candidate], ray.origin, invDir, tMin, hit.t) != INFINITY) {
+                current = candidate;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            break;
+        }
+    }
+
+    return hit.face != ~0u;
+}
+
+// Squared distance from p to the node's box, 0 inside
+static float nodeDistanceSquared(const BVHNode& node, const glm::vec3& p) {
+    float sum = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        float below = node.boundsMin[axis] - p[axis];
+        float above = p[axis] - node.boundsMax[axis];
+        float d = std::max(0.0f, std::max(below, above));
+        sum += d * d;
+    }
+    return sum;
+}
+
+// Closest point on triangle (a, a + ab, a + ac) by Voronoi region tests (Ericson)
+static glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& ab, const glm::vec3& ac) {
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return a;
+    }
+
+    glm::vec3 bp = ap - ab;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return a + ab;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    glm::vec3 cp = ap - ac;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return a + ac;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return a + ab + (ac - ab) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float denominator = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+bool closestPointBVH(const TriangleBVH& bvh, const glm::vec3& point, ClosestHit& hit, float maxDistance) {
+    hit.point = point;
+    hit.distanceSquared = maxDistance * maxDistance;
+    hit.face = ~0u;
+    if (bvh.nodes.empty() || nodeDistanceSquared(bvh.nodes[0], point) > hit.distanceSquared) {
+        return false;
+    }
+
+    // The stack never holds more nodes than the current depth
+    unsigned int stack[kBVHMaxDepth];
+    int stackSize = 0;
+    unsigned int current = 0;
+    for (;;) {
+        const BVHNode& node = bvh.nodes[current];
+        if (node.count > 0) {
+            for (unsigned int k = 0; k < node.count; k += 4) {
+                const TriangleBlock4& block = bvh.blocks[node.leftFirst + k / 4];
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (block.faces[lane] == ~0u) {
+                        continue;
+                    }
+                    glm::vec3 a(block.v0x[lane], block.v0y[lane], block.v0z[lane]);
+                    glm::vec3 ab(block.e1x[lane], block.e1y[lane], block.e1z[lane]);
+                    glm::vec3 ac(block.e2x[lane], block.e2y[lane], block.e2z[lane]);
+                    glm::vec3 closest = closestPointOnTriangle(point, a, ab, ac);
+                    glm::vec3 offset = closest - point;
+                    float distanceSquared = glm::dot(offset, offset);
+                    if (distanceSquared < hit.distanceSquared) {
+                        hit.distanceSquared = distanceSquared;
+                        hit.point = closest;
+                        hit.face = block.faces[lane];
+                    }
+                }
+            }
+        } else {
+            // Visit the nearer child first and defer the other one
+            unsigned int left = node.leftFirst, right = node.leftFirst + 1;
+            float dLeft = nodeDistanceSquared(bvh.nodes[left], point);
+            float dRight = nodeDistanceSquared(bvh.nodes[right], point);
+            if (dLeft > dRight) {
+                std::swap(dLeft, dRight);
+                std::swap(left, right);
+            }
+            if (dLeft <= hit.distanceSquared) {
+                if (dRight <= hit.distanceSquared) {
+                    assert(stackSize < static_cast<int>(kBVHMaxDepth));
+                    stack[stackSize++] = right;
+                }
+                current = left;
+                continue;
+            }
+        }
+
+        // Pop the next deferred node that can still hold a closer point
+        bool found = false;
+        while (stackSize > 0) {
+            unsigned int candidate = stack[--stackSize];
+            if (nodeDistanceSquared(bvh.nodes[candidate], point) <= hit.distanceSquared) {
+                current = candidate;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            break;
+        }
+    }
+
+    return hit.face != ~0u;
+}
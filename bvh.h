@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cmath>
+#include <future>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+
+// Leaves hold up to this many triangles by default, tested four at a time
+const unsigned int kBVHMaxLeafTriangles = 4;
+
+// Trees are never deeper than this (the root is at depth 0): below half of
+// it the builder splits at the median, so traversals can use a fixed stack
+const unsigned int kBVHMaxDepth = 64;
+
+// 32-byte node in a flattened tree. Interior nodes store the index of their
+// left child (the right child follows it) and a count of 0; leaves store the
+// index of their first triangle block and their triangle count.
+// Children are always stored after their parent.
+struct BVHNode {
+    float boundsMin[3];
+    unsigned int leftFirst;
+    float boundsMax[3];
+    unsigned int count;
+};
+
+// Four triangles in structure-of-arrays form: a corner and two edge vectors.
+// Unused lanes have zero edges and a face index of ~0u, so they never hit.
+struct TriangleBlock4 {
+    float v0x[4], v0y[4], v0z[4];
+    float e1x[4], e1y[4], e1z[4];
+    float e2x[4], e2y[4], e2z[4];
+    unsigned int faces[4];
+};
+
+struct TriangleBVH {
+    std::vector<BVHNode> nodes;
+    std::vector<TriangleBlock4> blocks;
+    // Node indices grouped by depth: level d is levelNodes[levelOffsets[d], levelOffsets[d + 1])
+    std::vector<unsigned int> levelNodes;
+    std::vector<unsigned int> levelOffsets;
+    // SAH cost of the tree when it was built and after the latest refit
+    float buildCost = 0.0f;
+    float cost = 0.0f;
+};
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+struct RayHit {
+    float t;
+    unsigned int face; // ~0u when nothing was hit
+    float u, v;        // barycentric weights of the face's second and third corner
+};
+
+// Function to build a BVH over the faces with a binned SAH, splitting the
+// top of the tree into parallel tasks. maxLeafTriangles is 4 or 8.
+TriangleBVH buildBVH(const VertexArray& vertices, const FaceArray& faces,
+                     unsigned int maxLeafTriangles = kBVHMaxLeafTriangles);
+
+// Function to update the triangle blocks and node bounds after the vertices
+// moved, one tree level at a time from the leaves up, each level in parallel.
+// The topology must be unchanged since the BVH was built. Updates bvh.cost.
+void refitBVH(TriangleBVH& bvh, const VertexArray& vertices, const FaceArray& faces);
+
+// Function to compute the SAH cost of the tree: the expected number of node
+// visits and triangle block tests for a random ray hitting the root bounds
+float computeSAHCost(const TriangleBVH& bvh);
+
+// Function to find the closest intersection with t in (tMin, tMax).
+// Both sides of a triangle are hit. Returns false when nothing was hit.
+bool intersectBVH(const TriangleBVH& bvh, const Ray& ray, RayHit& hit, float tMin = 0.0f, float tMax = INFINITY);
+
+struct ClosestHit {
+    glm::vec3 point;
+    float distanceSquared;
+    unsigned int face; // ~0u when nothing is within range
+};
+
+// Function to find the closest point on the mesh to a query point, within
+// maxDistance. Returns false when no triangle is that close.
+bool closestPointBVH(const TriangleBVH& bvh, const glm::vec3& point, ClosestHit& hit, float maxDistance = INFINITY);
+
+// A BVH over a deforming mesh: moved vertices are handled by refitting, and
+// once refits have degraded the tree too far (cost / buildCost above the
+// threshold) a full rebuild runs on a background thread from a snapshot of
+// the positions and faces. Call resetDynamicBVH() after changing the faces,
+// which drops a rebuild of the old ones.
+struct DynamicBVH {
+    TriangleBVH bvh;
+    float rebuildThreshold = 1.5f;
+    std::future<TriangleBVH> pendingRebuild;
+    bool movedSinceSnapshot = false;
+};
+
+// Function to synchronously (re)build the tree, dropping any pending rebuild
+void resetDynamicBVH(DynamicBVH& dynamic, const VertexArray& vertices, const FaceArray& faces);
+
+// Function to refit after the vertices moved, starting a background rebuild
+// when the quality ratio crosses the threshold
+void refitDynamicBVH(DynamicBVH& dynamic, const VertexArray& vertices, const FaceArray& faces);
+
+// Function to swap in a finished background rebuild; call once per frame.
+// Returns true when the tree was replaced.
+bool pollDynamicBVH(DynamicBVH& dynamic, const VertexArray& vertices, const FaceArray& faces);
@@ -0,0 +1,161 @@
+#include "components.h"
+#include "parallel.h"
+#include "radix_sort.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+// Find with path halving; concurrent callers may shorten the same paths
+static unsigned int findRoot(std::atomic<unsigned int>* parent, unsigned int x) {
+    for (;;) {
+        unsigned int p = parent[x].load(std::memory_order_relaxed);
+        if (p == x) {
+            return x;
+        }
+        unsigned int grandparent = parent[p].load(std::memory_order_relaxed);
+        if (p != grandparent) {
+            parent[x].compare_exchange_weak(p, grandparent, std::memory_order_relaxed);
+        }
+        x = grandparent;
+    }
+}
+
+// Link the larger root under the smaller one; a failed CAS means another
+// thread linked that root first, so retry from the new roots
+static void unite(std::atomic<unsigned int>* parent, unsigned int a, unsigned int b) {
+    for (;;) {
+        a = findRoot(parent, a);
+        b = findRoot(parent, b);
+        if (a == b) {
+            return;
+        }
+        if (a < b) {
+            std::swap(a, b);
+        }
+        unsigned int expected = a;
+        if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+static glm::vec3 position(const Vertex& v) {
+    return glm::vec3(v.x, v.y, v.z);
+}
+
+ComponentLabels labelConnectedComponents(const VertexArray& vertices, const FaceArray& faces) {
+    ComponentLabels labels;
+    const size_t vertexCount = vertices.size();
+    std::unique_ptr<std::atomic<unsigned int>[]> parent(new std::atomic<unsigned int>[vertexCount]);
+
+    parallelFor(vertexCount, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            parent[v].store(static_cast<unsigned int>(v), std::memory_order_relaxed);
+        }
+    });
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            unite(parent.get(), faces[f].v1, faces[f].v2);
+            unite(parent.get(), faces[f].v1, faces[f].v3);
+        }
+    });
+
+    // Dense ids for roots that own at least one face
+    std::vector<int> rootLabel(vertexCount, -1);
+    std::vector<unsigned char> used(vertexCount, 0);
+    for (const auto& face : faces) {
+        used[face.v1] = 1;
+    }
+    int componentCount = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (used[v]) {
+            unsigned int root = findRoot(parent.get(), static_cast<unsigned int>(v));
+            if (rootLabel[root] < 0) {
+                rootLabel[root] = componentCount++;
+            }
+        }
+    }
+
+    labels.faceComponent.resize(faces.size());
+    ComponentStats empty = {0, 0.0f, glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+    labels.components.assign(componentCount, empty);
+
+    // Sort the faces by component, so every component is one run reduced once,
+    // in face order; the cost stays linear however many components there are
+    std::vector<uint64_t> keys(faces.size());
+    std::vector<uint32_t> order(faces.size());
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            int label = rootLabel[findRoot(parent.get(), faces[f].v1)];
+            labels.faceComponent[f] = label;
+            keys[f] = static_cast<uint64_t>(label);
+            order[f] = static_cast<uint32_t>(f);
+        }
+    });
+    int labelBits = 1;
+    while ((1 << labelBits) < componentCount) {
+        labelBits++;
+    }
+    radixSortPairs64(keys, order, 0, labelBits);
+
+    // Every component owns at least one face, so each run start sets its offset
+    std::vector<size_t> runOffsets(componentCount + 1, faces.size());
+    parallelFor(faces.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (i == 0 || keys[i] != keys[i - 1]) {
+                runOffsets[keys[i]] = i;
+            }
+        }
+    });
+
+    parallelFor(componentCount, 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ComponentStats& stats = labels.components[i];
+            for (size_t k = runOffsets[i]; k < runOffsets[i + 1]; ++k) {
+                const Face& face = faces[order[k]];
+                glm::vec3 a = position(vertices[face.v1]);
+                glm::vec3 b = position(vertices[face.v2]);
+                glm::vec3 c = position(vertices[face.v3]);
+                stats.faceCount++;
+                stats.area += 0.5f * glm::length(glm::cross(b - a, c - a));
+                stats.boundsMin = glm::min(stats.boundsMin, glm::min(a, glm::min(b, c)));
+                stats.boundsMax = glm::max(stats.boundsMax, glm::max(a, glm::max(b, c)));
+            }
+        }
+    });
+
+    return labels;
+}
+
+std::vector<int> removeSmallComponents(VertexArray& vertices, FaceArray& faces,
+                                       const ComponentLabels& labels, size_t minFaces) {
+    // Keep vertices referenced by a surviving face
+    std::vector<int> remap(vertices.size(), -1);
+    for (size_t f = 0; f < faces.size(); ++f) {
+        if (labels.components[labels.faceComponent[f]].faceCount >= minFaces) {
+            remap[faces[f].v1] = remap[faces[f].v2] = remap[faces[f].v3] = 0;
+        }
+    }
+
+    // Compact vertices in place, recording where each one went
+    size_t keptVertices = 0;
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        if (remap[v] >= 0) {
+            remap[v] = static_cast<int>(keptVertices);
+            vertices[keptVertices++] = vertices[v];
+        }
+    }
+    vertices.resize(keptVertices);
+
+    size_t keptFaces = 0;
+    for (size_t f = 0; f < faces.size(); ++f) {
+        if (labels.components[labels.faceComponent[f]].faceCount >= minFaces) {
+            const Face& face = faces[f];
+            faces[keptFaces++] = {remap[face.v1], remap[face.v2], remap[face.v3]};
+        }
+    }
+    faces.resize(keptFaces);
+    return remap;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+
+// Size, surface area and bounding box of one connected component
+struct ComponentStats {
+    size_t faceCount;
+    float area;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+struct ComponentLabels {
+    // Component of every face, indexing into components
+    std::vector<int> faceComponent;
+    std::vector<ComponentStats> components;
+};
+
+// Function to label the connected components of the faces (faces sharing a
+// vertex are connected) with a lock-free parallel union-find over vertices,
+// and to gather per-component statistics, one pass over the faces sorted by
+// component
+ComponentLabels labelConnectedComponents(const VertexArray& vertices, const FaceArray& faces);
+
+// Function to remove every component with fewer than minFaces faces.
+// Faces and vertices are compacted in place; the returned remap gives the new
+// index of every old vertex (-1 if removed) for compacting other attributes.
+std::vector<int> removeSmallComponents(VertexArray& vertices, FaceArray& faces,
+                                       const ComponentLabels& labels, size_t minFaces);
+
+// Function to compact a per-vertex attribute with a remap from removeSmallComponents
+template <typename T, typename Allocator>
+void compactVertexAttribute(std::vector<T, Allocator>& values, const std::vector<int>& remap) {
+    for (size_t v = 0; v < remap.size() && v < values.size(); ++v) {
+        if (remap[v] >= 0) {
+            values[remap[v]] = values[v];
+        }
+    }
+    size_t kept = 0;
+    for (int target : remap) {
+        kept += (target >= 0) ? 1 : 0;
+    }
+    values.resize(kept);
+}
@@ -0,0 +1,121 @@
+#include "culling.h"
+#include "simd.h"
+#include <cmath>
+#include <cstdint>
+
+Frustum extractFrustum(const glm::mat4& viewProjection) {
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus another row
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; ++r) {
+        rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+
+    for (auto& plane : frustum.planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) {
+            plane /= length;
+        }
+    }
+    return frustum;
+}
+
+void buildClusterCullData(const MeshletMesh& mesh, ClusterCullData& data) {
+    size_t count = mesh.meshlets.size();
+    size_t padded = (count + 3) & ~size_t(3);
+    data.count = count;
+
+    // Padding lanes get a negative radius so they never pass the frustum test
+    data.centerX.assign(padded, 0.0f);
+    data.centerY.assign(padded, 0.0f);
+    data.centerZ.assign(padded, 0.0f);
+    data.radius.assign(padded, -INFINITY);
+    data.axisX.assign(padded, 0.0f);
+    data.axisY.assign(padded, 0.0f);
+    data.axisZ.assign(padded, 0.0f);
+    data.cutoff.assign(padded, 1.0f);
+    data.firstTriangle.resize(count);
+    data.triangleCount.resize(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const MeshletBounds& bounds = mesh.bounds[i];
+        data.centerX[i] = bounds.center.x;
+        data.centerY[i] = bounds.center.y;
+        data.centerZ[i] = bounds.center.z;
+        data.radius[i] = bounds.radius;
+        data.axisX[i] = bounds.coneAxis.x;
+        data.axisY[i] = bounds.coneAxis.y;
+        data.axisZ[i] = bounds.coneAxis.z;
+        data.cutoff[i] = bounds.coneCutoff;
+        data.firstTriangle[i] = mesh.meshlets[i].triangleOffset;
+        data.triangleCount[i] = mesh.meshlets[i].triangleCount;
+    }
+}
+
+void cullClusters(const ClusterCullData& data, const Frustum& frustum, const glm::vec3& cameraPos,
+                  bool coneCulling, DrawCommandList& commands) {
+    commands.counts.clear();
+    commands.offsets.clear();
+    commands.triangleCount = 0;
+
+    Float4 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; ++p) {
+        planeX[p] = splat4(frustum.planes[p].x);
+        planeY[p] = splat4(frustum.planes[p].y);
+        planeZ[p] = splat4(frustum.planes[p].z);
+        planeW[p] = splat4(frustum.planes[p].w);
+    }
+    Float4 camX = splat4(cameraPos.x), camY = splat4(cameraPos.y), camZ = splat4(cameraPos.z);
+    Float4 zero = splat4(0.0f);
+    Mask4 coneEnabled = coneCulling ? (zero <= zero) : (zero < zero);
+
+    // End of the last emitted draw, in triangles, for merging adjacent clusters
+    size_t lastEnd = SIZE_MAX;
+
+    for (size_t i = 0; i < data.count; i += 4) {
+        Float4 cx = load4(&data.centerX[i]);
+        Float4 cy = load4(&data.centerY[i]);
+        Float4 cz = load4(&data.centerZ[i]);
+        Float4 r = load4(&data.radius[i]);
+        Float4 negR = zero - r;
+
+        // Sphere against the six planes
+        Mask4 visible = r >= zero;
+        for (int p = 0; p < 6; ++p) {
+            Float4 distance = planeX[p] * cx + planeY[p] * cy + planeZ[p] * cz + planeW[p];
+            visible = visible & (distance >= negR);
+        }
+
+        // Normal cone: cull when every triangle in the cluster faces away from the camera
+        Float4 dx = cx - camX, dy = cy - camY, dz = cz - camZ;
+        Float4 distance = sqrt4(dx * dx + dy * dy + dz * dz);
+        Float4 facing = dx * load4(&data.axisX[i]) + dy * load4(&data.axisY[i]) + dz * load4(&data.axisZ[i]);
+        Mask4 backfacing = (facing >= load4(&data.cutoff[i]) * distance + r) & coneEnabled;
+        visible = andNot4(visible, backfacing);
+
+        int bits = maskBits4(visible);
+        while (bits) {
+            int lane = lowestLane(bits);
+            bits &= bits - 1;
+
+            size_t cluster = i + lane;
+            size_t first = data.firstTriangle[cluster];
+            size_t count = data.triangleCount[cluster];
+            if (first == lastEnd) {
+                commands.counts.back() += static_cast<int>(count * 3);
+            } else {
+                commands.counts.push_back(static_cast<int>(count * 3));
+                commands.offsets.push_back(reinterpret_cast<const void*>(first * 3 * sizeof(uint32_t)));
+            }
+            lastEnd = first + count;
+            commands.triangleCount += count;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "meshlet.h"
+
+// Six normalized clip planes (left, right, bottom, top, near, far); a point p
+// is inside when dot(plane.xyz, p) + plane.w >= 0 for every plane
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Function to extract the frustum planes from a projection * view matrix
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+// Meshlet bounds in structure-of-arrays form, padded to a multiple of four
+// so the culling loop can test four clusters per iteration
+struct ClusterCullData {
+    size_t count = 0;
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> axisX, axisY, axisZ, cutoff;
+    // Triangle range of every cluster inside the meshlet-ordered index buffer
+    std::vector<unsigned int> firstTriangle, triangleCount;
+};
+
+// Function to (re)build the culling data from the meshlet bounds
+void buildClusterCullData(const MeshletMesh& mesh, ClusterCullData& data);
+
+// Compacted argument lists for glMultiDrawElements over an index buffer of
+// 32-bit indices. Visible clusters that are adjacent in the index buffer are
+// merged into a single draw.
+struct DrawCommandList {
+    std::vector<int> counts;
+    std::vector<const void*> offsets;
+    size_t triangleCount = 0;
+};
+
+// Function to cull clusters against the frustum and their normal cones and
+// emit the draws for the survivors
+void cullClusters(const ClusterCullData& data, const Frustum& frustum, const glm::vec3& cameraPos,
+                  bool coneCulling, DrawCommandList& commands);
@@ -0,0 +1,168 @@
+#include "curvature.h"
+#include "parallel.h"
+#include "scratch.h"
+#include <algorithm>
+#include <cmath>
+
+static glm::vec3 position(const Vertex& v) {
+    return glm::vec3(v.x, v.y, v.z);
+}
+
+// Cotangent of the angle between a and b
+static float cotangent(const glm::vec3& a, const glm::vec3& b) {
+    float sine = glm::length(glm::cross(a, b));
+    return glm::dot(a, b) / std::max(sine, 1e-20f);
+}
+
+void computeCurvature(const VertexArray& vertices, const FaceArray& faces,
+                      const Adjacency& vertexFaces, CurvatureField& curvature) {
+    const size_t vertexCount = vertices.size();
+    curvature.mean.resize(vertexCount);
+    curvature.gaussian.resize(vertexCount);
+    curvature.minPrincipal.resize(vertexCount);
+    curvature.maxPrincipal.resize(vertexCount);
+    curvature.minDirection.resize(vertexCount);
+    curvature.maxDirection.resize(vertexCount);
+
+    parallelFor(vertexCount, 1 << 12, [&](size_t begin, size_t end) {
+        // Outgoing and incoming neighbors of the current vertex, to detect boundaries
+        std::vector<int> nextCorners, prevCorners;
+        for (size_t v = begin; v < end; ++v) {
+            const int i = static_cast<int>(v);
+            const unsigned int rowBegin = vertexFaces.offsets[v], rowEnd = vertexFaces.offsets[v + 1];
+            const glm::vec3 xi = position(vertices[v]);
+
+            glm::vec3 laplacian(0.0f), normal(0.0f);
+            float area = 0.0f, angleSum = 0.0f;
+            nextCorners.clear();
+            prevCorners.clear();
+
+            // First pass: cotan Laplacian, mixed area, angle sum and normal
+            for (unsigned int e = rowBegin; e < rowEnd; ++e) {
+                const Face& face = faces[vertexFaces.indices[e]];
+                int j, k;
+                if (face.v1 == i) {
+                    j = face.v2; k = face.v3;
+                } else if (face.v2 == i) {
+                    j = face.v3; k = face.v1;
+                } else {
+                    j = face.v1; k = face.v2;
+                }
+                nextCorners.push_back(j);
+                prevCorners.push_back(k);
+
+                glm::vec3 xj = position(vertices[j]), xk = position(vertices[k]);
+                glm::vec3 eij = xj - xi, eik = xk - xi, ejk = xk - xj;
+                glm::vec3 faceNormal = glm::cross(eij, eik);
+                float faceArea = 0.5f * glm::length(faceNormal);
+                normal += faceNormal;
+
+                float cotJ = cotangent(xi - xj, ejk);
+                float cotK = cotangent(xi - xk, -ejk);
+                laplacian += cotK * eij + cotJ * eik;
+
+                float dotI = glm::dot(eij, eik);
+                angleSum += std::atan2(glm::length(faceNormal), dotI);
+
+                // Mixed Voronoi area (Meyer et al.): Voronoi region unless the triangle is obtuse
+                if (dotI < 0.0f) {
+                    area += 0.5f * faceArea;
+                } else if (glm::dot(-eij, ejk) < 0.0f || glm::dot(-eik, -ejk) < 0.0f) {
+                    area += 0.25f * faceArea;
+                } else {
+                    area += 0.125f * (glm::dot(eij, eij) * cotK + glm::dot(eik, eik) * cotJ);
+                }
+            }
+
+            float normalLength = glm::length(normal);
+            if (rowBegin == rowEnd || area <= 0.0f || normalLength <= 0.0f) {
+                curvature.mean[v] = curvature.gaussian[v] = 0.0f;
+                curvature.minPrincipal[v] = curvature.maxPrincipal[v] = 0.0f;
+                curvature.minDirection[v] = curvature.maxDirection[v] = glm::vec3(0.0f);
+                continue;
+            }
+            normal /= normalLength;
+
+            // Interior fans list every neighbor once as a next and once as a previous corner
+            std::sort(nextCorners.begin(), nextCorners.end());
+            std::sort(prevCorners.begin(), prevCorners.end());
+            bool boundary = nextCorners != prevCorners;
+
+            // Mean curvature normal is -laplacian / (2 area) = 2 H n
+            float mean = -glm::dot(laplacian, normal) / (4.0f * area);
+            float gaussian = ((boundary ? 1.0f : 2.0f) * 3.14159265f - angleSum) / area;
+            float spread = std::sqrt(std::max(mean * mean - gaussian, 0.0f));
+            curvature.mean[v] = mean;
+            curvature.gaussian[v] = gaussian;
+            curvature.maxPrincipal[v] = mean + spread;
+            curvature.minPrincipal[v] = mean - spread;
+
+            // Second pass: least-squares fit of the second fundamental form
+            // [a b; b c] to the normal curvatures along the one-ring edges,
+            // kappa(t) = a tu^2 + 2 b tu tw + c tw^2 in a tangent basis
+            glm::vec3 tangentU = glm::normalize(std::fabs(normal.x) < 0.9f ? glm::cross(normal, glm::vec3(1, 0, 0))
+                                                                             : glm::cross(normal, glm::vec3(0, 1, 0)));
+            glm::vec3 tangentW = glm::cross(normal, tangentU);
+            glm::mat3 normalMatrix(0.0f);
+            glm::vec3 rightHandSide(0.0f);
+            for (unsigned int e = rowBegin; e < rowEnd; ++e) {
+                const Face& face = faces[vertexFaces.indices[e]];
+                const int corners[3] = {face.v1, face.v2, face.v3};
+                for (int corner : corners) {
+                    if (corner == i) {
+                        continue;
+                    }
+                    glm::vec3 edge = position(vertices[corner]) - xi;
+                    float lengthSquared = glm::dot(edge, edge);
+                    glm::vec2 t(glm::dot(edge, tangentU), glm::dot(edge, tangentW));
+                    float tLength = glm::length(t);
+                    if (lengthSquared <= 0.0f || tLength <= 0.0f) {
+                        continue;
+                    }
+                    // Curvature of the circle through both ends tangent to the surface at xi
+                    float kappa = -2.0f * glm::dot(normal, edge) / lengthSquared;
+                    t /= tLength;
+                    glm::vec3 row(t.x * t.x, 2.0f * t.x * t.y, t.y * t.y);
+                    normalMatrix += glm::outerProduct(row, row);
+                    rightHandSide += row * kappa;
+                }
+            }
+
+            // A small ridge keeps low-valence fans solvable
+            float ridge = 1e-6f * (normalMatrix[0][0] + normalMatrix[1][1] + normalMatrix[2][2]) + 1e-12f;
+            normalMatrix += glm::mat3(ridge);
+            glm::vec3 form = glm::inverse(normalMatrix) * rightHandSide;
+            float m00 = form.x, m01 = form.y, m11 = form.z;
+
+            // Eigenvector of the larger eigenvalue of the symmetric 2x2 tensor
+            float angle = 0.5f * std::atan2(2.0f * m01, m00 - m11);
+            glm::vec3 maxDirection = std::cos(angle) * tangentU + std::sin(angle) * tangentW;
+            curvature.maxDirection[v] = maxDirection;
+            curvature.minDirection[v] = glm::cross(normal, maxDirection);
+        }
+    });
+}
+
+float curvatureDisplayScale(const std::vector<float>& values, float percentile) {
+    if (values.empty()) {
+        return 1.0f;
+    }
+
+    // Strided sample keeps this cheap on huge meshes
+    const size_t maxSamples = 1 << 20;
+    size_t stride = std::max<size_t>(1, values.size() / maxSamples);
+    ScratchBuffer<float> magnitudes(values.size() / stride + 1);
+    size_t count = 0;
+    for (size_t i = 0; i < values.size(); i += stride) {
+        if (std::isfinite(values[i])) {
+            magnitudes[count++] = std::fabs(values[i]);
+        }
+    }
+    if (count == 0) {
+        return 1.0f;
+    }
+
+    size_t rank = std::min(count - 1, static_cast<size_t>(percentile * count));
+    std::nth_element(magnitudes.begin(), magnitudes.begin() + rank, magnitudes.begin() + count);
+    return magnitudes[rank] > 0.0f ? magnitudes[rank] : 1.0f;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "adjacency.h"
+#include "mesh.h"
+
+// Per-vertex curvature attributes. Signs follow the area-weighted vertex
+// normal: a convex bump has positive mean curvature for outward normals.
+struct CurvatureField {
+    std::vector<float> mean;
+    std::vector<float> gaussian;
+    std::vector<float> minPrincipal;
+    std::vector<float> maxPrincipal;
+    // Unit tangent directions of the principal curvatures
+    std::vector<glm::vec3> minDirection;
+    std::vector<glm::vec3> maxDirection;
+};
+
+// Function to estimate curvature at every vertex in a parallel gather over
+// its incident faces (from buildVertexFaceAdjacency): mean curvature from the
+// cotan Laplacian over the mixed Voronoi area, Gaussian curvature from the
+// angle defect, principal curvatures from both, and principal directions from
+// a least-squares fit of the second fundamental form to the normal curvatures
+// along the one-ring edges. Isolated vertices get zeros.
+void computeCurvature(const VertexArray& vertices, const FaceArray& faces,
+                      const Adjacency& vertexFaces, CurvatureField& curvature);
+
+// Function to pick a symmetric color-map range: the given percentile of the
+// absolute values, so a few extreme vertices don't wash out the rest
+float curvatureDisplayScale(const std::vector<float>& values, float percentile = 0.95f);
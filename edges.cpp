@@ -0,0 +1,53 @@
+#include "edges.h"
+#include "parallel.h"
+#include "radix_sort.h"
+#include <algorithm>
+#include <cstdint>
+
+std::vector<Edge> extractUniqueEdges(const FaceArray& faces) {
+    const size_t keyCount = faces.size() * 3;
+    std::vector<uint64_t> keys(keyCount);
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            const int corners[3] = {faces[f].v1, faces[f].v2, faces[f].v3};
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = static_cast<uint32_t>(corners[k]);
+                uint32_t b = static_cast<uint32_t>(corners[(k + 1) % 3]);
+                keys[f * 3 + k] = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+            }
+        }
+    });
+    radixSort64(keys);
+
+    // Count the first key of every run per block, then scatter them in order
+    const size_t grain = 1 << 16;
+    const size_t blockCount = std::max<size_t>(1, (keyCount + grain - 1) / grain);
+    std::vector<size_t> blockOffsets(blockCount + 1, 0);
+    auto isHead = [&](size_t i) { return i == 0 || keys[i] != keys[i - 1]; };
+
+    parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t count = 0;
+            for (size_t i = b * grain; i < std::min(keyCount, (b + 1) * grain); ++i) {
+                count += isHead(i) ? 1 : 0;
+            }
+            blockOffsets[b + 1] = count;
+        }
+    });
+    for (size_t b = 0; b < blockCount; ++b) {
+        blockOffsets[b + 1] += blockOffsets[b];
+    }
+
+    std::vector<Edge> edges(blockOffsets[blockCount]);
+    parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t out = blockOffsets[b];
+            for (size_t i = b * grain; i < std::min(keyCount, (b + 1) * grain); ++i) {
+                if (isHead(i)) {
+                    edges[out++] = {static_cast<int>(keys[i] >> 32), static_cast<int>(keys[i] & 0xffffffffu)};
+                }
+            }
+        }
+    });
+    return edges;
+}
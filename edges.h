@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+#include "mesh.h"
+
+// Undirected edge with v0 < v1. The layout matches a pair of GL_UNSIGNED_INT
+// indices, so an edge list can be uploaded directly as a GL_LINES index buffer.
+struct Edge {
+    int v0, v1;
+};
+
+// Function to extract every edge of the faces exactly once, sorted by (v0, v1).
+// Face edges are packed into 64-bit (min, max) keys, radix sorted in parallel
+// and deduplicated with a parallel compaction.
+std::vector<Edge> extractUniqueEdges(const FaceArray& faces);
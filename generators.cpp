@@ -0,0 +1,381 @@
+#include "generators.h"
+#include "parallel.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <glm/glm.hpp>
+
+const float kPi = 3.14159265358979f;
+
+static uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Function to check that the indices of vertexCount vertices fit in a Face
+static bool checkVertexCount(size_t vertexCount, const char* shape) {
+    if (vertexCount > static_cast<size_t>(INT_MAX)) {
+        std::cerr << "Generated " << shape << " would have " << vertexCount << " vertices, more than 32-bit indices allow"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static Vertex toVertex(const glm::vec3& p) {
+    return {p.x, p.y, p.z};
+}
+
+// Function to fill a columns x rows grid of quads, two triangles each, in
+// rows of columns + 1 vertices. faces[2 * (r * columns + c)] and the next one
+// cover cell (r, c); wrapColumns and wrapRows close the grid into a tube or a
+// torus instead, using columns (rows) vertices per row (column).
+static void fillGridFaces(size_t columns, size_t rows, bool wrapColumns, bool wrapRows, FaceArray& faces) {
+    size_t rowVertices = wrapColumns ? columns : columns + 1;
+    size_t vertexRows = wrapRows ? rows : rows + 1;
+    faces.resize(columns * rows * 2);
+    parallelFor(rows, std::max<size_t>(1, 8192 / columns), [&](size_t first, size_t last) {
+        for (size_t r = first; r < last; ++r) {
+            size_t nextRow = (r + 1) % vertexRows;
+            for (size_t c = 0; c < columns; ++c) {
+                size_t nextColumn = (c + 1) % rowVertices;
+                int a = static_cast<int>(r * rowVertices + c);
+                int b = static_cast<int>(r * rowVertices + nextColumn);
+                int d = static_cast<int>(nextRow * rowVertices + c);
+                int e = static_cast<int>(nextRow * rowVertices + nextColumn);
+                faces[2 * (r * columns + c)] = {a, d, b};
+                faces[2 * (r * columns + c) + 1] = {b, d, e};
+            }
+        }
+    });
+}
+
+bool generateIcosphere(int level, float radius, VertexArray& vertices, FaceArray& faces) {
+    // Every icosahedron face is cut into a triangular grid of n rows
+    if (level < 0 || level > 14) {
+        std::cerr << "Icosphere level " << level << " is out of range" << std::endl;
+        return false;
+    }
+    const size_t n = size_t(1) << level;
+    if (!checkVertexCount(10 * n * n + 2, "icosphere")) {
+        return false;
+    }
+
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    const glm::vec3 corners[12] = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0}, {0, -1, t}, {0, 1, t},
+                                   {0, -1, -t}, {0, 1, -t}, {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+    const int baseFaces[20][3] = {{0, 11, 5}, {0, 5, 1},  {0, 1, 7},   {0, 7, 10}, {0, 10, 11},
+                                  {1, 5, 9},  {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+                                  {3, 9, 4},  {3, 4, 2},  {3, 2, 6},   {3, 6, 8},  {3, 8, 9},
+                                  {4, 9, 5},  {2, 4, 11}, {6, 2, 10},  {8, 6, 7},  {9, 8, 1}};
+
+    // Number the 30 edges; each owns the n - 1 vertices inside it, listed from
+    // its lower corner to its higher one
+    int edgeIds[12][12];
+    int edgeEnds[30][2];
+    int edgeCount = 0;
+    for (const auto& face : baseFaces) {
+        for (int k = 0; k < 3; ++k) {
+            int u = std::min(face[k], face[(k + 1) % 3]);
+            int v = std::max(face[k], face[(k + 1) % 3]);
+            bool known = false;
+            for (int e = 0; e < edgeCount; ++e) {
+                known = known || (edgeEnds[e][0] == u && edgeEnds[e][1] == v);
+            }
+            if (!known) {
+                edgeIds[u][v] = edgeIds[v][u] = edgeCount;
+                edgeEnds[edgeCount][0] = u;
+                edgeEnds[edgeCount][1] = v;
+                edgeCount++;
+            }
+        }
+    }
+
+    // Vertices: 12 corners, then the edge vertices, then the inside of each face
+    const size_t edgeBase = 12;
+    const size_t faceBase = edgeBase + 30 * (n - 1);
+    const size_t insidePerFace = n >= 3 ? (n - 1) * (n - 2) / 2 : 0;
+    auto edgeVertex = [&](int u, int v, size_t steps) {
+        size_t along = u < v ? steps : n - steps;
+        return static_cast<int>(edgeBase + edgeIds[u][v] * (n - 1) + along - 1);
+    };
+    // Point (i, j) of face f is corner A moved i steps towards B and j towards C
+    auto gridVertex = [&](size_t f, size_t i, size_t j) {
+        int A = baseFaces[f][0], B = baseFaces[f][1], C = baseFaces[f][2];
+        if (i == 0 && j == 0) {
+            return A;
+        }
+        if (i == n) {
+            return B;
+        }
+        if (j == n) {
+            return C;
+        }
+        if (j == 0) {
+            return edgeVertex(A, B, i);
+        }
+        if (i == 0) {
+            return edgeVertex(A, C, j);
+        }
+        if (i + j == n) {
+            return edgeVertex(B, C, j);
+        }
+        // Inside rows i = 1 .. n - 2 hold n - 1 - i vertices each
+        size_t rowStart = (i - 1) * (n - 1) - (i - 1) * i / 2;
+        return static_cast<int>(faceBase + f * insidePerFace + rowStart + j - 1);
+    };
+    auto onSphere = [&](const glm::vec3& p) {
+        return toVertex(glm::normalize(p) * radius);
+    };
+
+    vertices.resize(10 * n * n + 2);
+    for (int c = 0; c < 12; ++c) {
+        vertices[c] = onSphere(corners[c]);
+    }
+    parallelFor(30 * (n - 1), 4096, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k) {
+            size_t e = k / (n - 1), step = k % (n - 1) + 1;
+            float s = static_cast<float>(step) / n;
+            vertices[edgeBase + k] = onSphere(corners[edgeEnds[e][0]] * (1 - s) + corners[edgeEnds[e][1]] * s);
+        }
+    });
+
+    // Row i of face f holds n - i upward and n - i - 1 downward triangles
+    faces.resize(20 * n * n);
+    parallelFor(20 * n, std::max<size_t>(1, 2048 / n), [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k) {
+            size_t f = k / n, i = k % n;
+            const glm::vec3& A = corners[baseFaces[f][0]];
+            const glm::vec3& B = corners[baseFaces[f][1]];
+            const glm::vec3& C = corners[baseFaces[f][2]];
+            for (size_t j = 1; i > 0 && i + j < n; ++j) {
+                float bi = static_cast<float>(i) / n, cj = static_cast<float>(j) / n;
+                vertices[gridVertex(f, i, j)] = onSphere(A * (1 - bi - cj) + B * bi + C * cj);
+            }
+
+            Face* out = &faces[f * n * n + 2 * n * i - i * i];
+            for (size_t j = 0; i + j < n; ++j) {
+                *out++ = {gridVertex(f, i, j), gridVertex(f, i + 1, j), gridVertex(f, i, j + 1)};
+                if (i + j + 1 < n) {
+                    *out++ = {gridVertex(f, i + 1, j), gridVertex(f, i + 1, j + 1), gridVertex(f, i, j + 1)};
+                }
+            }
+        }
+    });
+    return true;
+}
+
+bool generateNoisyPlane(size_t columns, size_t rows, float amplitude, uint32_t seed, VertexArray& vertices,
+                        FaceArray& faces) {
+    columns = std::max<size_t>(columns, 1);
+    rows = std::max<size_t>(rows, 1);
+    const size_t rowVertices = columns + 1;
+    if (!checkVertexCount(rowVertices * (rows + 1), "plane")) {
+        return false;
+    }
+
+    vertices.resize(rowVertices * (rows + 1));
+    parallelFor(rows + 1, std::max<size_t>(1, 8192 / rowVertices), [&](size_t first, size_t last) {
+        for (size_t r = first; r < last; ++r) {
+            float z = 2.0f * r / rows - 1.0f;
+            for (size_t c = 0; c < rowVertices; ++c) {
+                float x = 2.0f * c / columns - 1.0f;
+                size_t index = r * rowVertices + c;
+                float jitter = hash32(static_cast<uint32_t>(index) ^ hash32(seed)) / 4294967295.0f * 2.0f - 1.0f;
+                float waves = 0.5f * std::sin(3.0f * x) * std::cos(2.0f * z) + 0.25f * std::sin(7.0f * (x + z));
+                vertices[index] = {x, amplitude * (waves + 0.25f * jitter), z};
+            }
+        }
+    });
+    fillGridFaces(columns, rows, false, false, faces);
+    return true;
+}
+
+bool generateTorusKnot(int p, int q, size_t segments, size_t sides, float tubeRadius, VertexArray& vertices,
+                       FaceArray& faces) {
+    segments = std::max<size_t>(segments, 3);
+    sides = std::max<size_t>(sides, 3);
+    if (!checkVertexCount(segments * sides, "torus knot")) {
+        return false;
+    }
+
+    // The curve winds p times around the axis and q times through the hole,
+    // on a torus of radii 2 and 1; the tube is scaled along with it
+    const float scale = 1.0f / (3.0f + tubeRadius);
+    const float P = static_cast<float>(p), Q = static_cast<float>(q);
+    vertices.resize(segments * sides);
+    parallelFor(segments, std::max<size_t>(1, 8192 / sides), [&](size_t first, size_t last) {
+        for (size_t s = first; s < last; ++s) {
+            float t = 2.0f * kPi * s / segments;
+            float r = 2.0f + std::cos(Q * t), dr = -Q * std::sin(Q * t), ddr = -Q * Q * std::cos(Q * t);
+            float cp = std::cos(P * t), sp = std::sin(P * t);
+            glm::vec3 point(r * cp, r * sp, std::sin(Q * t));
+            glm::vec3 velocity(dr * cp - r * P * sp, dr * sp + r * P * cp, Q * std::cos(Q * t));
+            glm::vec3 acceleration(ddr * cp - 2.0f * dr * P * sp - r * P * P * cp,
+                                   ddr * sp + 2.0f * dr * P * cp - r * P * P * sp, -Q * Q * std::sin(Q * t));
+
+            // Frenet frame; the curve is periodic, so the rings close up
+            glm::vec3 tangent = glm::normalize(velocity);
+            glm::vec3 binormal = glm::normalize(glm::cross(velocity, acceleration));
+            glm::vec3 normal = glm::cross(binormal, tangent);
+            // Going round the tube clockwise seen along the curve makes the faces point out
+            for (size_t k = 0; k < sides; ++k) {
+                float angle = 2.0f * kPi * k / sides;
+                glm::vec3 offset = tubeRadius * (std::cos(angle) * normal - std::sin(angle) * binormal);
+                vertices[s * sides + k] = toVertex((point + offset) * scale);
+            }
+        }
+    });
+    fillGridFaces(sides, segments, true, true, faces);
+    return true;
+}
+
+bool generateDefectiveMesh(size_t columns, size_t rows, const MeshDefects& defects, VertexArray& vertices,
+                           FaceArray& faces) {
+    if (!generateNoisyPlane(columns, rows, 0.0f, 0, vertices, faces)) {
+        return false;
+    }
+    columns = std::max<size_t>(columns, 1);
+    rows = std::max<size_t>(rows, 1);
+
+    // Sites are the cells (3a + 1, 3b + 1) clear of the border, so no two
+    // defects share an edge or a vertex
+    const size_t siteColumns = columns / 3;
+    const size_t siteRows = rows / 3;
+    const size_t siteCount = siteColumns * siteRows;
+    const size_t wanted = defects.nonManifoldEdges + defects.degenerateFaces + defects.flippedFaces;
+    if (wanted > siteCount) {
+        std::cerr << "A " << columns << " x " << rows << " grid has room for " << siteCount << " defects, not " << wanted
+                  << std::endl;
+        return false;
+    }
+    if (wanted == 0) {
+        return true;
+    }
+
+    // Fins add one vertex each; degenerate faces add three, then two, in turn
+    const size_t finVertices = defects.nonManifoldEdges;
+    const size_t degenerateVertices = defects.degenerateFaces * 2 + (defects.degenerateFaces + 1) / 2;
+    const size_t baseVertices = vertices.size();
+    const size_t baseFaces = faces.size();
+    if (!checkVertexCount(baseVertices + finVertices + degenerateVertices, "defective mesh")) {
+        return false;
+    }
+    vertices.resize(baseVertices + finVertices + degenerateVertices);
+    faces.resize(baseFaces + defects.nonManifoldEdges + defects.degenerateFaces);
+
+    const float cellSize = 2.0f / std::max(columns, rows);
+    parallelFor(wanted, 1024, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; ++k) {
+            // Spread the defects evenly over the sites
+            size_t site = k * siteCount / wanted;
+            size_t r = 3 * (site / siteColumns) + 1, c = 3 * (site % siteColumns) + 1;
+            size_t cell = r * columns + c;
+            Face& lower = faces[2 * cell];
+            const Vertex& a = vertices[lower.v1];
+            const Vertex& d = vertices[lower.v2];
+            const Vertex& b = vertices[lower.v3];
+
+            if (k < defects.nonManifoldEdges) {
+                // A fin standing on the diagonal b-d
+                size_t v = baseVertices + k;
+                vertices[v] = {(b.x + d.x) * 0.5f, cellSize, (b.z + d.z) * 0.5f};
+                faces[baseFaces + k] = {lower.v3, lower.v2, static_cast<int>(v)};
+            } else if (k < defects.nonManifoldEdges + defects.degenerateFaces) {
+                size_t i = k - defects.nonManifoldEdges;
+                size_t v = baseVertices + finVertices + i * 2 + (i + 1) / 2;
+                int corner = static_cast<int>(v);
+                vertices[v] = {a.x, cellSize, a.z};
+                vertices[v + 1] = {(a.x + b.x) * 0.5f, cellSize, (a.z + b.z) * 0.5f};
+                if (i % 2 == 0) {
+                    // Three distinct corners on one line
+                    vertices[v + 2] = {b.x, cellSize, b.z};
+                    faces[baseFaces + k] = {corner, corner + 1, corner + 2};
+                } else {
+                    faces[baseFaces + k] = {corner, corner + 1, corner};
+                }
+            } else {
+                std::swap(lower.v2, lower.v3);
+            }
+        }
+    });
+    return true;
+}
+
+// Function to read a count such as 250000, 250K, 10M or 1G
+static bool parseCount(const std::string& text, size_t& count) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || value < 0) {
+        return false;
+    }
+    if (*end == 'K' || *end == 'k') {
+        value *= 1e3;
+        end++;
+    } else if (*end == 'M' || *end == 'm') {
+        value *= 1e6;
+        end++;
+    } else if (*end == 'G' || *end == 'g') {
+        value *= 1e9;
+        end++;
+    }
+    count = static_cast<size_t>(value);
+    return *end == '\0';
+}
+
+bool generateMesh(const std::string& spec, VertexArray& vertices, FaceArray& faces) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    for (;;) {
+        size_t colon = spec.find(':', start);
+        parts.push_back(spec.substr(start, colon - start));
+        if (colon == std::string::npos) {
+            break;
+        }
+        start = colon + 1;
+    }
+
+    size_t faceCount = 100000;
+    if (parts.size() > 1 && !parseCount(parts[1], faceCount)) {
+        std::cerr << "Bad face count in " << spec << std::endl;
+        return false;
+    }
+    faceCount = std::max<size_t>(faceCount, 20);
+    const std::string& shape = parts[0];
+
+    if (shape == "icosphere") {
+        // The level whose 20 * 4^level faces come closest, on a log scale
+        int level = static_cast<int>(std::lround(std::log(faceCount / 20.0) / std::log(4.0)));
+        return generateIcosphere(std::max(level, 0), 1.0f, vertices, faces);
+    }
+    if (shape == "plane") {
+        size_t side = static_cast<size_t>(std::sqrt(faceCount / 2.0));
+        return generateNoisyPlane(side, side, 0.1f, 1, vertices, faces);
+    }
+    if (shape == "knot") {
+        // Rings 16 times as far apart around the tube as along it
+        size_t sides = std::max<size_t>(8, static_cast<size_t>(std::sqrt(faceCount / 32.0)));
+        return generateTorusKnot(2, 3, faceCount / 2 / sides, sides, 0.4f, vertices, faces);
+    }
+    if (shape == "defects") {
+        size_t side = static_cast<size_t>(std::sqrt(faceCount / 2.0));
+        MeshDefects defects;
+        defects.nonManifoldEdges = defects.degenerateFaces = defects.flippedFaces = faceCount / 1000;
+        size_t* counts[3] = {&defects.nonManifoldEdges, &defects.degenerateFaces, &defects.flippedFaces};
+        for (size_t i = 2; i < parts.size() && i < 5; ++i) {
+            if (!parseCount(parts[i], *counts[i - 2])) {
+                std::cerr << "Bad defect count in " << spec << std::endl;
+                return false;
+            }
+        }
+        return generateDefectiveMesh(side, side, defects, vertices, faces);
+    }
+    std::cerr << "Unknown mesh shape: " << shape << std::endl;
+    return false;
+}
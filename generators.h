@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mesh.h"
+
+// Synthetic meshes for scaling tests, built in memory in parallel. Every
+// vertex and face is computed from its own index, so the output does not
+// depend on the thread count. Vertex indices are 32-bit, which allows up to
+// about 2^31 vertices (over 4 billion triangles on the closed shapes). The
+// functions return false if the requested mesh would not fit.
+
+// Function to build a geodesic sphere: the icosahedron with every face split
+// into 4^level triangles (20 * 4^level in total), projected onto the sphere
+bool generateIcosphere(int level, float radius, VertexArray& vertices, FaceArray& faces);
+
+// Function to build a columns x rows grid of quads (two triangles each) over
+// [-1, 1]^2 in the xz plane, displaced along y by low-frequency waves plus
+// per-vertex noise of the given amplitude
+bool generateNoisyPlane(size_t columns, size_t rows, float amplitude, uint32_t seed, VertexArray& vertices,
+                        FaceArray& faces);
+
+// Function to build a closed tube of the given radius around the (p, q)
+// torus knot, with segments rings of sides vertices each, scaled to fit in
+// the unit sphere
+bool generateTorusKnot(int p, int q, size_t segments, size_t sides, float tubeRadius, VertexArray& vertices,
+                       FaceArray& faces);
+
+// Defects to plant in a generated mesh. Each is placed in its own grid
+// cell, away from the others and from the border, so the counts are exact.
+struct MeshDefects {
+    // A fin triangle on an interior edge, which then has three faces
+    size_t nonManifoldEdges = 0;
+    // Zero-area triangles on new vertices, alternating three collinear
+    // corners and a repeated corner
+    size_t degenerateFaces = 0;
+    // Reversed faces; each makes its three edges inconsistently oriented
+    size_t flippedFaces = 0;
+};
+
+// Function to build a flat columns x rows grid with the given defects
+bool generateDefectiveMesh(size_t columns, size_t rows, const MeshDefects& defects, VertexArray& vertices,
+                           FaceArray& faces);
+
+// Function to build a mesh from a description "shape:faces", where shape is
+// icosphere, plane, knot or defects and faces (with an optional K, M or G
+// suffix) is the approximate triangle count. "defects:faces:E:D:F" sets the
+// defect counts; by default one face in a thousand gets each kind of defect.
+bool generateMesh(const std::string& spec, VertexArray& vertices, FaceArray& faces);
@@ -0,0 +1,408 @@
+#include "halfedge.h"
+#include "parallel.h"
+#include "radix_sort.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+static uint64_t edgeKey(int a, int b) {
+    uint32_t lo = static_cast<uint32_t>(std::min(a, b));
+    uint32_t hi = static_cast<uint32_t>(std::max(a, b));
+    return (static_cast<uint64_t>(lo) << 32) | hi;
+}
+
+HalfEdgeMesh buildHalfEdgeMesh(size_t vertexCount, const FaceArray& faces) {
+    HalfEdgeMesh mesh;
+    const size_t halfEdgeCount = faces.size() * 3;
+    mesh.next.resize(halfEdgeCount);
+    mesh.twin.assign(halfEdgeCount, -1);
+    mesh.vertex.resize(halfEdgeCount);
+    mesh.face.resize(halfEdgeCount);
+    mesh.flags.assign(halfEdgeCount, 0);
+    mesh.faceHalfEdge.resize(faces.size());
+    mesh.vertexHalfEdge.assign(vertexCount, -1);
+    mesh.vertexFlags.assign(vertexCount, 0);
+
+    // Face f: 3f runs v1->v2, 3f+1 runs v2->v3, 3f+2 runs v3->v1
+    std::vector<uint64_t> keys(halfEdgeCount);
+    std::vector<uint32_t> order(halfEdgeCount);
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            const int corners[3] = {faces[f].v1, faces[f].v2, faces[f].v3};
+            int base = static_cast<int>(f * 3);
+            for (int k = 0; k < 3; ++k) {
+                int h = base + k;
+                mesh.next[h] = base + (k + 1) % 3;
+                mesh.vertex[h] = corners[(k + 1) % 3];
+                mesh.face[h] = static_cast<int>(f);
+                keys[h] = edgeKey(corners[k], corners[(k + 1) % 3]);
+                order[h] = static_cast<uint32_t>(h);
+            }
+            mesh.faceHalfEdge[f] = base;
+        }
+    });
+
+    radixSortPairs64(keys, order);
+
+    // Match runs of equal keys; workers start at the first run that begins in their range
+    std::atomic<size_t> boundaryEdges(0), nonManifoldEdges(0);
+    parallelFor(halfEdgeCount, 1 << 14, [&](size_t begin, size_t end) {
+        size_t i = begin;
+        while (i > 0 && i < halfEdgeCount && keys[i] == keys[i - 1]) {
+            i++;
+        }
+        size_t localBoundary = 0, localNonManifold = 0;
+        while (i < end) {
+            size_t runEnd = i + 1;
+            while (runEnd < halfEdgeCount && keys[runEnd] == keys[i]) {
+                runEnd++;
+            }
+
+            size_t runLength = runEnd - i;
+            if (runLength == 1) {
+                localBoundary++;
+            } else {
+                int h0 = static_cast<int>(order[i]);
+                int h1 = static_cast<int>(order[i + 1]);
+                bool opposite = mesh.vertex[h0] != mesh.vertex[h1];
+                if (runLength == 2 && opposite) {
+                    mesh.twin[h0] = h1;
+                    mesh.twin[h1] = h0;
+                } else {
+                    for (size_t k = i; k < runEnd; ++k) {
+                        mesh.flags[order[k]] |= kHalfEdgeNonManifold;
+                    }
+                    localNonManifold++;
+                }
+            }
+            i = runEnd;
+        }
+        boundaryEdges += localBoundary;
+        nonManifoldEdges += localNonManifold;
+    });
+    mesh.boundaryEdgeCount = boundaryEdges;
+    mesh.nonManifoldEdgeCount = nonManifoldEdges;
+
+    // Outgoing half-edge per vertex, preferring half-edges without a twin
+    for (size_t h = 0; h < halfEdgeCount; ++h) {
+        int origin = originVertex(mesh, static_cast<int>(h));
+        int& current = mesh.vertexHalfEdge[origin];
+        if (current < 0 || (mesh.twin[h] < 0 && mesh.twin[current] >= 0)) {
+            current = static_cast<int>(h);
+        }
+    }
+
+    return mesh;
+}
+
+int vertexValence(const HalfEdgeMesh& mesh, int v) {
+    int valence = 0;
+    forEachOneRingVertex(mesh, v, [&](int) { valence++; });
+    return valence;
+}
+
+int findHalfEdge(const HalfEdgeMesh& mesh, int a, int b) {
+    int result = -1;
+    forEachOutgoingHalfEdge(mesh, a, [&](int h) {
+        if (result < 0 && mesh.vertex[h] == b) {
+            result = h;
+        }
+    });
+    return result;
+}
+
+int nextBoundaryHalfEdge(const HalfEdgeMesh& mesh, int h) {
+    int g = mesh.next[h];
+    int steps = 0;
+    while (mesh.twin[g] >= 0) {
+        g = mesh.next[mesh.twin[g]];
+        if (++steps > static_cast<int>(mesh.next.size())) {
+            return -1;
+        }
+    }
+    return g;
+}
+
+// Point vertexHalfEdge[v] at a live outgoing half-edge, rotating to the
+// boundary one if the fan is open. Candidates are tried in order.
+static void repairVertexHalfEdge(HalfEdgeMesh& mesh, int v, std::initializer_list<int> candidates) {
+    int start = -1;
+    for (int h : candidates) {
+        if (h >= 0 && !(mesh.flags[h] & kHalfEdgeDeleted) && originVertex(mesh, h) == v) {
+            start = h;
+            break;
+        }
+    }
+    mesh.vertexHalfEdge[v] = start;
+    if (start < 0) {
+        return;
+    }
+
+    // Rotate against the circulation direction until the fan opens up
+    int h = start;
+    while (mesh.twin[h] >= 0) {
+        h = mesh.next[mesh.twin[h]];
+        if (h == start) {
+            return;
+        }
+    }
+    mesh.vertexHalfEdge[v] = h;
+}
+
+bool flipEdge(HalfEdgeMesh& mesh, int h) {
+    int t = mesh.twin[h];
+    if (t < 0 || (mesh.flags[h] & (kHalfEdgeDeleted | kHalfEdgeNonManifold))) {
+        return false;
+    }
+
+    int h1 = mesh.next[h], h2 = mesh.next[h1];
+    int t1 = mesh.next[t], t2 = mesh.next[t1];
+    int a = mesh.vertex[h2], b = mesh.vertex[h];
+    int c = mesh.vertex[h1], d = mesh.vertex[t1];
+
+    // The new edge must not exist already, and both endpoints must keep a triangle fan
+    if (c == d || findHalfEdge(mesh, c, d) >= 0 || vertexValence(mesh, a) <= 3 || vertexValence(mesh, b) <= 3) {
+        return false;
+    }
+
+    int f0 = mesh.face[h], f1 = mesh.face[t];
+
+    // f0 becomes (d -> c -> a), f1 becomes (c -> d -> b)
+    mesh.vertex[h] = c;
+    mesh.next[h] = h2;
+    mesh.next[h2] = t1;
+    mesh.next[t1] = h;
+    mesh.face[t1] = f0;
+
+    mesh.vertex[t] = d;
+    mesh.next[t] = t2;
+    mesh.next[t2] = h1;
+    mesh.next[h1] = t;
+    mesh.face[h1] = f1;
+
+    mesh.faceHalfEdge[f0] = h;
+    mesh.faceHalfEdge[f1] = t;
+    if (mesh.vertexHalfEdge[a] == h) {
+        mesh.vertexHalfEdge[a] = t1;
+    }
+    if (mesh.vertexHalfEdge[b] == t) {
+        mesh.vertexHalfEdge[b] = h1;
+    }
+    return true;
+}
+
+void growHalfEdgeMesh(HalfEdgeMesh& mesh, size_t vertexCount, size_t faceCount) {
+    // Unused slots count as deleted until a split fills them
+    mesh.vertexHalfEdge.resize(vertexCount, -1);
+    mesh.vertexFlags.resize(vertexCount, kVertexDeleted);
+    mesh.faceHalfEdge.resize(faceCount, -1);
+    const size_t halfEdgeCount = faceCount * 3;
+    mesh.next.resize(halfEdgeCount, -1);
+    mesh.twin.resize(halfEdgeCount, -1);
+    mesh.vertex.resize(halfEdgeCount, -1);
+    mesh.face.resize(halfEdgeCount, -1);
+    mesh.flags.resize(halfEdgeCount, kHalfEdgeDeleted);
+}
+
+bool splitEdge(HalfEdgeMesh& mesh, int h, int newVertex, int newFace) {
+    if (mesh.flags[h] & (kHalfEdgeDeleted | kHalfEdgeNonManifold)) {
+        return false;
+    }
+
+    // f0 = (a, b, c) becomes (a, m, c) plus F0 = (m, b, c)
+    int t = mesh.twin[h];
+    int h1 = mesh.next[h], h2 = mesh.next[h1];
+    int b = mesh.vertex[h], c = mesh.vertex[h1];
+    int f0 = mesh.face[h], F0 = newFace;
+    int e0 = 3 * F0, e1 = 3 * F0 + 1, e2 = 3 * F0 + 2;
+
+    mesh.vertex[h] = newVertex;
+    mesh.next[h] = e2;
+    mesh.vertex[e2] = c;
+    mesh.next[e2] = h2;
+    mesh.face[e2] = f0;
+
+    mesh.vertex[e0] = b;
+    mesh.next[e0] = h1;
+    mesh.face[e0] = F0;
+    mesh.next[h1] = e1;
+    mesh.face[h1] = F0;
+    mesh.vertex[e1] = newVertex;
+    mesh.next[e1] = e0;
+    mesh.face[e1] = F0;
+    mesh.twin[e1] = e2;
+    mesh.twin[e2] = e1;
+    mesh.flags[e0] = mesh.flags[e1] = mesh.flags[e2] = 0;
+    mesh.faceHalfEdge[f0] = h;
+    mesh.faceHalfEdge[F0] = e0;
+
+    if (t < 0) {
+        // The new vertex sits on the boundary; m -> b is its boundary half-edge
+        mesh.twin[e0] = -1;
+        mesh.vertexHalfEdge[newVertex] = e0;
+    } else {
+        // f1 = (b, a, d) becomes (b, m, d) plus F1 = (m, a, d)
+        int t1 = mesh.next[t], t2 = mesh.next[t1];
+        int a = mesh.vertex[t], d = mesh.vertex[t1];
+        int f1 = mesh.face[t], F1 = newFace + 1;
+        int g0 = 3 * F1, g1 = 3 * F1 + 1, g2 = 3 * F1 + 2;
+
+        mesh.vertex[t] = newVertex;
+        mesh.next[t] = g2;
+        mesh.vertex[g2] = d;
+        mesh.next[g2] = t2;
+        mesh.face[g2] = f1;
+
+        mesh.vertex[g0] = a;
+        mesh.next[g0] = t1;
+        mesh.face[g0] = F1;
+        mesh.next[t1] = g1;
+        mesh.face[t1] = F1;
+        mesh.vertex[g1] = newVertex;
+        mesh.next[g1] = g0;
+        mesh.face[g1] = F1;
+        mesh.twin[g1] = g2;
+        mesh.twin[g2] = g1;
+        mesh.flags[g0] = mesh.flags[g1] = mesh.flags[g2] = 0;
+        mesh.faceHalfEdge[f1] = t;
+        mesh.faceHalfEdge[F1] = g0;
+
+        // a -> m pairs with m -> a, b -> m with m -> b
+        mesh.twin[h] = g0;
+        mesh.twin[g0] = h;
+        mesh.twin[t] = e0;
+        mesh.twin[e0] = t;
+        mesh.vertexHalfEdge[newVertex] = e0;
+    }
+    mesh.vertexFlags[newVertex] = 0;
+    return true;
+}
+
+bool canCollapseEdge(const HalfEdgeMesh& mesh, int h) {
+    if (mesh.flags[h] & (kHalfEdgeDeleted | kHalfEdgeNonManifold)) {
+        return false;
+    }
+    int t = mesh.twin[h];
+    int a = originVertex(mesh, h), b = mesh.vertex[h];
+    int c = mesh.vertex[mesh.next[h]];
+    int d = (t >= 0) ? mesh.vertex[mesh.next[t]] : -1;
+
+    // An interior edge between two boundary vertices would pinch the surface
+    if (t >= 0 && isBoundaryVertex(mesh, a) && isBoundaryVertex(mesh, b)) {
+        return false;
+    }
+
+    // Link condition: the only shared neighbors are the opposite corners
+    bool ok = true;
+    forEachOneRingVertex(mesh, a, [&](int na) {
+        if (!ok || na == b || na == c || na == d) {
+            return;
+        }
+        forEachOneRingVertex(mesh, b, [&](int nb) {
+            if (nb == na) {
+                ok = false;
+            }
+        });
+    });
+    if (!ok) {
+        return false;
+    }
+
+    // Each opposite corner must keep at least one triangle
+    for (int corner : {c, d}) {
+        if (corner >= 0 && vertexValence(mesh, corner) <= 2) {
+            return false;
+        }
+    }
+
+    // Edges about to be glued must be manifold
+    int edges[4] = {mesh.next[h], prevHalfEdge(mesh, h), -1, -1};
+    if (t >= 0) {
+        edges[2] = mesh.next[t];
+        edges[3] = prevHalfEdge(mesh, t);
+    }
+    for (int e : edges) {
+        if (e >= 0 && (mesh.flags[e] & kHalfEdgeNonManifold)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Remove the face of h from the surface, gluing the twins of its other two edges
+static void removeCollapsedFace(HalfEdgeMesh& mesh, int h) {
+    int h1 = mesh.next[h], h2 = mesh.next[h1];
+    int x = mesh.twin[h1], y = mesh.twin[h2];
+    if (x >= 0) {
+        mesh.twin[x] = y;
+    }
+    if (y >= 0) {
+        mesh.twin[y] = x;
+    }
+    mesh.faceHalfEdge[mesh.face[h]] = -1;
+    mesh.flags[h] |= kHalfEdgeDeleted;
+    mesh.flags[h1] |= kHalfEdgeDeleted;
+    mesh.flags[h2] |= kHalfEdgeDeleted;
+}
+
+bool collapseEdge(HalfEdgeMesh& mesh, int h) {
+    if (!canCollapseEdge(mesh, h)) {
+        return false;
+    }
+
+    int t = mesh.twin[h];
+    int a = originVertex(mesh, h), b = mesh.vertex[h];
+    int h1 = mesh.next[h], h2 = mesh.next[h1];
+    int c = mesh.vertex[h1];
+    int x0 = mesh.twin[h1], y0 = mesh.twin[h2];
+    int d = -1, x1 = -1, y1 = -1;
+    if (t >= 0) {
+        int t1 = mesh.next[t], t2 = mesh.next[t1];
+        d = mesh.vertex[t1];
+        x1 = mesh.twin[t1];
+        y1 = mesh.twin[t2];
+    }
+    int oldA = mesh.vertexHalfEdge[a], oldB = mesh.vertexHalfEdge[b];
+
+    // Every half-edge that ended at a now ends at b
+    forEachOutgoingHalfEdge(mesh, a, [&](int g) { mesh.vertex[prevHalfEdge(mesh, g)] = b; });
+
+    removeCollapsedFace(mesh, h);
+    if (t >= 0) {
+        removeCollapsedFace(mesh, t);
+    }
+    mesh.vertexFlags[a] |= kVertexDeleted;
+    mesh.vertexHalfEdge[a] = -1;
+
+    // y0 (b -> c) and y1 (b -> d) now start at b; x0 starts at c and x1 at d
+    repairVertexHalfEdge(mesh, b, {y0, y1, oldB, oldA});
+    repairVertexHalfEdge(mesh, c, {x0, mesh.vertexHalfEdge[c]});
+    if (d >= 0) {
+        repairVertexHalfEdge(mesh, d, {x1, mesh.vertexHalfEdge[d]});
+    }
+    return true;
+}
+
+void extractMesh(const HalfEdgeMesh& mesh, VertexArray& vertices, FaceArray& faces) {
+    // Compact the surviving vertices in place
+    std::vector<int> remap(vertices.size(), -1);
+    size_t kept = 0;
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        if (v < mesh.vertexFlags.size() && (mesh.vertexFlags[v] & kVertexDeleted)) {
+            continue;
+        }
+        remap[v] = static_cast<int>(kept);
+        vertices[kept++] = vertices[v];
+    }
+    vertices.resize(kept);
+
+    faces.clear();
+    faces.reserve(mesh.faceHalfEdge.size());
+    for (int h : mesh.faceHalfEdge) {
+        if (h < 0) {
+            continue;
+        }
+        int h1 = mesh.next[h], h2 = mesh.next[h1];
+        faces.push_back({remap[mesh.vertex[h2]], remap[mesh.vertex[h]], remap[mesh.vertex[h1]]});
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "mesh.h"
+
+// Per half-edge flags
+const unsigned char kHalfEdgeDeleted = 1;
+const unsigned char kHalfEdgeNonManifold = 2;
+
+// Per vertex flags
+const unsigned char kVertexDeleted = 1;
+
+// Index-based half-edge connectivity for a triangle mesh, stored as parallel
+// arrays. Half-edge h runs from origin(h) to vertex[h] inside face[h]; twin[h]
+// is the opposite half-edge, or -1 on boundary and non-manifold edges.
+// Face f initially owns half-edges 3f, 3f + 1 and 3f + 2. Positions stay in
+// the caller's vertex array, indexed the same way.
+struct HalfEdgeMesh {
+    std::vector<int> next;
+    std::vector<int> twin;
+    std::vector<int> vertex;
+    std::vector<int> face;
+    std::vector<unsigned char> flags;
+
+    // One outgoing half-edge per vertex (the boundary one if the vertex has
+    // one, -1 if the vertex is isolated) and one half-edge per face (-1 once
+    // the face is deleted)
+    std::vector<int> vertexHalfEdge;
+    std::vector<unsigned char> vertexFlags;
+    std::vector<int> faceHalfEdge;
+
+    size_t boundaryEdgeCount = 0;
+    size_t nonManifoldEdgeCount = 0;
+};
+
+// Function to build the half-edge structure from an indexed face list. Edges
+// are matched by sorting packed (min, max) vertex keys; edges shared by more
+// than two faces, or by two faces with clashing orientation, are flagged
+// kHalfEdgeNonManifold and left without twins.
+HalfEdgeMesh buildHalfEdgeMesh(size_t vertexCount, const FaceArray& faces);
+
+inline int prevHalfEdge(const HalfEdgeMesh& mesh, int h) {
+    return mesh.next[mesh.next[h]];
+}
+
+inline int originVertex(const HalfEdgeMesh& mesh, int h) {
+    return mesh.vertex[prevHalfEdge(mesh, h)];
+}
+
+inline bool isBoundaryHalfEdge(const HalfEdgeMesh& mesh, int h) {
+    return mesh.twin[h] < 0;
+}
+
+inline bool isBoundaryVertex(const HalfEdgeMesh& mesh, int v) {
+    int h = mesh.vertexHalfEdge[v];
+    return h >= 0 && mesh.twin[h] < 0;
+}
+
+// Function to call fn(h) for every outgoing half-edge of v. Starting at the
+// boundary half-edge (if any) guarantees the whole fan is visited.
+template <typename Fn>
+void forEachOutgoingHalfEdge(const HalfEdgeMesh& mesh, int v, Fn fn) {
+    int start = mesh.vertexHalfEdge[v];
+    if (start < 0) {
+        return;
+    }
+    int h = start;
+    do {
+        fn(h);
+        h = mesh.twin[prevHalfEdge(mesh, h)];
+    } while (h >= 0 && h != start);
+}
+
+// Function to call fn(neighbor) for every vertex in the one-ring of v, in order
+template <typename Fn>
+void forEachOneRingVertex(const HalfEdgeMesh& mesh, int v, Fn fn) {
+    int start = mesh.vertexHalfEdge[v];
+    if (start < 0) {
+        return;
+    }
+    int h = start;
+    for (;;) {
+        fn(mesh.vertex[h]);
+        int incoming = prevHalfEdge(mesh, h);
+        int following = mesh.twin[incoming];
+        if (following < 0) {
+            // Open fan: the last neighbor sits across the closing boundary edge
+            fn(mesh.vertex[mesh.next[h]]);
+            return;
+        }
+        if (following == start) {
+            return;
+        }
+        h = following;
+    }
+}
+
+// Function to count the edges around v
+int vertexValence(const HalfEdgeMesh& mesh, int v);
+
+// Function to find the half-edge from a to b, or -1 if there is none
+int findHalfEdge(const HalfEdgeMesh& mesh, int a, int b);
+
+// Function to step from boundary half-edge h to the boundary half-edge that
+// starts where h ends
+int nextBoundaryHalfEdge(const HalfEdgeMesh& mesh, int h);
+
+// Function to walk the boundary loop containing boundary half-edge h,
+// calling fn for every half-edge; returns the loop length
+template <typename Fn>
+size_t walkBoundaryLoop(const HalfEdgeMesh& mesh, int h, Fn fn) {
+    size_t length = 0;
+    int current = h;
+    do {
+        fn(current);
+        current = nextBoundaryHalfEdge(mesh, current);
+        length++;
+    } while (current >= 0 && current != h && length <= mesh.next.size());
+    return length;
+}
+
+// Function to flip the interior edge of h to connect the two opposite corners.
+// Returns false (and leaves the mesh untouched) if the flip is not allowed.
+bool flipEdge(HalfEdgeMesh& mesh, int h);
+
+// Function to add unused (deleted) vertex and face slots, with three
+// half-edges per face, so that splits can run concurrently on preassigned slots
+void growHalfEdgeMesh(HalfEdgeMesh& mesh, size_t vertexCount, size_t faceCount);
+
+// Function to split the edge of h at vertex slot newVertex, which lands on
+// the edge between origin(h) and vertex[h]. The two adjacent faces are split
+// in two, using face slots newFace and newFace + 1 (only newFace on a
+// boundary edge) and their half-edges. Returns false (and leaves the mesh
+// untouched) for deleted and non-manifold edges.
+bool splitEdge(HalfEdgeMesh& mesh, int h, int newVertex, int newFace);
+
+// Function to test whether collapsing h keeps the mesh manifold (link condition)
+bool canCollapseEdge(const HalfEdgeMesh& mesh, int h);
+
+// Function to collapse h, merging its origin into its target vertex. The one
+// or two adjacent faces and the origin vertex are marked deleted. Returns
+// false (and leaves the mesh untouched) if the collapse is not allowed.
+bool collapseEdge(HalfEdgeMesh& mesh, int h);
+
+// Function to write back an indexed mesh, dropping deleted faces and vertices
+// and compacting the vertex array to match
+void extractMesh(const HalfEdgeMesh& mesh, VertexArray& vertices, FaceArray& faces);
@@ -0,0 +1,117 @@
+#include "history.h"
+#include <utility>
+
+static size_t entryBytes(const HistoryEntry& entry) {
+    return vertexDeltaBytes(entry.delta) + entry.vertices.capacity() * sizeof(Vertex) +
+           entry.faces.capacity() * sizeof(Face) + entry.label.capacity();
+}
+
+static void clearRedo(EditHistory& history) {
+    for (const auto& entry : history.redo) {
+        history.memoryUsed -= entryBytes(entry);
+    }
+    history.redo.clear();
+}
+
+// Function to push an entry and drop the oldest undo steps that no longer fit
+static void pushUndo(EditHistory& history, HistoryEntry&& entry) {
+    history.memoryUsed += entryBytes(entry);
+    history.undo.push_back(std::move(entry));
+    while (history.memoryUsed > history.memoryBudget && !history.undo.empty()) {
+        history.memoryUsed -= entryBytes(history.undo.front());
+        history.undo.pop_front();
+    }
+}
+
+void resetEditHistory(EditHistory& history, const VertexArray& vertices) {
+    history.undo.clear();
+    history.redo.clear();
+    history.memoryUsed = 0;
+    history.committed = vertices;
+}
+
+void recountEditHistoryMemory(EditHistory& history) {
+    history.memoryUsed = 0;
+    for (const auto& entry : history.undo) {
+        history.memoryUsed += entryBytes(entry);
+    }
+    for (const auto& entry : history.redo) {
+        history.memoryUsed += entryBytes(entry);
+    }
+}
+
+void recordVertexEdit(EditHistory& history, const std::string& label, const VertexArray& vertices) {
+    if (vertices.size() != history.committed.size()) {
+        return;
+    }
+    HistoryEntry entry;
+    entry.label = label;
+    entry.delta = encodeVertexDelta(history.committed, vertices);
+    if (entry.delta.blocks.empty()) {
+        return;
+    }
+    entry.delta.bytes.shrink_to_fit();
+
+    // Bring the committed copy up to date through the delta, touching only the changed blocks
+    applyVertexDelta(entry.delta, history.committed);
+    clearRedo(history);
+    pushUndo(history, std::move(entry));
+}
+
+void recordTopologyEdit(EditHistory& history, const std::string& label, VertexArray&& previousVertices,
+                        FaceArray&& previousFaces, const VertexArray& vertices) {
+    HistoryEntry entry;
+    entry.label = label;
+    entry.topology = true;
+    entry.vertices = std::move(previousVertices);
+    entry.faces = std::move(previousFaces);
+    history.committed = vertices;
+    clearRedo(history);
+    pushUndo(history, std::move(entry));
+}
+
+// Function to apply entry to the mesh, turning it into the entry for the opposite direction
+static void swapEntry(EditHistory& history, HistoryEntry& entry, VertexArray& vertices,
+                      FaceArray& faces) {
+    if (entry.topology) {
+        // Swapping hands the current mesh to the entry, ready for the way back
+        history.memoryUsed -= entryBytes(entry);
+        std::swap(entry.vertices, vertices);
+        std::swap(entry.faces, faces);
+        history.memoryUsed += entryBytes(entry);
+        history.committed = vertices;
+    } else {
+        // XOR deltas step both ways
+        applyVertexDelta(entry.delta, vertices);
+        applyVertexDelta(entry.delta, history.committed);
+    }
+}
+
+static bool stepHistory(EditHistory& history, std::deque<HistoryEntry>& from, std::deque<HistoryEntry>& to,
+                        VertexArray& vertices, FaceArray& faces, bool& topologyChanged,
+                        std::string& label) {
+    topologyChanged = false;
+    if (from.empty()) {
+        return false;
+    }
+    HistoryEntry& entry = from.back();
+    if (!entry.topology && entry.delta.vertexCount != vertices.size()) {
+        return false;
+    }
+    swapEntry(history, entry, vertices, faces);
+    topologyChanged = entry.topology;
+    label = entry.label;
+    to.push_back(std::move(entry));
+    from.pop_back();
+    return true;
+}
+
+bool undoEdit(EditHistory& history, VertexArray& vertices, FaceArray& faces, bool& topologyChanged,
+              std::string& label) {
+    return stepHistory(history, history.undo, history.redo, vertices, faces, topologyChanged, label);
+}
+
+bool redoEdit(EditHistory& history, VertexArray& vertices, FaceArray& faces, bool& topologyChanged,
+              std::string& label) {
+    return stepHistory(history, history.redo, history.undo, vertices, faces, topologyChanged, label);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "snapshot.h"
+
+// One undoable operation. Edits that only move vertices keep a sparse XOR
+// delta against the previous positions, so they cost memory in proportion to
+// what changed. Edits that change the topology keep the other side's whole
+// mesh, which is swapped in and out on undo and redo.
+struct HistoryEntry {
+    std::string label;
+    VertexDelta delta;
+    bool topology = false;
+    VertexArray vertices;
+    FaceArray faces;
+};
+
+// Undo and redo stacks of mesh edits. committed holds the positions at the
+// latest recorded edit, which vertex edits are diffed against. When the
+// entries exceed memoryBudget bytes, the oldest undo steps are dropped.
+struct EditHistory {
+    std::deque<HistoryEntry> undo;
+    std::deque<HistoryEntry> redo;
+    VertexArray committed;
+    size_t memoryBudget = 512u << 20;
+    size_t memoryUsed = 0;
+};
+
+// Function to forget every edit and start from the given positions
+void resetEditHistory(EditHistory& history, const VertexArray& vertices);
+
+// Function to add up memoryUsed again from the entries, after the stacks
+// were filled from outside (loading a session)
+void recountEditHistoryMemory(EditHistory& history);
+
+// Function to record the vertex moves made since the last recorded edit.
+// Nothing is recorded if no vertex changed. Clears the redo stack.
+void recordVertexEdit(EditHistory& history, const std::string& label, const VertexArray& vertices);
+
+// Function to record a topology change, taking over the mesh as it was before
+// the edit. vertices is the mesh after it. Clears the redo stack.
+void recordTopologyEdit(EditHistory& history, const std::string& label, VertexArray&& previousVertices,
+                        FaceArray&& previousFaces, const VertexArray& vertices);
+
+// Function to undo the latest edit. Returns false if there is nothing to
+// undo; sets topologyChanged when faces were replaced. Vertex edits only touch
+// the blocks they changed.
+bool undoEdit(EditHistory& history, VertexArray& vertices, FaceArray& faces, bool& topologyChanged,
+              std::string& label);
+
+// Function to redo the latest undone edit, like undoEdit
+bool redoEdit(EditHistory& history, VertexArray& vertices, FaceArray& faces, bool& topologyChanged,
+              std::string& label);
@@ -0,0 +1,123 @@
+#include "jobs.h"
+#include "trace.h"
+
+MeshVersion makeMeshVersion(MeshJobRunner& runner, std::shared_ptr<const VertexArray> vertices,
+                            std::shared_ptr<const FaceArray> faces) {
+    MeshVersion version;
+    version.vertices = std::move(vertices);
+    version.faces = std::move(faces);
+    version.id = runner.nextVersionId++;
+    runner.currentVersionId = version.id;
+    return version;
+}
+
+static void runWorker(MeshJobRunner& runner) {
+    setTraceThreadName("mesh jobs");
+    for (;;) {
+        MeshJob job;
+        std::shared_ptr<MeshJobProgress> progress;
+        {
+            std::unique_lock<std::mutex> lock(runner.mutex);
+            runner.wake.wait(lock, [&]() { return runner.stopping || !runner.queue.empty(); });
+            if (runner.stopping) {
+                return;
+            }
+            job = std::move(runner.queue.front());
+            runner.queue.pop_front();
+            progress = std::make_shared<MeshJobProgress>();
+            runner.progress = progress;
+            runner.runningLabel = job.label;
+            runner.busy = true;
+        }
+
+        // The one copy of the positions is made here, off the render thread;
+        // the input stays untouched for everyone else sharing it
+        VertexArray output = *job.input.vertices;
+        bool done = job.run(job.input, output, *progress);
+        if (done && !progress->cancelRequested.load()) {
+            MeshJobResult result;
+            result.label = job.label;
+            result.tag = job.tag;
+            result.inputId = job.input.id;
+            result.vertices = std::move(output);
+            publishTripleBuffer(runner.results, std::move(result));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(runner.mutex);
+            runner.busy = false;
+            runner.progress.reset();
+            runner.finishedJobs.fetch_add(1, std::memory_order_release);
+        }
+        runner.idle.notify_all();
+    }
+}
+
+void startMeshJobRunner(MeshJobRunner& runner) {
+    runner.stopping = false;
+    runner.worker = std::thread(runWorker, std::ref(runner));
+}
+
+void stopMeshJobRunner(MeshJobRunner& runner) {
+    cancelMeshJobs(runner);
+    {
+        std::lock_guard<std::mutex> lock(runner.mutex);
+        runner.stopping = true;
+    }
+    runner.wake.notify_all();
+    if (runner.worker.joinable()) {
+        runner.worker.join();
+    }
+}
+
+void submitMeshJob(MeshJobRunner& runner, const std::string& label, const MeshVersion& input, MeshJobFunction run,
+                   int tag) {
+    {
+        std::lock_guard<std::mutex> lock(runner.mutex);
+        runner.queue.push_back({label, tag, input, std::move(run)});
+        runner.submittedJobs++;
+    }
+    runner.wake.notify_one();
+}
+
+bool pollMeshJob(MeshJobRunner& runner, MeshJobResult& result) {
+    if (!takeTripleBuffer(runner.results, result)) {
+        return false;
+    }
+    if (result.inputId != runner.currentVersionId) {
+        result = MeshJobResult();
+        return false;
+    }
+    return true;
+}
+
+bool meshJobsPending(MeshJobRunner& runner) {
+    // A job publishes its result before it counts as finished
+    return runner.finishedJobs.load(std::memory_order_acquire) != runner.submittedJobs ||
+           tripleBufferHasValue(runner.results);
+}
+
+bool meshJobProgress(MeshJobRunner& runner, std::string& label, float& fraction) {
+    std::lock_guard<std::mutex> lock(runner.mutex);
+    if (!runner.busy || !runner.progress) {
+        return false;
+    }
+    label = runner.runningLabel;
+    fraction = runner.progress->fraction.load();
+    return true;
+}
+
+void cancelMeshJobs(MeshJobRunner& runner) {
+    {
+        std::unique_lock<std::mutex> lock(runner.mutex);
+        runner.finishedJobs.fetch_add(runner.queue.size(), std::memory_order_release);
+        runner.queue.clear();
+        if (runner.progress) {
+            runner.progress->cancelRequested = true;
+        }
+        runner.idle.wait(lock, [&]() { return !runner.busy; });
+    }
+    runner.currentVersionId = 0;
+    MeshJobResult discarded;
+    takeTripleBuffer(runner.results, discarded);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mesh.h"
+
+// Single-producer, single-consumer handoff of the latest value. The writer
+// fills its back slot and swaps it with the middle one; the reader swaps its
+// front slot with the middle one when it holds something new. Neither side
+// ever waits, and values the reader was too slow to take are overwritten.
+template <typename T>
+struct TripleBuffer {
+    T slots[3];
+    // Bits 0-1 hold the index of the middle slot, bit 2 is set while it is unread
+    std::atomic<unsigned int> middle{1};
+    unsigned int back = 0;  // owned by the writer
+    unsigned int front = 2; // owned by the reader
+};
+
+template <typename T>
+void publishTripleBuffer(TripleBuffer<T>& buffer, T&& value) {
+    buffer.slots[buffer.back] = std::move(value);
+    buffer.back = buffer.middle.exchange(buffer.back | 4u, std::memory_order_acq_rel) & 3u;
+}
+
+template <typename T>
+bool tripleBufferHasValue(const TripleBuffer<T>& buffer) {
+    return (buffer.middle.load(std::memory_order_acquire) & 4u) != 0;
+}
+
+// Function to take the newest published value. Returns false if nothing new
+// was published since the last call.
+template <typename T>
+bool takeTripleBuffer(TripleBuffer<T>& buffer, T& value) {
+    if (!tripleBufferHasValue(buffer)) {
+        return false;
+    }
+    buffer.front = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel) & 3u;
+    value = std::move(buffer.slots[buffer.front]);
+    buffer.slots[buffer.front] = T();
+    return true;
+}
+
+// The mesh as a job sees it. The positions are the caller's live array,
+// shared rather than copied, so the caller must leave them alone until the
+// jobs on the version are done or cancelled; the faces stay shared between
+// versions until the topology changes.
+struct MeshVersion {
+    std::shared_ptr<const VertexArray> vertices;
+    std::shared_ptr<const FaceArray> faces;
+    uint64_t id = 0;
+};
+
+struct MeshJobProgress {
+    std::atomic<float> fraction{0.0f};
+    std::atomic<bool> cancelRequested{false};
+};
+
+// A job edits output, which starts as a copy of the input positions, and
+// returns false if it gave up (for example after a cancel request)
+typedef std::function<bool(const MeshVersion& input, VertexArray& output, MeshJobProgress& progress)>
+    MeshJobFunction;
+
+struct MeshJobResult {
+    std::string label;
+    int tag = 0;
+    uint64_t inputId = 0;
+    VertexArray vertices;
+};
+
+struct MeshJob {
+    std::string label;
+    int tag = 0;
+    MeshVersion input;
+    MeshJobFunction run;
+};
+
+// One worker thread running mesh jobs in submission order. The kernels inside
+// a job still split their work with parallelFor. Results go through a triple
+// buffer, so the render thread picks them up without blocking.
+struct MeshJobRunner {
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<MeshJob> queue;
+    bool stopping = false;
+    bool busy = false;
+    std::shared_ptr<MeshJobProgress> progress; // of the running job
+    std::string runningLabel;
+    TripleBuffer<MeshJobResult> results;
+
+    // Submitted is only touched by the submitting thread
+    uint64_t submittedJobs = 0;
+    std::atomic<uint64_t> finishedJobs{0};
+    uint64_t nextVersionId = 1;
+    // Newest version handed out; results computed from older ones are dropped
+    uint64_t currentVersionId = 0;
+};
+
+// Function to make a new version of the mesh from the shared positions and faces
+MeshVersion makeMeshVersion(MeshJobRunner& runner, std::shared_ptr<const VertexArray> vertices,
+                            std::shared_ptr<const FaceArray> faces);
+
+void startMeshJobRunner(MeshJobRunner& runner);
+
+// Function to cancel all jobs and join the worker
+void stopMeshJobRunner(MeshJobRunner& runner);
+
+// Function to queue a job on a mesh version. tag is passed through to the result.
+void submitMeshJob(MeshJobRunner& runner, const std::string& label, const MeshVersion& input, MeshJobFunction run,
+                   int tag = 0);
+
+// Function to take the newest finished result, if any. Results of jobs on
+// versions older than the latest one made, or made before a cancel, are dropped.
+bool pollMeshJob(MeshJobRunner& runner, MeshJobResult& result);
+
+// Function to test whether a submitted job has not finished or its result has not been taken
+bool meshJobsPending(MeshJobRunner& runner);
+
+// Function to read the label and progress of the running job. Returns false when idle.
+bool meshJobProgress(MeshJobRunner& runner, std::string& label, float& fraction);
+
+// Function to drop the queued jobs, ask the running one to stop, wait for it
+// and discard any result that was not taken yet
+void cancelMeshJobs(MeshJobRunner& runner);
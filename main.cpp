@@ -1,29 +1,44 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <string>
 #include <cmath>
 #include <random>
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cctype>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <filesystem>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-
-// Define structures for vertices, faces, and normals
-struct Vertex {
-    float x, y, z;
-};
-
-struct Face {
-    int v1, v2, v3;
-};
-
-struct Normal {
-    float x, y, z;
-};
+#include "mesh.h"
+#include "meshlet.h"
+#include "culling.h"
+#include "bvh.h"
+#include "halfedge.h"
+#include "edges.h"
+#include "components.h"
+#include "mesh_report.h"
+#include "adjacency.h"
+#include "curvature.h"
+#include "subdivision.h"
+#include "remesh.h"
+#include "smoothing.h"
+#include "snapshot.h"
+#include "history.h"
+#include "out_of_core.h"
+#include "scratch.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "mesh_io.h"
+#include "session.h"
+#include "generators.h"
+#include "trace.h"
 
 // Camera variables
 glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
@@ -35,146 +50,23 @@ float pitch = 0.0f;
 float lastX = 400, lastY = 300;
 bool firstMouse = true;
 
+// Picking variables
+bool pickMode = false;
+double cursorX = 0.0, cursorY = 0.0;
+
 // Mesh color
 glm::vec3 meshColor(0.5f, 0.5f, 0.5f);
 
-// Function to load an OBJ file
-bool loadOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<Face>& faces) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return false;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string type;
-        iss >> type;
-
-        if (type == "v") {
-            // Parse vertex data
-            Vertex vertex;
-            iss >> vertex.x >> vertex.y >> vertex.z;
-            // Increase the size by 20%
-            vertex.x *= 2.2f;
-            vertex.y *= 2.2f;
-            vertex.z *= 2.2f;
-            vertices.push_back(vertex);
-        }
-        else if (type == "f") {
-            // Parse face data
-            Face face;
-            iss >> face.v1 >> face.v2 >> face.v3;
-            // OBJ file indices start at 1, so we subtract 1 to convert to 0-based indexing
-            face.v1--; face.v2--; face.v3--;
-            faces.push_back(face);
-        }
-        // Ignore other types (vn, vt, etc.)
-    }
-
-    file.close();
-    return true;
-}
-
-// Function to calculate face normal
-Normal calculateFaceNormal(const Vertex& v1, const Vertex& v2, const Vertex& v3) {
-    // Calculate two vectors on the face
-    float ux = v2.x - v1.x;
-    float uy = v2.y - v1.y;
-    float uz = v2.z - v1.z;
-    
-    float vx = v3.x - v1.x;
-    float vy = v3.y - v1.y;
-    float vz = v3.z - v1.z;
-    
-    // Calculate cross product to get normal
-    Normal normal;
-    normal.x = uy * vz - uz * vy;
-    normal.y = uz * vx - ux * vz;
-    normal.z = ux * vy - uy * vx;
-    
-    // Normalize the normal vector
-    float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
-    if (length != 0) {
-        normal.x /= length;
-        normal.y /= length;
-        normal.z /= length;
-    }
-    
-    return normal;
-}
-
-// Function to add noise to vertices along their normals
-void addNoiseToVertices(std::vector<Vertex>& vertices, const std::vector<Normal>& vertexNormals, float noiseStrength) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(-1.0, 1.0);
-
-    for (size_t i = 0; i < vertices.size(); ++i) {
-        float noise = noiseStrength * dis(gen);
-        vertices[i].x += vertexNormals[i].x * noise;
-        vertices[i].y += vertexNormals[i].y * noise;
-        vertices[i].z += vertexNormals[i].z * noise;
-    }
-}
-
-// Function to perform Laplacian smoothing (mesh denoising)
-void laplacianSmoothing(std::vector<Vertex>& vertices, const std::vector<Face>& faces, float smoothingFactor) {
-    std::vector<Vertex> newVertices = vertices;
-
-    for (size_t i = 0; i < vertices.size(); ++i) {
-        Vertex sum = {0, 0, 0};
-        int count = 0;
-
-        // Find all neighboring vertices
-        for (const auto& face : faces) {
-            if (face.v1 == i || face.v2 == i || face.v3 == i) {
-                if (face.v1 != i) {
-                    sum.x += vertices[face.v1].x;
-                    sum.y += vertices[face.v1].y;
-                    sum.z += vertices[face.v1].z;
-                    count++;
-                }
-                if (face.v2 != i) {
-                    sum.x += vertices[face.v2].x;
-                    sum.y += vertices[face.v2].y;
-                    sum.z += vertices[face.v2].z;
-                    count++;
-                }
-                if (face.v3 != i) {
-                    sum.x += vertices[face.v3].x;
-                    sum.y += vertices[face.v3].y;
-                    sum.z += vertices[face.v3].z;
-                    count++;
-                }
-            }
-        }
-
-        // Calculate the average position of neighbors
-        if (count > 0) {
-            sum.x /= count;
-            sum.y /= count;
-            sum.z /= count;
-
-            // Move the vertex towards the average position
-            newVertices[i].x += (sum.x - vertices[i].x) * smoothingFactor;
-            newVertices[i].y += (sum.y - vertices[i].y) * smoothingFactor;
-            newVertices[i].z += (sum.z - vertices[i].z) * smoothingFactor;
-        }
-    }
-
-    vertices = newVertices;
-}
-
 // Vertex shader source code
 const char* vertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec3 aPos;
     layout (location = 1) in vec3 aNormal;
+    layout (location = 2) in float aCurvature;
     
     out vec3 FragPos;
     out vec3 Normal;
+    out float Curvature;
     
     uniform mat4 model;
     uniform mat4 view;
@@ -184,6 +76,7 @@ const char* vertexShaderSource = R"(
     {
         FragPos = vec3(model * vec4(aPos, 1.0));
         Normal = mat3(transpose(inverse(model))) * aNormal;  
+        Curvature = aCurvature;
         
         gl_Position = projection * view * vec4(FragPos, 1.0);
     }
@@ -196,6 +89,7 @@ const char* fragmentShaderSource = R"(
     
     in vec3 FragPos;
     in vec3 Normal;
+    in float Curvature;
     
     uniform vec3 lightPos;
     uniform vec3 viewPos;
@@ -203,10 +97,17 @@ const char* fragmentShaderSource = R"(
     uniform vec3 objectColor;
     uniform bool usePhongShading;
     uniform bool useWireframe;
+    uniform bool useHighlight;
+    uniform vec3 highlightColor;
+    uniform bool useCurvature;
+    uniform float curvatureScale;
+    uniform bool useFlatNormals;
     
     void main()
     {
-        if (useWireframe) {
+        if (useHighlight) {
+            FragColor = vec4(highlightColor, 1.0); // Flat color for picked elements
+        } else if (useWireframe) {
             FragColor = vec4(1.0, 1.0, 1.0, 1.0); // White color for wireframe
         } else {
             // ambient lighting
@@ -214,7 +115,8 @@ const char* fragmentShaderSource = R"(
             vec3 ambient = ambientStrength * lightColor;
             
             // diffuse lighting
-            vec3 norm = normalize(Normal);
+            // Meshes still loading have no vertex normals yet; use the face normal instead
+            vec3 norm = useFlatNormals ? normalize(cross(dFdx(FragPos), dFdy(FragPos))) : normalize(Normal);
             vec3 lightDir = normalize(lightPos - FragPos);
             float diff = max(dot(norm, lightDir), 0.0);
             vec3 diffuse = diff * lightColor;
@@ -226,12 +128,19 @@ const char* fragmentShaderSource = R"(
             float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
             vec3 specular = specularStrength * spec * lightColor;
             
+            // Diverging color map for curvature: blue (negative), white, red (positive)
+            vec3 baseColor = objectColor;
+            if (useCurvature) {
+                float t = clamp(Curvature / curvatureScale, -1.0, 1.0);
+                baseColor = t < 0.0 ? mix(vec3(1.0), vec3(0.1, 0.3, 1.0), -t) : mix(vec3(1.0), vec3(1.0, 0.15, 0.1), t);
+            }
+            
             // Final color calculation
             vec3 result;
             if (usePhongShading) {
-                result = (ambient + diffuse + specular) * objectColor;
+                result = (ambient + diffuse + specular) * baseColor;
             } else {
-                result = (ambient + diffuse) * objectColor;
+                result = (ambient + diffuse) * baseColor;
             }
             FragColor = vec4(result, 1.0);
         }
@@ -294,8 +203,45 @@ GLuint createShaderProgram() {
     return shaderProgram;
 }
 
+// Function to upload the triangle indices in meshlet order to the bound element buffer
+void uploadMeshletIndices(const MeshletMesh& meshletMesh) {
+    std::vector<unsigned int> meshletIndices(meshletMesh.meshletFaces.size() * 3);
+    for (const auto& meshlet : meshletMesh.meshlets) {
+        for (unsigned int t = 0; t < meshlet.triangleCount * 3; ++t) {
+            unsigned int local = meshletMesh.meshletTriangles[meshlet.triangleOffset * 3 + t];
+            meshletIndices[meshlet.triangleOffset * 3 + t] = meshletMesh.meshletVertices[meshlet.vertexOffset + local];
+        }
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshletIndices.size() * sizeof(unsigned int), meshletIndices.data(), GL_STATIC_DRAW);
+}
+
+// Function to build a world-space ray through a cursor position
+Ray cursorRay(double x, double y, int width, int height, const glm::mat4& viewProjection) {
+    float ndcX = static_cast<float>(2.0 * x / width - 1.0);
+    float ndcY = static_cast<float>(1.0 - 2.0 * y / height);
+
+    glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    nearPoint /= nearPoint.w;
+    farPoint /= farPoint.w;
+
+    Ray ray;
+    ray.origin = glm::vec3(nearPoint);
+    ray.direction = glm::normalize(glm::vec3(farPoint) - glm::vec3(nearPoint));
+    return ray;
+}
+
 // Mouse callback function
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
+    // In pick mode the cursor is free and only its position is tracked
+    if (pickMode) {
+        cursorX = xpos;
+        cursorY = ypos;
+        firstMouse = true;
+        return;
+    }
+
     if (firstMouse) {
         lastX = xpos;
         lastY = ypos;
@@ -331,126 +277,462 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     cameraPos += cameraSpeed * cameraFront * static_cast<float>(yoffset);
 }
 
-int main() {
-    std::vector<Vertex> vertices;
-    std::vector<Face> faces;
-    
-    // Load OBJ file
-    if (loadOBJ("/Users/haritshah/Desktop/Assignment296/bunny.obj", vertices, faces)) {
-        std::cout << "Loaded " << vertices.size() << " vertices and " << faces.size() << " faces." << std::endl;
-        
-        // Calculate flat face normals
-        std::vector<Normal> faceNormals;
-        for (const auto& face : faces) {
-            Normal normal = calculateFaceNormal(vertices[face.v1], vertices[face.v2], vertices[face.v3]);
-            faceNormals.push_back(normal);
+// Function to grow a GL buffer to at least the given size, keeping its first usedBytes
+void reserveGLBuffer(GLenum target, GLuint& buffer, size_t& capacityBytes, size_t requiredBytes, size_t usedBytes) {
+    if (requiredBytes <= capacityBytes) {
+        return;
+    }
+    size_t newCapacity = std::max(requiredBytes, capacityBytes * 2);
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+    if (usedBytes > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = grown;
+    capacityBytes = newCapacity;
+    glBindBuffer(target, buffer);
+}
+
+// Function to load an OBJ file on a loader thread while drawing what has
+// arrived so far. Chunks are appended to buffers preallocated from the file
+// size and the camera backs off to keep the growing bounds in view. Returns
+// false if the file could not be read or the window was closed first.
+bool streamOBJ(GLFWwindow* window, GLuint shaderProgram, const std::string& filename, VertexArray& vertices,
+               FaceArray& faces) {
+    auto loadStart = std::chrono::steady_clock::now();
+    OBJStream stream;
+    if (!startOBJStream(stream, filename)) {
+        return false;
+    }
+
+    // Typical OBJ files take about 70 bytes per vertex, with twice as many faces as vertices
+    size_t vertexBytes = std::max<size_t>(stream.fileSize / 70, 1024) * sizeof(Vertex);
+    size_t faceBytes = std::max<size_t>(stream.fileSize / 35, 1024) * sizeof(Face);
+    GLuint loadVAO, loadVBO, loadEBO;
+    glGenVertexArrays(1, &loadVAO);
+    glGenBuffers(1, &loadVBO);
+    glGenBuffers(1, &loadEBO);
+    glBindVertexArray(loadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, loadVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, loadEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, faceBytes, nullptr, GL_STATIC_DRAW);
+
+    // Positions only; the normal and curvature attributes are constants while loading
+    auto bindLoadAttributes = [&]() {
+        glBindVertexArray(loadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, loadVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, loadEBO);
+    };
+    bindLoadAttributes();
+    glVertexAttrib3f(1, 0.0f, 0.0f, 1.0f);
+    glVertexAttrib1f(2, 0.0f);
+
+    glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
+    glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
+    glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, glm::value_ptr(lightPos));
+    glUniform3fv(glGetUniformLocation(shaderProgram, "lightColor"), 1, glm::value_ptr(lightColor));
+    glm::mat4 model = glm::mat4(1.0f);
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+    glUniform1i(glGetUniformLocation(shaderProgram, "usePhongShading"), true);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useWireframe"), false);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useHighlight"), false);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useCurvature"), false);
+    glUniform1i(glGetUniformLocation(shaderProgram, "useFlatNormals"), true);
+    glEnable(GL_DEPTH_TEST);
+
+    size_t uploadedVertices = 0;
+    size_t uploadedFaces = 0;
+    glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+    bool firstPixel = false;
+    bool closed = false;
+    while (!objStreamDone(stream)) {
+        if (glfwWindowShouldClose(window) || glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+            closed = true;
+            break;
         }
-        
-        // Calculate smoothed vertex normals
-        std::vector<Normal> vertexNormals(vertices.size(), {0, 0, 0});
-        std::vector<int> vertexFaceCount(vertices.size(), 0);
-        
-        for (size_t i = 0; i < faces.size(); ++i) {
-            const auto& face = faces[i];
-            const auto& normal = faceNormals[i];
-            
-            // Add face normal to each vertex of the face
-            vertexNormals[face.v1].x += normal.x;
-            vertexNormals[face.v1].y += normal.y;
-            vertexNormals[face.v1].z += normal.z;
-            vertexFaceCount[face.v1]++;
-            
-            vertexNormals[face.v2].x += normal.x;
-            vertexNormals[face.v2].y += normal.y;
-            vertexNormals[face.v2].z += normal.z;
-            vertexFaceCount[face.v2]++;
-            
-            vertexNormals[face.v3].x += normal.x;
-            vertexNormals[face.v3].y += normal.y;
-            vertexNormals[face.v3].z += normal.z;
-            vertexFaceCount[face.v3]++;
+
+        OBJChunk chunk;
+        bool arrived = false;
+        while (takeOBJChunk(stream, chunk)) {
+            arrived = true;
+            for (const Vertex& v : chunk.vertices) {
+                boundsMin = glm::min(boundsMin, glm::vec3(v.x, v.y, v.z));
+                boundsMax = glm::max(boundsMax, glm::vec3(v.x, v.y, v.z));
+            }
+            vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+            faces.insert(faces.end(), chunk.faces.begin(), chunk.faces.end());
         }
-        
-        // Normalize vertex normals
-        for (size_t i = 0; i < vertexNormals.size(); ++i) {
-            if (vertexFaceCount[i] > 0) {
-                // Average the normal
-                vertexNormals[i].x /= vertexFaceCount[i];
-                vertexNormals[i].y /= vertexFaceCount[i];
-                vertexNormals[i].z /= vertexFaceCount[i];
-                
-                // Normalize the normal vector
-                float length = std::sqrt(vertexNormals[i].x * vertexNormals[i].x + 
-                                         vertexNormals[i].y * vertexNormals[i].y + 
-                                         vertexNormals[i].z * vertexNormals[i].z);
-                if (length != 0) {
-                    vertexNormals[i].x /= length;
-                    vertexNormals[i].y /= length;
-                    vertexNormals[i].z /= length;
+
+        if (arrived) {
+            TRACE_SCOPE("uploadOBJChunks");
+            // Append the new vertices, then every face whose corners have all arrived
+            glBindVertexArray(loadVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, loadVBO);
+            reserveGLBuffer(GL_ARRAY_BUFFER, loadVBO, vertexBytes, vertices.size() * sizeof(Vertex),
+                            uploadedVertices * sizeof(Vertex));
+            glBufferSubData(GL_ARRAY_BUFFER, uploadedVertices * sizeof(Vertex),
+                            (vertices.size() - uploadedVertices) * sizeof(Vertex), vertices.data() + uploadedVertices);
+            uploadedVertices = vertices.size();
+
+            size_t readyFaces = uploadedFaces;
+            while (readyFaces < faces.size()) {
+                const Face& face = faces[readyFaces];
+                if (static_cast<size_t>(std::max({face.v1, face.v2, face.v3})) >= uploadedVertices) {
+                    break;
                 }
+                readyFaces++;
             }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, loadEBO);
+            reserveGLBuffer(GL_ELEMENT_ARRAY_BUFFER, loadEBO, faceBytes, readyFaces * sizeof(Face),
+                            uploadedFaces * sizeof(Face));
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, uploadedFaces * sizeof(Face),
+                            (readyFaces - uploadedFaces) * sizeof(Face), faces.data() + uploadedFaces);
+            uploadedFaces = readyFaces;
+            // Growing a buffer replaces it, so point the VAO at the current ones
+            bindLoadAttributes();
         }
-        
-        std::cout << "Calculated " << faceNormals.size() << " face normals and " 
-                  << vertexNormals.size() << " vertex normals." << std::endl;
-        
-        // Initialize GLFW and create window
-        GLFWwindow* window = initializeWindow();
-        if (!window) {
+
+        // Frame the bounds loaded so far along the current view direction
+        glm::vec3 center(0.0f);
+        float radius = 1.0f;
+        if (uploadedVertices > 0) {
+            center = (boundsMin + boundsMax) * 0.5f;
+            radius = std::max(glm::length(boundsMax - boundsMin) * 0.5f, 1e-3f);
+            cameraPos = center - glm::normalize(cameraFront) * (radius / std::tan(glm::radians(22.5f)) * 1.1f);
+        }
+        float distance = glm::length(cameraPos - center);
+
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f,
+                                                std::max(distance - radius * 2.0f, distance * 1e-3f),
+                                                distance + radius * 2.0f);
+        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+        glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, glm::value_ptr(cameraPos));
+        glUniform3fv(glGetUniformLocation(shaderProgram, "objectColor"), 1, glm::value_ptr(meshColor));
+        glBindVertexArray(loadVAO);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(uploadedFaces * 3), GL_UNSIGNED_INT, 0);
+
+        double percent = stream.fileSize ? 100.0 * stream.bytesRead.load() / stream.fileSize : 100.0;
+        std::string title = "Mesh Viewer - loading " + std::to_string(static_cast<int>(percent)) + "%, " +
+                            std::to_string(uploadedVertices) + " vertices, " + std::to_string(uploadedFaces) + " faces";
+        glfwSetWindowTitle(window, title.c_str());
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+
+        if (!firstPixel && uploadedFaces > 0) {
+            firstPixel = true;
+            double firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+            std::cout << "First faces drawn after " << firstMs << " ms." << std::endl;
+        }
+    }
+    stopOBJStream(stream);
+
+    glUniform1i(glGetUniformLocation(shaderProgram, "useFlatNormals"), false);
+    glDeleteVertexArrays(1, &loadVAO);
+    glDeleteBuffers(1, &loadVBO);
+    glDeleteBuffers(1, &loadEBO);
+    glBindVertexArray(0);
+
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    if (closed || stream.failed) {
+        return false;
+    }
+    std::cout << "Streamed " << filename << " in " << loadMs << " ms." << std::endl;
+    return true;
+}
+
+// Function to map the mesh files in directory, converting objPath into them
+// first if they do not exist yet. Edits to the mesh are written to the files.
+bool openMeshDirectory(const std::string& directory, const std::string& objPath, VertexArray& vertices,
+                       FaceArray& faces) {
+    if (!std::filesystem::exists(directory + "/vertices.bin")) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        auto convertStart = std::chrono::steady_clock::now();
+        if (error || !convertOBJToMeshFiles(objPath, directory)) {
+            std::cerr << "Failed to convert " << objPath << " into " << directory << std::endl;
+            return false;
+        }
+        double convertMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - convertStart).count();
+        std::cout << "Converted " << objPath << " into " << directory << " in " << convertMs << " ms." << std::endl;
+    }
+    return openMappedMesh(directory, vertices, faces, true);
+}
+
+// Function to save the mesh to path: an OBJ or PLY file by its extension, with
+// normals computed from the current positions, or else a session file that
+// keeps the shown normals, the denoise state and the undo history too
+bool saveMeshFile(const std::string& path, const VertexArray& vertices, const FaceArray& faces,
+                  const std::vector<Normal>& normals, const VertexArray& originalVertices, int denoiseLevel,
+                  const EditHistory& history) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    auto saveStart = std::chrono::steady_clock::now();
+    bool saved = false;
+    if (extension == ".obj" || extension == ".ply") {
+        std::vector<Normal> currentNormals;
+        calculateVertexNormals(vertices, faces, currentNormals);
+        saved = extension == ".obj" ? writeOBJ(path, vertices, faces, &currentNormals)
+                                    : writePLY(path, vertices, faces, &currentNormals);
+    } else {
+        saved = saveSession(path, vertices, faces, normals, originalVertices, denoiseLevel, history);
+    }
+    double saveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - saveStart).count();
+    if (saved) {
+        std::cout << "Saved " << path << " in " << saveMs << " ms." << std::endl;
+    } else {
+        std::cerr << "Failed to save " << path << std::endl;
+    }
+    return saved;
+}
+
+int main(int argc, char** argv) {
+    // Background jobs share the live positions instead of copying them, so
+    // they only change while no job is running (or after cancelJobs)
+    std::shared_ptr<VertexArray> liveVertices = std::make_shared<VertexArray>();
+    VertexArray& vertices = *liveVertices;
+    FaceArray faces;
+
+    // Usage: app [mesh.obj | --generate shape:faces] [--report report.json] [--threads N] [--pin-threads] [--bench-scheduler] [--trace trace.json]
+    //        app mesh.obj --out-of-core output.obj [--smooth N] [--decimate ratio] [--chunk-faces N] [--memory MB]
+    //        app [mesh.obj] --mapped directory [--report report.json]
+    //        app mesh.obj --count-allocations
+    //        app [mesh.obj | --session session.bin] [--save output.obj|output.ply|session.bin] [--report report.json]
+    std::string meshPath = "/Users/haritshah/Desktop/Assignment296/bunny.obj";
+    std::string reportPath;
+    std::string tracePath;
+    std::string generateSpec;
+    bool benchScheduler = false;
+    bool countAllocations = false;
+    std::string outOfCorePath;
+    std::string mappedDirectory;
+    std::string sessionPath;
+    std::string savePath;
+    // Bytes for the undo history and for the cached denoise levels; 0 keeps their defaults
+    size_t editMemoryBudget = 0;
+    ChunkedMeshOptions chunkOptions;
+    ChunkProcessing chunkProcessing;
+    chunkProcessing.smoothingIterations = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--report" && i + 1 < argc) {
+            reportPath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            setParallelThreadCount(static_cast<unsigned int>(std::max(0, std::atoi(argv[++i]))));
+        } else if (arg == "--pin-threads") {
+            setParallelCpuPinning(true);
+        } else if (arg == "--generate" && i + 1 < argc) {
+            generateSpec = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "--bench-scheduler") {
+            benchScheduler = true;
+        } else if (arg == "--count-allocations") {
+            countAllocations = true;
+        } else if (arg == "--mapped" && i + 1 < argc) {
+            mappedDirectory = argv[++i];
+        } else if (arg == "--session" && i + 1 < argc) {
+            sessionPath = argv[++i];
+        } else if (arg == "--save" && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (arg == "--out-of-core" && i + 1 < argc) {
+            outOfCorePath = argv[++i];
+        } else if (arg == "--smooth" && i + 1 < argc) {
+            chunkProcessing.smoothingIterations = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--decimate" && i + 1 < argc) {
+            chunkProcessing.decimationRatio = std::min(1.0f, std::max(0.0f, static_cast<float>(std::atof(argv[++i]))));
+        } else if (arg == "--chunk-faces" && i + 1 < argc) {
+            chunkOptions.targetFacesPerChunk = static_cast<size_t>(std::max(1ll, std::atoll(argv[++i])));
+        } else if (arg == "--memory" && i + 1 < argc) {
+            chunkOptions.memoryBudget = static_cast<size_t>(std::max(1ll, std::atoll(argv[++i]))) << 20;
+        } else if (arg == "--history-memory" && i + 1 < argc) {
+            editMemoryBudget = static_cast<size_t>(std::max(1ll, std::atoll(argv[++i]))) << 20;
+        } else {
+            meshPath = arg;
+        }
+    }
+
+    // Record per-stage timings from here on
+    if (!tracePath.empty()) {
+        setTraceThreadName("main");
+        setTraceEnabled(true);
+    }
+
+    // Measure the task scheduler and exit
+    if (benchScheduler) {
+        SchedulerBenchmark benchmark = benchmarkScheduler();
+        std::cout << "Scheduler with " << benchmark.threadCount << " threads: " << benchmark.spawnNanoseconds
+                  << " ns per spawned task (" << benchmark.tasksPerSecond / 1e6 << " M tasks/s), "
+                  << benchmark.parallelForNanoseconds << " ns per parallelFor range." << std::endl;
+        return 0;
+    }
+
+    // Process a mesh larger than memory chunk by chunk and exit
+    if (!outOfCorePath.empty()) {
+        std::string chunkDirectory = outOfCorePath + ".chunks";
+        chunkOptions.haloRings = std::max(chunkProcessing.smoothingIterations - 1, 0) + 1;
+        auto processStart = std::chrono::steady_clock::now();
+        bool processed = buildChunkedMesh(meshPath, chunkDirectory, chunkOptions) &&
+                         processChunkedMesh(chunkDirectory, chunkProcessing, outOfCorePath);
+        double processMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+        if (processed) {
+            std::error_code error;
+            std::filesystem::remove_all(chunkDirectory, error);
+            std::cout << "Processed " << meshPath << " out of core in " << processMs << " ms." << std::endl;
+        }
+        if (!tracePath.empty()) {
+            writeChromeTrace(tracePath);
+        }
+        return processed ? 0 : -1;
+    }
+
+    // Write the quality report and exit without opening a window
+    std::vector<Normal> sessionNormals;
+    VertexArray sessionOriginalVertices;
+    int sessionDenoiseLevel = 0;
+    EditHistory sessionHistory;
+    if (!reportPath.empty()) {
+        bool loaded = !sessionPath.empty() ? loadSession(sessionPath, vertices, faces, sessionNormals,
+                                                         sessionOriginalVertices, sessionDenoiseLevel, sessionHistory)
+                      : !mappedDirectory.empty() ? openMeshDirectory(mappedDirectory, meshPath, vertices, faces)
+                      : generateSpec.empty()     ? loadOBJ(meshPath, vertices, faces)
+                                                 : generateMesh(generateSpec, vertices, faces);
+        if (!loaded) {
+            std::cerr << "Failed to load OBJ file" << std::endl;
             return -1;
         }
+        auto reportStart = std::chrono::steady_clock::now();
+        MeshReport report = computeMeshReport(vertices, faces);
+        double reportMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - reportStart).count();
+        std::cerr << "Analyzed mesh in " << reportMs << " ms." << std::endl;
+        bool written = writeMeshReport(report, reportPath);
+        if (!savePath.empty()) {
+            if (sessionPath.empty()) {
+                calculateVertexNormals(vertices, faces, sessionNormals);
+                sessionOriginalVertices = vertices;
+                resetEditHistory(sessionHistory, vertices);
+            }
+            written = saveMeshFile(savePath, vertices, faces, sessionNormals, sessionOriginalVertices,
+                                   sessionDenoiseLevel, sessionHistory) && written;
+        }
+        if (!tracePath.empty()) {
+            writeChromeTrace(tracePath);
+        }
+        return written ? 0 : -1;
+    }
+
+    // Initialize GLFW and create window
+    GLFWwindow* window = initializeWindow();
+    if (!window) {
+        return -1;
+    }
+
+    // Set up mouse callback
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    // Capture the mouse
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-        // Set up mouse callback
-        glfwSetCursorPosCallback(window, mouse_callback);
-        glfwSetScrollCallback(window, scroll_callback);
+    // Create and use shader program
+    GLuint shaderProgram = createShaderProgram();
+    glUseProgram(shaderProgram);
 
-        // Capture the mouse
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // Load the OBJ file while the window already shows it arriving, or resume a session, or map or generate the mesh
+    bool loaded = !sessionPath.empty() ? loadSession(sessionPath, vertices, faces, sessionNormals,
+                                                     sessionOriginalVertices, sessionDenoiseLevel, sessionHistory)
+                  : !mappedDirectory.empty() ? openMeshDirectory(mappedDirectory, meshPath, vertices, faces)
+                  : generateSpec.empty()     ? streamOBJ(window, shaderProgram, meshPath, vertices, faces)
+                                             : generateMesh(generateSpec, vertices, faces);
+    if (loaded) {
+        std::cout << "Loaded " << vertices.size() << " vertices and " << faces.size() << " faces." << std::endl;
+        
+        // Calculate smoothed vertex normals, unless the session kept them
+        std::vector<Normal> vertexNormals;
+        if (sessionNormals.size() == vertices.size() && !vertices.empty()) {
+            vertexNormals = std::move(sessionNormals);
+        } else {
+            calculateVertexNormals(vertices, faces, vertexNormals);
+        }
 
-        // Create and use shader program
-        GLuint shaderProgram = createShaderProgram();
-        glUseProgram(shaderProgram);
+        std::cout << "Calculated " << faces.size() << " face normals and " 
+                  << vertexNormals.size() << " vertex normals." << std::endl;
+
+        // Partition faces into meshlets with culling bounds
+        auto meshletStart = std::chrono::steady_clock::now();
+        MeshletMesh meshletMesh = buildMeshlets(vertices, faces);
+        double meshletMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshletStart).count();
+        std::cout << "Built " << meshletMesh.meshlets.size() << " meshlets in " << meshletMs << " ms." << std::endl;
+
+        // Build half-edge connectivity and report problem edges
+        HalfEdgeMesh halfEdges = buildHalfEdgeMesh(vertices.size(), faces);
+        std::cout << "Found " << halfEdges.boundaryEdgeCount << " boundary edges and "
+                  << halfEdges.nonManifoldEdgeCount << " non-manifold edges." << std::endl;
+
+        // Label connected components; stray fragments show up as tiny ones
+        auto componentStart = std::chrono::steady_clock::now();
+        ComponentLabels componentLabels = labelConnectedComponents(vertices, faces);
+        double componentMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - componentStart).count();
+        size_t largestComponent = 0;
+        for (const auto& component : componentLabels.components) {
+            largestComponent = std::max(largestComponent, component.faceCount);
+        }
+        std::cout << "Found " << componentLabels.components.size() << " connected components (largest has "
+                  << largestComponent << " faces) in " << componentMs << " ms." << std::endl;
 
-        // Create Vertex Array Object (VAO) and Vertex Buffer Object (VBO)
-        GLuint VAO, VBO;
+        // Build the ray query acceleration structure
+        auto bvhStart = std::chrono::steady_clock::now();
+        DynamicBVH dynamicBVH;
+        resetDynamicBVH(dynamicBVH, vertices, faces);
+        double bvhMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bvhStart).count();
+        std::cout << "Built BVH with " << dynamicBVH.bvh.nodes.size() << " nodes in " << bvhMs << " ms." << std::endl;
+
+
+        // Create Vertex Array Object (VAO), Vertex Buffer Object (VBO) and Element Buffer Object (EBO)
+        GLuint VAO, VBO, EBO;
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
 
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-        // Prepare data for VBO
+        // Prepare data for VBO: one position and normal per vertex
         std::vector<float> meshData;
-        for (const auto& face : faces) {
-            // For each vertex in the face, add position and normal data
-            // Vertex 1
-            meshData.push_back(vertices[face.v1].x);
-            meshData.push_back(vertices[face.v1].y);
-            meshData.push_back(vertices[face.v1].z);
-            meshData.push_back(vertexNormals[face.v1].x);
-            meshData.push_back(vertexNormals[face.v1].y);
-            meshData.push_back(vertexNormals[face.v1].z);
-
-            // Vertex 2
-            meshData.push_back(vertices[face.v2].x);
-            meshData.push_back(vertices[face.v2].y);
-            meshData.push_back(vertices[face.v2].z);
-            meshData.push_back(vertexNormals[face.v2].x);
-            meshData.push_back(vertexNormals[face.v2].y);
-            meshData.push_back(vertexNormals[face.v2].z);
-
-            // Vertex 3
-            meshData.push_back(vertices[face.v3].x);
-            meshData.push_back(vertices[face.v3].y);
-            meshData.push_back(vertices[face.v3].z);
-            meshData.push_back(vertexNormals[face.v3].x);
-            meshData.push_back(vertexNormals[face.v3].y);
-            meshData.push_back(vertexNormals[face.v3].z);
-        }
+        packVertexData(vertices, vertexNormals, meshData);
 
         // Send data to GPU
         glBufferData(GL_ARRAY_BUFFER, meshData.size() * sizeof(float), meshData.data(), GL_STATIC_DRAW);
 
+        // Indices in meshlet order, so every cluster is a contiguous range of the EBO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        uploadMeshletIndices(meshletMesh);
+
+        // Cluster bounds for per-frame frustum and backface culling
+        ClusterCullData cullData;
+        buildClusterCullData(meshletMesh, cullData);
+        DrawCommandList drawCommands;
+        bool useClusterCulling = true;
+        bool keyXPressed = false;
+        double lastTitleUpdate = 0.0;
+
+        bool keyPPressed = false;
+        int pickedFace = -1;
+        int pickedVertex = -1;
+        double pickMicroseconds = 0.0;
+
         // Set vertex attribute pointers
         // Position attribute
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
@@ -458,6 +740,55 @@ int main() {
         // Normal attribute
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
         glEnableVertexAttribArray(1);
+        // Curvature attribute, kept in its own buffer and only filled while a curvature mode is shown
+        GLuint curvatureVBO;
+        glGenBuffers(1, &curvatureVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, curvatureVBO);
+        std::vector<float> zeroCurvature(vertices.size(), 0.0f);
+        glBufferData(GL_ARRAY_BUFFER, zeroCurvature.size() * sizeof(float), zeroCurvature.data(), GL_DYNAMIC_DRAW);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+        glEnableVertexAttribArray(2);
+
+        // Curvature display state; the vertex-face adjacency is cached until the topology changes
+        Adjacency vertexFaces;
+        CurvatureField curvature;
+        const char* curvatureModeNames[] = {"off", "mean", "Gaussian", "max principal", "min principal"};
+        int curvatureMode = 0;
+        bool curvatureDirty = true;
+        bool curvatureUploadNeeded = false;
+        float curvatureScale = 1.0f;
+        bool keyVPressed = false;
+
+        // Wireframe shares the VBO and draws the unique edge list with GL_LINES
+        auto edgeStart = std::chrono::steady_clock::now();
+        std::vector<Edge> edges = extractUniqueEdges(faces);
+        double edgeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - edgeStart).count();
+        std::cout << "Extracted " << edges.size() << " unique edges in " << edgeMs << " ms." << std::endl;
+
+        GLuint wireVAO, wireEBO;
+        glGenVertexArrays(1, &wireVAO);
+        glGenBuffers(1, &wireEBO);
+        glBindVertexArray(wireVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wireEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, edges.size() * sizeof(Edge), edges.data(), GL_STATIC_DRAW);
+
+        // Picked face and vertex, drawn on top of the mesh from a small VBO
+        GLuint highlightVAO, highlightVBO;
+        glGenVertexArrays(1, &highlightVAO);
+        glGenBuffers(1, &highlightVBO);
+        glBindVertexArray(highlightVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, highlightVBO);
+        glBufferData(GL_ARRAY_BUFFER, 4 * 6 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(VAO);
 
         // Set up uniforms
         glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
@@ -472,11 +803,83 @@ int main() {
         bool usePhongShading = true;
         bool useWireframe = false;
         bool noiseAdded = false;
+        bool noisePending = false;
+        bool verticesMoved = false;
         float noiseStrength = 0.01f;
         float smoothingFactor = 0.5f;
-        std::vector<Vertex> originalVertices = vertices;
+        VertexArray originalVertices = vertices;
         bool keyDPressed = false;
         int denoiseLevel = 0;
+        // Denoising uses the colored Gauss-Seidel sweep unless switched back to
+        // the original Jacobi pass; the neighbors and coloring are cached until
+        // the topology changes
+        bool useColoredSmoothing = true;
+        bool keyGPressed = false;
+        std::shared_ptr<SmoothingGraph> smoothingGraph = std::make_shared<SmoothingGraph>();
+        // Denoise levels already computed are kept as compressed deltas, so
+        // cycling back through them only decodes
+        SnapshotCache denoiseCache;
+
+        // Undo history; held noise is recorded as one edit when the key is released
+        EditHistory history;
+        resetEditHistory(history, vertices);
+        bool keyZPressed = false;
+        bool keyYPressed = false;
+
+        // A resumed session continues with its denoise state and undo history
+        if (!sessionPath.empty() && sessionHistory.committed.size() == vertices.size()) {
+            history = std::move(sessionHistory);
+            if (sessionOriginalVertices.size() == vertices.size()) {
+                originalVertices = std::move(sessionOriginalVertices);
+                denoiseLevel = sessionDenoiseLevel;
+            }
+        }
+        if (editMemoryBudget != 0) {
+            history.memoryBudget = editMemoryBudget;
+            denoiseCache.memoryBudget = editMemoryBudget;
+        }
+        bool keyOPressed = false;
+
+        // Noise and denoising run as background jobs on snapshots of the mesh
+        // while the last result stays on screen. The faces and normals are
+        // shared with the jobs until the topology changes.
+        const int kNoiseJob = 1;
+        const int kDenoiseJob = 2;
+        MeshJobRunner jobs;
+        startMeshJobRunner(jobs);
+        std::shared_ptr<const FaceArray> sharedFaces;
+        std::shared_ptr<const std::vector<Normal>> sharedNormals;
+        bool denoiseJobPending = false;
+        auto currentMeshVersion = [&]() {
+            if (!sharedFaces) {
+                sharedFaces = std::make_shared<const FaceArray>(faces);
+            }
+            return makeMeshVersion(jobs, liveVertices, sharedFaces);
+        };
+        // A cancelled denoise step never reached its level
+        auto cancelJobs = [&]() {
+            cancelMeshJobs(jobs);
+            if (denoiseJobPending) {
+                denoiseJobPending = false;
+                denoiseLevel--;
+            }
+        };
+        // Topology edits work on the heap; the mapped files keep the mesh from before the first one
+        auto moveMeshToHeap = [&]() {
+            if (!isMappedArray(vertices) && !isMappedArray(faces)) {
+                return;
+            }
+            bool verticesClosed = moveArrayToHeap(vertices);
+            bool facesClosed = moveArrayToHeap(faces);
+            if (!verticesClosed || !facesClosed) {
+                std::cerr << "Failed to write the mesh back to " << mappedDirectory << std::endl;
+            }
+            std::cout << "Topology edits stay in memory; " << mappedDirectory << " keeps the mesh from before them"
+                      << std::endl;
+        };
+        bool keyKPressed = false;
+        bool keySubdividePressed = false;
+        bool keyIPressed = false;
 
         // Predefined color options
         std::vector<glm::vec3> colorOptions = {
@@ -489,8 +892,56 @@ int main() {
         };
         int currentColorIndex = 0;
 
+        // Rebuild everything derived from the faces after the topology changed
+        auto rebuildAfterTopologyChange = [&]() {
+            TRACE_SCOPE("rebuildAfterTopologyChange");
+            calculateVertexNormals(vertices, faces, vertexNormals);
+            meshletMesh = buildMeshlets(vertices, faces);
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            uploadMeshletIndices(meshletMesh);
+            buildClusterCullData(meshletMesh, cullData);
+
+            edges = extractUniqueEdges(faces);
+            glBindVertexArray(wireVAO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wireEBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, edges.size() * sizeof(Edge), edges.data(), GL_STATIC_DRAW);
+            glBindVertexArray(VAO);
+
+            // The curvature buffer must cover every vertex even while it is not shown
+            vertexFaces.offsets.clear();
+            smoothingGraph = std::make_shared<SmoothingGraph>();
+            sharedFaces.reset();
+            sharedNormals.reset();
+            clearSnapshotCache(denoiseCache);
+            curvatureDirty = true;
+            curvatureUploadNeeded = true;
+            zeroCurvature.assign(vertices.size(), 0.0f);
+            glBindBuffer(GL_ARRAY_BUFFER, curvatureVBO);
+            glBufferData(GL_ARRAY_BUFFER, zeroCurvature.size() * sizeof(float), zeroCurvature.data(), GL_DYNAMIC_DRAW);
+
+            halfEdges = buildHalfEdgeMesh(vertices.size(), faces);
+            resetDynamicBVH(dynamicBVH, vertices, faces);
+            pickedFace = -1;
+            pickedVertex = -1;
+
+            packVertexData(vertices, vertexNormals, meshData);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, meshData.size() * sizeof(float), meshData.data(), GL_STATIC_DRAW);
+        };
+
+        // Memory that lives for one frame, and the allocation count since the last report
+        ScratchArena frameArena;
+        std::string jobLabel;
+        AllocationCounters reportAllocationStart = allocationCounters();
+        double lastAllocationReport = 0.0;
+        size_t framesSinceAllocationReport = 0;
+
         // Main render loop
         while (!glfwWindowShouldClose(window)) {
+            TRACE_SCOPE("frame");
+            resetArena(frameArena);
+
             // Process input
             if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
                 glfwSetWindowShouldClose(window, true);
@@ -501,24 +952,264 @@ int main() {
             if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
                 useWireframe = !useWireframe;
 
+            // Swap in the newest finished job
+            MeshJobResult jobResult;
+            if (pollMeshJob(jobs, jobResult)) {
+                if (jobResult.tag == kDenoiseJob) {
+                    storeSnapshot(denoiseCache, denoiseLevel, vertices, jobResult.vertices);
+                    takeArrayContents(vertices, jobResult.vertices);
+                    recordVertexEdit(history, "denoise", vertices);
+                    denoiseJobPending = false;
+                    verticesMoved = true;
+                } else {
+                    takeArrayContents(vertices, jobResult.vertices);
+                    noiseAdded = true;
+                }
+            }
+
+            // Held noise keeps one job in flight at a time
             if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
-                addNoiseToVertices(vertices, vertexNormals, noiseStrength);
-                noiseAdded = true;
+                if (!meshJobsPending(jobs)) {
+                    if (!sharedNormals) {
+                        sharedNormals = std::make_shared<const std::vector<Normal>>(vertexNormals);
+                    }
+                    std::shared_ptr<const std::vector<Normal>> normals = sharedNormals;
+                    submitMeshJob(jobs, "noise", currentMeshVersion(),
+                                  [normals, noiseStrength](const MeshVersion&, VertexArray& output,
+                                                           MeshJobProgress& progress) {
+                                      addNoiseToVertices(output, *normals, noiseStrength);
+                                      progress.fraction = 1.0f;
+                                      return true;
+                                  },
+                                  kNoiseJob);
+                    noisePending = true;
+                }
+            } else if (noisePending && !meshJobsPending(jobs)) {
+                recordVertexEdit(history, "noise", vertices);
+                noisePending = false;
             }
 
+            // Step through the denoise levels; new levels are smoothed in the background
             if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
                 if (!keyDPressed) {
                     keyDPressed = true;
-                    denoiseLevel++;
-                    if (denoiseLevel > 3) {
+                    if (!meshJobsPending(jobs)) {
+                        denoiseLevel++;
+                        if (denoiseLevel > kMaxDenoiseLevel) {
+                            denoiseLevel = 0;
+                            vertices = originalVertices;
+                            recordVertexEdit(history, "denoise", vertices);
+                            verticesMoved = true;
+                        } else if (restoreSnapshot(denoiseCache, denoiseLevel - 1, hashVertices(vertices), denoiseLevel,
+                                                   vertices)) {
+                            recordVertexEdit(history, "denoise", vertices);
+                            verticesMoved = true;
+                        } else {
+                            std::shared_ptr<SmoothingGraph> graph = smoothingGraph;
+                            bool colored = useColoredSmoothing;
+                            auto smooth = [graph, colored, smoothingFactor](const MeshVersion& input,
+                                                                            VertexArray& output,
+                                                                            MeshJobProgress& progress) {
+                                auto report = [&progress](float fraction) {
+                                    progress.fraction = fraction;
+                                    return !progress.cancelRequested.load();
+                                };
+                                if (!colored) {
+                                    return laplacianSmoothing(output, *input.faces, smoothingFactor, report);
+                                }
+                                if (graph->neighbors.offsets.empty()) {
+                                    graph->neighbors = buildVertexAdjacency(output.size(), *input.faces);
+                                    graph->coloring = colorGraph(graph->neighbors);
+                                }
+                                return gaussSeidelSmoothing(output, graph->neighbors, graph->coloring, smoothingFactor,
+                                                            1, report);
+                            };
+                            submitMeshJob(jobs, colored ? "Gauss-Seidel smoothing" : "Jacobi smoothing",
+                                          currentMeshVersion(), smooth, kDenoiseJob);
+                            denoiseJobPending = true;
+                        }
+                    }
+                }
+            } else {
+                keyDPressed = false;
+            }
+
+            // Cancel the running job
+            if (glfwGetKey(window, GLFW_KEY_BACKSPACE) == GLFW_PRESS && meshJobsPending(jobs)) {
+                cancelJobs();
+                std::cout << "Cancelled background job" << std::endl;
+            }
+
+            // Switch denoising between the Gauss-Seidel and Jacobi smoothers
+            if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+                if (!keyGPressed) {
+                    keyGPressed = true;
+                    cancelJobs();
+                    useColoredSmoothing = !useColoredSmoothing;
+                    clearSnapshotCache(denoiseCache);
+                    std::cout << "Smoothing: " << (useColoredSmoothing ? "colored Gauss-Seidel" : "Jacobi") << std::endl;
+                }
+            } else {
+                keyGPressed = false;
+            }
+
+            // Undo (z) and redo (y) the latest edit
+            bool undoKey = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+            bool redoKey = glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS;
+            if ((undoKey && !keyZPressed) || (redoKey && !keyYPressed)) {
+                cancelJobs();
+                if (noisePending) {
+                    recordVertexEdit(history, "noise", vertices);
+                    noisePending = false;
+                }
+                bool topologyChanged = false;
+                std::string label;
+                bool stepped = undoKey ? undoEdit(history, vertices, faces, topologyChanged, label)
+                                       : redoEdit(history, vertices, faces, topologyChanged, label);
+                if (stepped) {
+                    std::cout << (undoKey ? "Undo " : "Redo ") << label << " (" << history.undo.size() << " undo, "
+                              << history.redo.size() << " redo steps, "
+                              << history.memoryUsed / (1024.0 * 1024.0) << " MB)" << std::endl;
+                    if (topologyChanged) {
+                        originalVertices = vertices;
                         denoiseLevel = 0;
-                        vertices = originalVertices;
+                        rebuildAfterTopologyChange();
                     } else {
-                        laplacianSmoothing(vertices, faces, smoothingFactor);
+                        verticesMoved = true;
+                    }
+                }
+            }
+            keyZPressed = undoKey;
+            keyYPressed = redoKey;
+
+            // Save to the --save path (or session.bin) now
+            if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+                if (!keyOPressed) {
+                    keyOPressed = true;
+                    cancelJobs();
+                    if (noisePending) {
+                        recordVertexEdit(history, "noise", vertices);
+                        noisePending = false;
                     }
+                    saveMeshFile(savePath.empty() ? "session.bin" : savePath, vertices, faces, vertexNormals,
+                                 originalVertices, denoiseLevel, history);
                 }
             } else {
-                keyDPressed = false;
+                keyOPressed = false;
+            }
+
+            // Toggle pick mode
+            if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+                if (!keyPPressed) {
+                    keyPPressed = true;
+                    pickMode = !pickMode;
+                    pickedFace = -1;
+                    pickedVertex = -1;
+                    glfwSetInputMode(window, GLFW_CURSOR, pickMode ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+                }
+            } else {
+                keyPPressed = false;
+            }
+
+            // Toggle cluster culling
+            if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
+                if (!keyXPressed) {
+                    keyXPressed = true;
+                    useClusterCulling = !useClusterCulling;
+                }
+            } else {
+                keyXPressed = false;
+            }
+
+            // Remove components smaller than 1% of the largest one
+            if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
+                if (!keyKPressed) {
+                    keyKPressed = true;
+                    cancelJobs();
+                    moveMeshToHeap();
+                    ComponentLabels labels = labelConnectedComponents(vertices, faces);
+                    size_t largest = 0;
+                    for (const auto& component : labels.components) {
+                        largest = std::max(largest, component.faceCount);
+                    }
+                    size_t facesBefore = faces.size();
+                    VertexArray previousVertices = vertices;
+                    FaceArray previousFaces = faces;
+                    std::vector<int> remap = removeSmallComponents(vertices, faces, labels, std::max<size_t>(largest / 100, 1));
+                    if (faces.size() != facesBefore) {
+                        compactVertexAttribute(originalVertices, remap);
+                        recordTopologyEdit(history, "remove small components", std::move(previousVertices),
+                                           std::move(previousFaces), vertices);
+
+                        rebuildAfterTopologyChange();
+                    }
+                    std::cout << "Removed " << (facesBefore - faces.size()) << " faces in small components, "
+                              << faces.size() << " faces left." << std::endl;
+                }
+            } else {
+                keyKPressed = false;
+            }
+
+            // Refine the mesh by one level of Loop or sqrt(3) subdivision
+            bool loopKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+            bool sqrt3Key = glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS;
+            if (loopKey || sqrt3Key) {
+                if (!keySubdividePressed) {
+                    keySubdividePressed = true;
+                    cancelJobs();
+                    moveMeshToHeap();
+                    VertexArray previousVertices = vertices;
+                    FaceArray previousFaces = faces;
+                    SubdivisionStats stats = loopKey ? loopSubdivide(vertices, faces, 1) : sqrt3Subdivide(vertices, faces, 1);
+                    std::cout << (loopKey ? "Loop" : "sqrt(3)") << " subdivision: " << stats.vertexCount << " vertices, "
+                              << stats.faceCount << " faces in " << stats.milliseconds << " ms, "
+                              << stats.peakBytes / (1024.0 * 1024.0) << " MB of buffers." << std::endl;
+
+                    recordTopologyEdit(history, loopKey ? "Loop subdivision" : "sqrt(3) subdivision",
+                                       std::move(previousVertices), std::move(previousFaces), vertices);
+
+                    // The refined mesh becomes the new undisturbed state
+                    originalVertices = vertices;
+                    denoiseLevel = 0;
+                    rebuildAfterTopologyChange();
+                }
+            } else {
+                keySubdividePressed = false;
+            }
+
+            // Remesh isotropically at the current mean edge length
+            if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
+                if (!keyIPressed) {
+                    keyIPressed = true;
+                    cancelJobs();
+                    moveMeshToHeap();
+                    float targetEdgeLength = computeMeshReport(vertices, faces).meanEdgeLength;
+                    VertexArray previousVertices = vertices;
+                    FaceArray previousFaces = faces;
+                    RemeshStats stats = remeshIsotropic(vertices, faces, targetEdgeLength);
+                    std::cout << "Remeshed to edge length " << targetEdgeLength << ": " << stats.splits << " splits, "
+                              << stats.collapses << " collapses, " << stats.flips << " flips, " << faces.size()
+                              << " faces in " << stats.milliseconds << " ms." << std::endl;
+                    recordTopologyEdit(history, "remesh", std::move(previousVertices), std::move(previousFaces),
+                                       vertices);
+
+                    originalVertices = vertices;
+                    denoiseLevel = 0;
+                    rebuildAfterTopologyChange();
+                }
+            } else {
+                keyIPressed = false;
+            }
+
+            // Cycle the curvature color map
+            if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+                if (!keyVPressed) {
+                    keyVPressed = true;
+                    curvatureMode = (curvatureMode + 1) % 5;
+                    curvatureUploadNeeded = true;
+                }
+            } else {
+                keyVPressed = false;
             }
 
             // Color change
@@ -543,39 +1234,55 @@ int main() {
             if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
                 cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 
-            // Update mesh data if noise was added or mesh was denoised
-            if (noiseAdded || keyDPressed) {
-                meshData.clear();
-                for (const auto& face : faces) {
-                    // Vertex 1
-                    meshData.push_back(vertices[face.v1].x);
-                    meshData.push_back(vertices[face.v1].y);
-                    meshData.push_back(vertices[face.v1].z);
-                    meshData.push_back(vertexNormals[face.v1].x);
-                    meshData.push_back(vertexNormals[face.v1].y);
-                    meshData.push_back(vertexNormals[face.v1].z);
-
-                    // Vertex 2
-                    meshData.push_back(vertices[face.v2].x);
-                    meshData.push_back(vertices[face.v2].y);
-                    meshData.push_back(vertices[face.v2].z);
-                    meshData.push_back(vertexNormals[face.v2].x);
-                    meshData.push_back(vertexNormals[face.v2].y);
-                    meshData.push_back(vertexNormals[face.v2].z);
-
-                    // Vertex 3
-                    meshData.push_back(vertices[face.v3].x);
-                    meshData.push_back(vertices[face.v3].y);
-                    meshData.push_back(vertices[face.v3].z);
-                    meshData.push_back(vertexNormals[face.v3].x);
-                    meshData.push_back(vertexNormals[face.v3].y);
-                    meshData.push_back(vertexNormals[face.v3].z);
-                }
+            // Update mesh data if noise was added, the mesh was denoised or an edit was undone
+            bool verticesChanged = noiseAdded || verticesMoved;
+            noiseAdded = false;
+            verticesMoved = false;
+            if (verticesChanged) {
+                TRACE_SCOPE("updateVertexBuffer");
+                packVertexData(vertices, vertexNormals, meshData);
 
                 // Update VBO data
                 glBindBuffer(GL_ARRAY_BUFFER, VBO);
                 glBufferData(GL_ARRAY_BUFFER, meshData.size() * sizeof(float), meshData.data(), GL_STATIC_DRAW);
-                noiseAdded = false;
+
+                // Keep the cluster bounds in sync with the moved vertices
+                updateMeshletBounds(meshletMesh, vertices);
+                buildClusterCullData(meshletMesh, cullData);
+            }
+
+            // Recompute curvature only while it is shown, and upload the selected attribute
+            if (verticesChanged) {
+                curvatureDirty = true;
+                curvatureUploadNeeded = true;
+            }
+            if (curvatureMode != 0 && curvatureUploadNeeded) {
+                if (curvatureDirty) {
+                    auto curvatureStart = std::chrono::steady_clock::now();
+                    if (vertexFaces.offsets.empty()) {
+                        vertexFaces = buildVertexFaceAdjacency(vertices.size(), faces);
+                    }
+                    computeCurvature(vertices, faces, vertexFaces, curvature);
+                    double curvatureMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - curvatureStart).count();
+                    std::cout << "Computed curvature for " << vertices.size() << " vertices in " << curvatureMs << " ms." << std::endl;
+                    curvatureDirty = false;
+                }
+                const std::vector<float>* fields[] = {nullptr, &curvature.mean, &curvature.gaussian,
+                                                      &curvature.maxPrincipal, &curvature.minPrincipal};
+                const std::vector<float>& field = *fields[curvatureMode];
+                curvatureScale = curvatureDisplayScale(field);
+                glBindBuffer(GL_ARRAY_BUFFER, curvatureVBO);
+                glBufferData(GL_ARRAY_BUFFER, field.size() * sizeof(float), field.data(), GL_DYNAMIC_DRAW);
+                curvatureUploadNeeded = false;
+            }
+
+            // Refit the BVH to moved vertices, and swap in a BVH rebuilt in the
+            // background once refits degraded it
+            if (verticesChanged) {
+                refitDynamicBVH(dynamicBVH, vertices, faces);
+            }
+            if (pollDynamicBVH(dynamicBVH, vertices, faces)) {
+                std::cout << "BVH rebuilt, SAH cost " << dynamicBVH.bvh.cost << std::endl;
             }
 
             // Clear the screen
@@ -593,33 +1300,185 @@ int main() {
             glUniform1i(glGetUniformLocation(shaderProgram, "usePhongShading"), usePhongShading);
             glUniform1i(glGetUniformLocation(shaderProgram, "useWireframe"), useWireframe);
             glUniform3fv(glGetUniformLocation(shaderProgram, "objectColor"), 1, glm::value_ptr(meshColor));
+            glUniform1i(glGetUniformLocation(shaderProgram, "useHighlight"), false);
+            glUniform1i(glGetUniformLocation(shaderProgram, "useCurvature"), curvatureMode != 0);
+            glUniform1f(glGetUniformLocation(shaderProgram, "curvatureScale"), curvatureScale);
+
+            // Hover picking: closest face under the cursor and its nearest corner
+            if (pickMode) {
+                int windowWidth, windowHeight;
+                glfwGetWindowSize(window, &windowWidth, &windowHeight);
+                Ray ray = cursorRay(cursorX, cursorY, windowWidth, windowHeight, projection * view);
+
+                auto pickStart = std::chrono::steady_clock::now();
+                RayHit hit;
+                if (intersectBVH(dynamicBVH.bvh, ray, hit)) {
+                    const Face& face = faces[hit.face];
+                    glm::vec3 point = ray.origin + ray.direction * hit.t;
+                    int corners[3] = {face.v1, face.v2, face.v3};
+                    float bestDistance = INFINITY;
+                    for (int corner : corners) {
+                        glm::vec3 p(vertices[corner].x, vertices[corner].y, vertices[corner].z);
+                        float distance = glm::length(p - point);
+                        if (distance < bestDistance) {
+                            bestDistance = distance;
+                            pickedVertex = corner;
+                        }
+                    }
+                    pickedFace = static_cast<int>(hit.face);
+                } else {
+                    pickedFace = -1;
+                    pickedVertex = -1;
+                }
+                pickMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - pickStart).count();
+            }
 
             // Draw the mesh
             glm::mat4 model = glm::mat4(1.0f);
             glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
 
             glBindVertexArray(VAO);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+            // Cull clusters on the CPU and submit only the visible index ranges
             if (useWireframe) {
-                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+                // Every unique edge once, instead of rasterizing shared edges twice
+                drawCommands.counts.clear();
+                drawCommands.offsets.clear();
+                drawCommands.triangleCount = 0;
+                glBindVertexArray(wireVAO);
+                glDrawElements(GL_LINES, static_cast<GLsizei>(edges.size() * 2), GL_UNSIGNED_INT, nullptr);
+                glBindVertexArray(VAO);
+            } else if (useClusterCulling) {
+                cullClusters(cullData, extractFrustum(projection * view), cameraPos, true, drawCommands);
             } else {
+                drawCommands.counts.assign(1, static_cast<int>(faces.size() * 3));
+                drawCommands.offsets.assign(1, nullptr);
+                drawCommands.triangleCount = faces.size();
+            }
+            if (!drawCommands.counts.empty()) {
+                glMultiDrawElements(GL_TRIANGLES, drawCommands.counts.data(), GL_UNSIGNED_INT,
+                                    drawCommands.offsets.data(), static_cast<GLsizei>(drawCommands.counts.size()));
+            }
+
+            // Draw the picked face slightly in front of the mesh and the picked vertex as a point
+            if (pickMode && pickedFace >= 0) {
+                const Face& face = faces[pickedFace];
+                int corners[4] = {face.v1, face.v2, face.v3, pickedVertex};
+                float highlightData[4 * 6];
+                for (int k = 0; k < 4; ++k) {
+                    const Vertex& v = vertices[corners[k]];
+                    const Normal& n = vertexNormals[corners[k]];
+                    float values[6] = {v.x, v.y, v.z, n.x, n.y, n.z};
+                    std::copy(values, values + 6, highlightData + k * 6);
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, highlightVBO);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(highlightData), highlightData);
+
+                glBindVertexArray(highlightVAO);
                 glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                glUniform1i(glGetUniformLocation(shaderProgram, "useHighlight"), true);
+
+                glEnable(GL_POLYGON_OFFSET_FILL);
+                glPolygonOffset(-1.0f, -1.0f);
+                glUniform3f(glGetUniformLocation(shaderProgram, "highlightColor"), 1.0f, 0.6f, 0.0f);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+                glDisable(GL_POLYGON_OFFSET_FILL);
+
+                glDisable(GL_DEPTH_TEST);
+                glPointSize(8.0f);
+                glUniform3f(glGetUniformLocation(shaderProgram, "highlightColor"), 1.0f, 0.0f, 0.0f);
+                glDrawArrays(GL_POINTS, 3, 1);
+                glEnable(GL_DEPTH_TEST);
+            }
+
+            // Report how many triangles survived culling, and the current pick
+            if (currentFrame - lastTitleUpdate > 0.5) {
+                lastTitleUpdate = currentFrame;
+                // Formatted in the frame arena, so updating the title allocates nothing
+                const size_t kTitleBytes = 512;
+                char* title = arenaArray<char>(frameArena, kTitleBytes);
+                size_t length = 0;
+                auto append = [&](const char* format, auto... values) {
+                    if (length < kTitleBytes) {
+                        length += std::max(0, std::snprintf(title + length, kTitleBytes - length, format, values...));
+                    }
+                };
+                append("Mesh Viewer - %zu / %zu triangles in %zu draws", drawCommands.triangleCount, faces.size(),
+                       drawCommands.counts.size());
+                if (pickMode) {
+                    append(" - pick face %d, vertex %d (%d us)", pickedFace, pickedVertex,
+                           static_cast<int>(pickMicroseconds));
+                }
+                float jobFraction = 0.0f;
+                if (meshJobProgress(jobs, jobLabel, jobFraction)) {
+                    append(" - %s %d%%", jobLabel.c_str(), static_cast<int>(jobFraction * 100.0f));
+                }
+                if (curvatureMode != 0) {
+                    append(" - %s curvature, range +/-%f", curvatureModeNames[curvatureMode], curvatureScale);
+                    if (pickMode && pickedVertex >= 0 && !curvatureDirty) {
+                        append(", H %f, K %f", curvature.mean[pickedVertex], curvature.gaussian[pickedVertex]);
+                    }
+                }
+                glfwSetWindowTitle(window, title);
             }
-            glDrawArrays(GL_TRIANGLES, 0, faces.size() * 3);
 
             // Swap buffers and poll events
-            glfwSwapBuffers(window);
+            {
+                TRACE_SCOPE("swapBuffers");
+                glfwSwapBuffers(window);
+            }
             glfwPollEvents();
+
+            // Heap allocations per frame; zero while nothing is being edited
+            framesSinceAllocationReport++;
+            if (countAllocations && currentFrame - lastAllocationReport > 2.0) {
+                AllocationCounters counted = allocationsSince(reportAllocationStart);
+                std::cout << counted.allocations << " heap allocations (" << counted.bytes / 1024 << " KB) in "
+                          << framesSinceAllocationReport << " frames, "
+                          << static_cast<double>(counted.allocations) / framesSinceAllocationReport << " per frame"
+                          << std::endl;
+                lastAllocationReport = currentFrame;
+                framesSinceAllocationReport = 0;
+                reportAllocationStart = allocationCounters();
+            }
+        }
+
+        // Save on the way out, once the running job has landed or been dropped
+        if (!savePath.empty()) {
+            cancelJobs();
+            if (noisePending) {
+                recordVertexEdit(history, "noise", vertices);
+            }
+            saveMeshFile(savePath, vertices, faces, vertexNormals, originalVertices, denoiseLevel, history);
         }
 
         // Clean up
+        stopMeshJobRunner(jobs);
+        bool verticesClosed = closeMappedArray(vertices);
+        bool facesClosed = closeMappedArray(faces);
+        if (!verticesClosed || !facesClosed) {
+            std::cerr << "Failed to write the mesh back to " << mappedDirectory << std::endl;
+        }
         glDeleteVertexArrays(1, &VAO);
         glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteVertexArrays(1, &wireVAO);
+        glDeleteBuffers(1, &wireEBO);
+        glDeleteVertexArrays(1, &highlightVAO);
+        glDeleteBuffers(1, &highlightVBO);
+        glDeleteBuffers(1, &curvatureVBO);
         glDeleteProgram(shaderProgram);
 
-        glfwTerminate();
     } else {
         std::cerr << "Failed to load OBJ file" << std::endl;
     }
+    glfwTerminate();
+
+    // Write out the per-stage timings, including the ones from the final frames
+    if (!tracePath.empty()) {
+        writeChromeTrace(tracePath);
+    }
 
     return 0;
 }
@@ -0,0 +1,257 @@
+#include "mesh.h"
+#include "adjacency.h"
+#include "parallel.h"
+#include "scratch.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+
+// Below this many faces (or on one thread) vertex normals are summed with a
+// serial scatter, which needs no face lists
+const size_t kParallelNormalFaces = 1 << 16;
+// Vertices per noise block; every block has its own generator
+const size_t kNoiseBlockVertices = 1 << 14;
+
+Normal calculateFaceNormal(const Vertex& v1, const Vertex& v2, const Vertex& v3) {
+    // Calculate two vectors on the face
+    float ux = v2.x - v1.x;
+    float uy = v2.y - v1.y;
+    float uz = v2.z - v1.z;
+    
+    float vx = v3.x - v1.x;
+    float vy = v3.y - v1.y;
+    float vz = v3.z - v1.z;
+    
+    // Calculate cross product to get normal
+    Normal normal;
+    normal.x = uy * vz - uz * vy;
+    normal.y = uz * vx - ux * vz;
+    normal.z = ux * vy - uy * vx;
+    
+    // Normalize the normal vector
+    float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    if (length != 0) {
+        normal.x /= length;
+        normal.y /= length;
+        normal.z /= length;
+    }
+    
+    return normal;
+}
+
+void calculateFaceNormals(const VertexArray& vertices, const FaceArray& faces, Normal* faceNormals) {
+    TRACE_SCOPE("calculateFaceNormals");
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto& face = faces[i];
+            faceNormals[i] = calculateFaceNormal(vertices[face.v1], vertices[face.v2], vertices[face.v3]);
+        }
+    });
+}
+
+void calculateVertexNormals(const VertexArray& vertices, const FaceArray& faces, std::vector<Normal>& vertexNormals) {
+    TRACE_SCOPE("calculateVertexNormals");
+    // Faces are read in order, their corners from anywhere in the vertex array
+    adviseArray(faces, StorageAdvice::Sequential);
+    adviseArray(vertices, StorageAdvice::WillNeed);
+
+    // Calculate flat face normals
+    ScratchBuffer<Normal> faceNormals(faces.size());
+    calculateFaceNormals(vertices, faces, faceNormals.data());
+
+    // Larger meshes gather the normals around every vertex in parallel. The
+    // face lists are in face order, so the sums match the serial scatter.
+    if (parallelThreadCount() > 1 && faces.size() >= kParallelNormalFaces) {
+        Adjacency vertexFaces = buildVertexFaceAdjacency(vertices.size(), faces);
+        vertexNormals.resize(vertices.size());
+        parallelFor(vertices.size(), 1 << 14, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                Normal sum = {0, 0, 0};
+                unsigned int count = vertexFaces.offsets[i + 1] - vertexFaces.offsets[i];
+                for (unsigned int k = vertexFaces.offsets[i]; k < vertexFaces.offsets[i + 1]; ++k) {
+                    const Normal& normal = faceNormals[vertexFaces.indices[k]];
+                    sum.x += normal.x;
+                    sum.y += normal.y;
+                    sum.z += normal.z;
+                }
+                if (count > 0) {
+                    sum.x /= count;
+                    sum.y /= count;
+                    sum.z /= count;
+                    float length = std::sqrt(sum.x * sum.x + sum.y * sum.y + sum.z * sum.z);
+                    if (length != 0) {
+                        sum.x /= length;
+                        sum.y /= length;
+                        sum.z /= length;
+                    }
+                }
+                vertexNormals[i] = sum;
+            }
+        });
+        return;
+    }
+
+    // Calculate smoothed vertex normals
+    vertexNormals.assign(vertices.size(), {0, 0, 0});
+    ScratchBuffer<int> vertexFaceCount(vertices.size(), 0);
+    
+    for (size_t i = 0; i < faces.size(); ++i) {
+        const auto& face = faces[i];
+        const auto& normal = faceNormals[i];
+        
+        // Add face normal to each vertex of the face
+        vertexNormals[face.v1].x += normal.x;
+        vertexNormals[face.v1].y += normal.y;
+        vertexNormals[face.v1].z += normal.z;
+        vertexFaceCount[face.v1]++;
+        
+        vertexNormals[face.v2].x += normal.x;
+        vertexNormals[face.v2].y += normal.y;
+        vertexNormals[face.v2].z += normal.z;
+        vertexFaceCount[face.v2]++;
+        
+        vertexNormals[face.v3].x += normal.x;
+        vertexNormals[face.v3].y += normal.y;
+        vertexNormals[face.v3].z += normal.z;
+        vertexFaceCount[face.v3]++;
+    }
+    
+    // Normalize vertex normals
+    for (size_t i = 0; i < vertexNormals.size(); ++i) {
+        if (vertexFaceCount[i] > 0) {
+            // Average the normal
+            vertexNormals[i].x /= vertexFaceCount[i];
+            vertexNormals[i].y /= vertexFaceCount[i];
+            vertexNormals[i].z /= vertexFaceCount[i];
+            
+            // Normalize the normal vector
+            float length = std::sqrt(vertexNormals[i].x * vertexNormals[i].x + 
+                                     vertexNormals[i].y * vertexNormals[i].y + 
+                                     vertexNormals[i].z * vertexNormals[i].z);
+            if (length != 0) {
+                vertexNormals[i].x /= length;
+                vertexNormals[i].y /= length;
+                vertexNormals[i].z /= length;
+            }
+        }
+    }
+}
+
+void addNoiseToVertices(VertexArray& vertices, const std::vector<Normal>& vertexNormals, float noiseStrength) {
+    TRACE_SCOPE("addNoiseToVertices");
+    adviseArray(vertices, StorageAdvice::Sequential);
+    std::random_device rd;
+    const uint32_t seed = rd();
+
+    // Blocks of vertices are seeded from the call's seed and their index, so
+    // the noise does not depend on how the blocks are spread over threads
+    const size_t blockCount = (vertices.size() + kNoiseBlockVertices - 1) / kNoiseBlockVertices;
+    parallelFor(blockCount, 1, [&](size_t beginBlock, size_t endBlock) {
+        for (size_t block = beginBlock; block < endBlock; ++block) {
+            std::seed_seq blockSeed{seed, static_cast<uint32_t>(block), static_cast<uint32_t>(block >> 32)};
+            std::mt19937 gen(blockSeed);
+            std::uniform_real_distribution<> dis(-1.0, 1.0);
+            size_t end = std::min(vertices.size(), (block + 1) * kNoiseBlockVertices);
+            for (size_t i = block * kNoiseBlockVertices; i < end; ++i) {
+                float noise = noiseStrength * dis(gen);
+                vertices[i].x += vertexNormals[i].x * noise;
+                vertices[i].y += vertexNormals[i].y * noise;
+                vertices[i].z += vertexNormals[i].z * noise;
+            }
+        }
+    });
+}
+
+bool laplacianSmoothing(VertexArray& vertices, const FaceArray& faces, float smoothingFactor,
+                        const std::function<bool(float)>& progress) {
+    TRACE_SCOPE("laplacianSmoothing");
+    // The faces around every vertex in increasing face order, so each vertex
+    // sums its neighbors in the same order as a scan over all faces would
+    Adjacency vertexFaces = buildVertexFaceAdjacency(vertices.size(), faces);
+    ScratchBuffer<Vertex> newVertices(vertices.size());
+    std::atomic<size_t> verticesDone{0};
+    std::atomic<bool> cancelled{false};
+
+    parallelFor(vertices.size(), 1 << 12, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            // Every block of 1024 vertices counts itself before it starts
+            if (progress && ((i - begin) & 1023) == 0) {
+                size_t done = verticesDone.fetch_add(std::min<size_t>(1024, end - i), std::memory_order_relaxed);
+                if (!progress(static_cast<float>(done) / vertices.size())) {
+                    cancelled = true;
+                }
+            }
+            if (cancelled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            newVertices[i] = vertices[i];
+            Vertex sum = {0, 0, 0};
+            int count = 0;
+
+            // Sum the other corners of every face around the vertex; a face
+            // that holds it twice is listed twice but counted once
+            for (unsigned int k = vertexFaces.offsets[i]; k < vertexFaces.offsets[i + 1]; ++k) {
+                if (k > vertexFaces.offsets[i] && vertexFaces.indices[k] == vertexFaces.indices[k - 1]) {
+                    continue;
+                }
+                const Face& face = faces[vertexFaces.indices[k]];
+                if (face.v1 != i) {
+                    sum.x += vertices[face.v1].x;
+                    sum.y += vertices[face.v1].y;
+                    sum.z += vertices[face.v1].z;
+                    count++;
+                }
+                if (face.v2 != i) {
+                    sum.x += vertices[face.v2].x;
+                    sum.y += vertices[face.v2].y;
+                    sum.z += vertices[face.v2].z;
+                    count++;
+                }
+                if (face.v3 != i) {
+                    sum.x += vertices[face.v3].x;
+                    sum.y += vertices[face.v3].y;
+                    sum.z += vertices[face.v3].z;
+                    count++;
+                }
+            }
+
+            // Calculate the average position of neighbors
+            if (count > 0) {
+                sum.x /= count;
+                sum.y /= count;
+                sum.z /= count;
+
+                // Move the vertex towards the average position
+                newVertices[i].x += (sum.x - vertices[i].x) * smoothingFactor;
+                newVertices[i].y += (sum.y - vertices[i].y) * smoothingFactor;
+                newVertices[i].z += (sum.z - vertices[i].z) * smoothingFactor;
+            }
+        }
+    });
+    if (cancelled) {
+        return false;
+    }
+
+    parallelFor(vertices.size(), 1 << 16, [&](size_t begin, size_t end) {
+        std::copy(newVertices.begin() + begin, newVertices.begin() + end, vertices.begin() + begin);
+    });
+    return true;
+}
+
+void packVertexData(const VertexArray& vertices, const std::vector<Normal>& vertexNormals, std::vector<float>& meshData) {
+    adviseArray(vertices, StorageAdvice::Sequential);
+    meshData.resize(vertices.size() * 6);
+    parallelFor(vertices.size(), 1 << 15, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            float* out = &meshData[i * 6];
+            out[0] = vertices[i].x;
+            out[1] = vertices[i].y;
+            out[2] = vertices[i].z;
+            out[3] = vertexNormals[i].x;
+            out[4] = vertexNormals[i].y;
+            out[5] = vertexNormals[i].z;
+        }
+    });
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "storage.h"
+
+// Define structures for vertices, faces, and normals
+struct Vertex {
+    float x, y, z;
+};
+
+struct Face {
+    int v1, v2, v3;
+};
+
+struct Normal {
+    float x, y, z;
+};
+
+// Vertex and face arrays, on the heap or mapped from a file (see storage.h)
+using VertexArray = StorageVector<Vertex>;
+using FaceArray = StorageVector<Face>;
+
+// Function to calculate face normal
+Normal calculateFaceNormal(const Vertex& v1, const Vertex& v2, const Vertex& v3);
+
+// Function to calculate the normal of every face in parallel, into
+// faceNormals, which holds one per face
+void calculateFaceNormals(const VertexArray& vertices, const FaceArray& faces, Normal* faceNormals);
+
+// Function to calculate smoothed vertex normals by averaging the adjacent face
+// normals. Large meshes gather them per vertex in parallel, with the same sums.
+void calculateVertexNormals(const VertexArray& vertices, const FaceArray& faces, std::vector<Normal>& vertexNormals);
+
+// Function to add noise to vertices along their normals, in parallel blocks
+// that each draw from their own generator
+void addNoiseToVertices(VertexArray& vertices, const std::vector<Normal>& vertexNormals, float noiseStrength);
+
+// Function to perform Laplacian smoothing (mesh denoising), in parallel over
+// the vertices, each visiting only its own faces. progress, if set, gets the fraction done every 1024 vertices
+// (from several threads at once) and cancels by returning false.
+bool laplacianSmoothing(VertexArray& vertices, const FaceArray& faces, float smoothingFactor,
+                        const std::function<bool(float)>& progress = nullptr);
+
+// Function to pack per-vertex position and normal data for the VBO
+void packVertexData(const VertexArray& vertices, const std::vector<Normal>& vertexNormals, std::vector<float>& meshData);
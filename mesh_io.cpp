@@ -0,0 +1,505 @@
+#include "mesh_io.h"
+#include "parallel.h"
+#include "scratch.h"
+#include "trace.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+// Blocks are parsed in pieces of at least this many bytes, cut at line ends
+const size_t kOBJPieceBytes = 1u << 20;
+
+// Lines of one piece, parsed on their own. Negative (relative) face indices
+// are stored relative to the start of the piece and listed, so they can be
+// fixed up once the number of vertices before the piece is known.
+struct ParsedPiece {
+    OBJChunk chunk;
+    std::vector<size_t> relativeCorners; // face * 3 + corner
+};
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void parsePiece(const char* begin, const char* end, ParsedPiece& piece) {
+    std::vector<int> polygon;
+    std::vector<bool> relative;
+    const char* line = begin;
+    while (line < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        const char* p = line;
+        while (p < lineEnd && isSpace(*p)) {
+            ++p;
+        }
+
+        if (lineEnd - p > 1 && p[0] == 'v' && isSpace(p[1])) {
+            // Parse vertex data
+            char* cursor = const_cast<char*>(p + 1);
+            Vertex vertex;
+            vertex.x = std::strtof(cursor, &cursor) * kOBJScale;
+            vertex.y = std::strtof(cursor, &cursor) * kOBJScale;
+            vertex.z = std::strtof(cursor, &cursor) * kOBJScale;
+            piece.chunk.vertices.push_back(vertex);
+        } else if (lineEnd - p > 1 && p[0] == 'f' && isSpace(p[1])) {
+            // Parse face data: the first number of every v/vt/vn corner
+            polygon.clear();
+            relative.clear();
+            const char* c = p + 1;
+            for (;;) {
+                while (c < lineEnd && isSpace(*c)) {
+                    ++c;
+                }
+                if (c >= lineEnd || *c == '#') {
+                    break;
+                }
+                char* after;
+                long index = std::strtol(c, &after, 10);
+                if (after == c || index == 0) {
+                    break;
+                }
+                // OBJ indices start at 1; negative ones count back from the latest vertex
+                if (index > 0) {
+                    polygon.push_back(static_cast<int>(index - 1));
+                    relative.push_back(false);
+                } else {
+                    polygon.push_back(static_cast<int>(piece.chunk.vertices.size() + index));
+                    relative.push_back(true);
+                }
+                c = after;
+                while (c < lineEnd && !isSpace(*c)) {
+                    ++c;
+                }
+            }
+
+            for (size_t k = 1; k + 1 < polygon.size(); ++k) {
+                size_t corner = piece.chunk.faces.size() * 3;
+                piece.chunk.faces.push_back({polygon[0], polygon[k], polygon[k + 1]});
+                size_t corners[3] = {0, k, k + 1};
+                for (int j = 0; j < 3; ++j) {
+                    if (relative[corners[j]]) {
+                        piece.relativeCorners.push_back(corner + j);
+                    }
+                }
+            }
+        }
+        // Ignore other types (vn, vt, etc.)
+        line = lineEnd + 1;
+    }
+}
+
+// Function to parse [begin, end), which ends at a line end and is followed by
+// a 0 byte, in parallel pieces. vertexBase is the number of vertices before it.
+static OBJChunk parseBlock(const char* begin, const char* end, size_t vertexBase) {
+    std::vector<const char*> cuts(1, begin);
+    while (end - cuts.back() > static_cast<ptrdiff_t>(2 * kOBJPieceBytes)) {
+        const char* cut = static_cast<const char*>(std::memchr(cuts.back() + kOBJPieceBytes, '\n',
+                                                               end - cuts.back() - kOBJPieceBytes));
+        if (!cut) {
+            break;
+        }
+        cuts.push_back(cut + 1);
+    }
+    cuts.push_back(end);
+
+    const size_t pieceCount = cuts.size() - 1;
+    std::vector<ParsedPiece> pieces(pieceCount);
+    parallelFor(pieceCount, 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            parsePiece(cuts[i], cuts[i + 1], pieces[i]);
+        }
+    });
+
+    std::vector<size_t> vertexOffsets(pieceCount + 1, 0);
+    std::vector<size_t> faceOffsets(pieceCount + 1, 0);
+    for (size_t i = 0; i < pieceCount; ++i) {
+        vertexOffsets[i + 1] = vertexOffsets[i] + pieces[i].chunk.vertices.size();
+        faceOffsets[i + 1] = faceOffsets[i] + pieces[i].chunk.faces.size();
+    }
+
+    OBJChunk chunk;
+    chunk.vertices.resize(vertexOffsets[pieceCount]);
+    chunk.faces.resize(faceOffsets[pieceCount]);
+    parallelFor(pieceCount, 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            ParsedPiece& piece = pieces[i];
+            int base = static_cast<int>(vertexBase + vertexOffsets[i]);
+            int* corners = reinterpret_cast<int*>(piece.chunk.faces.data());
+            for (size_t corner : piece.relativeCorners) {
+                corners[corner] += base;
+            }
+            std::copy(piece.chunk.vertices.begin(), piece.chunk.vertices.end(), chunk.vertices.begin() + vertexOffsets[i]);
+            std::copy(piece.chunk.faces.begin(), piece.chunk.faces.end(), chunk.faces.begin() + faceOffsets[i]);
+        }
+    });
+    return chunk;
+}
+
+// Function to read the file in blocks that start at firstBlockBytes and double
+// up to maxBlockBytes, cut each at its last line end, parse it and pass the
+// result to emit. Returns false if it was cancelled.
+static bool readOBJBlocks(std::ifstream& file, size_t firstBlockBytes, size_t maxBlockBytes,
+                          const std::atomic<bool>* cancel, std::atomic<uint64_t>* bytesRead,
+                          const std::function<void(OBJChunk&&)>& emit) {
+    std::vector<char> buffer;
+    size_t carried = 0;
+    size_t blockBytes = firstBlockBytes;
+    size_t vertexCount = 0;
+    for (;;) {
+        if (cancel && cancel->load()) {
+            return false;
+        }
+
+        // One spare byte for the terminator strtof and strtol rely on
+        buffer.resize(carried + blockBytes + 2);
+        file.read(buffer.data() + carried, static_cast<std::streamsize>(blockBytes));
+        size_t got = static_cast<size_t>(file.gcount());
+        size_t size = carried + got;
+        bool last = got < blockBytes;
+        if (bytesRead) {
+            bytesRead->fetch_add(got);
+        }
+
+        size_t cut = size;
+        if (last) {
+            if (size > 0 && buffer[size - 1] != '\n') {
+                buffer[size++] = '\n';
+            }
+            cut = size;
+        } else {
+            while (cut > 0 && buffer[cut - 1] != '\n') {
+                --cut;
+            }
+            if (cut == 0) {
+                // A line longer than the block: read more before parsing
+                carried = size;
+                blockBytes = std::max(blockBytes * 2, maxBlockBytes);
+                continue;
+            }
+        }
+
+        OBJChunk chunk;
+        {
+            TRACE_SCOPE("parseOBJBlock");
+            char saved = buffer[cut];
+            buffer[cut] = '\0';
+            chunk = parseBlock(buffer.data(), buffer.data() + cut, vertexCount);
+            buffer[cut] = saved;
+        }
+        vertexCount += chunk.vertices.size();
+        if (!chunk.vertices.empty() || !chunk.faces.empty()) {
+            emit(std::move(chunk));
+        }
+
+        // Carry the unfinished line over to the next block
+        carried = size - cut;
+        std::memmove(buffer.data(), buffer.data() + cut, carried);
+        if (last) {
+            return true;
+        }
+        blockBytes = std::min(blockBytes * 2, maxBlockBytes);
+    }
+}
+
+bool loadOBJ(const std::string& filename, VertexArray& vertices, FaceArray& faces) {
+    TRACE_SCOPE("loadOBJ");
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    // Small files are read in one block no larger than the file itself
+    const size_t kBlockBytes = std::min<size_t>(32u << 20, fileSize + 1);
+    readOBJBlocks(file, kBlockBytes, kBlockBytes, nullptr, nullptr, [&](OBJChunk&& chunk) {
+        vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        faces.insert(faces.end(), chunk.faces.begin(), chunk.faces.end());
+    });
+    return true;
+}
+
+bool readOBJChunks(const std::string& filename, const std::function<void(OBJChunk&&)>& visit) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    const size_t kBlockBytes = 32u << 20;
+    readOBJBlocks(file, kBlockBytes, kBlockBytes, nullptr, nullptr, visit);
+    return !file.bad();
+}
+
+bool convertOBJToMeshFiles(const std::string& filename, const std::string& directory) {
+    TRACE_SCOPE("convertOBJToMeshFiles");
+    std::string vertexPath = directory + "/vertices.bin", facePath = directory + "/faces.bin";
+    std::ofstream vertexFile(vertexPath, std::ios::binary | std::ios::trunc);
+    std::ofstream faceFile(facePath, std::ios::binary | std::ios::trunc);
+    if (!vertexFile.is_open() || !faceFile.is_open()) {
+        std::cerr << "Error creating " << vertexPath << " and " << facePath << std::endl;
+        return false;
+    }
+    bool read = readOBJChunks(filename, [&](OBJChunk&& chunk) {
+        vertexFile.write(reinterpret_cast<const char*>(chunk.vertices.data()),
+                         static_cast<std::streamsize>(chunk.vertices.size() * sizeof(Vertex)));
+        faceFile.write(reinterpret_cast<const char*>(chunk.faces.data()),
+                       static_cast<std::streamsize>(chunk.faces.size() * sizeof(Face)));
+    });
+    return read && vertexFile && faceFile;
+}
+
+bool openMappedMesh(const std::string& directory, VertexArray& vertices, FaceArray& faces, bool writeBack) {
+    return openMappedArray(directory + "/vertices.bin", vertices, writeBack) &&
+           openMappedArray(directory + "/faces.bin", faces, writeBack);
+}
+
+bool startOBJStream(OBJStream& stream, const std::string& filename, size_t maxChunkBytes) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    stream.fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    stream.thread = std::thread([&stream, maxChunkBytes](std::ifstream input) {
+        setTraceThreadName("OBJ loader");
+        const size_t kFirstChunkBytes = 256u << 10;
+        bool completed = readOBJBlocks(input, std::min(kFirstChunkBytes, maxChunkBytes), maxChunkBytes,
+                                       &stream.cancelRequested, &stream.bytesRead, [&stream](OBJChunk&& chunk) {
+                                           std::lock_guard<std::mutex> lock(stream.mutex);
+                                           stream.chunks.push_back(std::move(chunk));
+                                       });
+        stream.failed = !completed || input.bad();
+        stream.finished = true;
+    }, std::move(file));
+    return true;
+}
+
+bool takeOBJChunk(OBJStream& stream, OBJChunk& chunk) {
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    if (stream.chunks.empty()) {
+        return false;
+    }
+    chunk = std::move(stream.chunks.front());
+    stream.chunks.pop_front();
+    return true;
+}
+
+bool objStreamDone(OBJStream& stream) {
+    if (!stream.finished.load()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    return stream.chunks.empty();
+}
+
+void stopOBJStream(OBJStream& stream) {
+    stream.cancelRequested = true;
+    if (stream.thread.joinable()) {
+        stream.thread.join();
+    }
+}
+
+// Records formatted per chunk, and chunks per thread in a batch
+const size_t kWriteChunkRecords = 1 << 13;
+const size_t kWriteChunksPerThread = 2;
+
+// Function to write count records to file. Batches of chunks are formatted
+// in parallel by format(first, last, out), which writes records [first,
+// last) to out, at most maxRecordBytes each, and returns the bytes used.
+// Each batch is written while the next one is formatted.
+static bool writeRecords(std::ostream& file, size_t count, size_t maxRecordBytes,
+                         const std::function<size_t(size_t, size_t, char*)>& format) {
+    const size_t chunksPerBatch = parallelThreadCount() * kWriteChunksPerThread;
+    const size_t batchRecords = chunksPerBatch * kWriteChunkRecords;
+    const size_t chunkBytes = kWriteChunkRecords * maxRecordBytes;
+    ScratchBuffer<char> firstBuffer(chunksPerBatch * chunkBytes), secondBuffer(chunksPerBatch * chunkBytes);
+    char* buffers[2] = {firstBuffer.data(), secondBuffer.data()};
+    ScratchBuffer<size_t> lengths(2 * chunksPerBatch);
+
+    auto formatBatch = [&](size_t batch) {
+        TRACE_SCOPE("formatRecords");
+        size_t first = batch * batchRecords;
+        size_t chunks = (std::min(count - first, batchRecords) + kWriteChunkRecords - 1) / kWriteChunkRecords;
+        parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) {
+                size_t chunkFirst = first + c * kWriteChunkRecords;
+                size_t chunkLast = std::min(count, chunkFirst + kWriteChunkRecords);
+                lengths[(batch & 1) * chunksPerBatch + c] =
+                    format(chunkFirst, chunkLast, buffers[batch & 1] + c * chunkBytes);
+            }
+        });
+    };
+    auto writeBatch = [&](size_t batch) {
+        TRACE_SCOPE("writeRecords");
+        size_t chunks = (std::min(count - batch * batchRecords, batchRecords) + kWriteChunkRecords - 1) / kWriteChunkRecords;
+        for (size_t c = 0; c < chunks; ++c) {
+            size_t length = lengths[(batch & 1) * chunksPerBatch + c];
+            file.write(buffers[batch & 1] + c * chunkBytes, static_cast<std::streamsize>(length));
+        }
+    };
+
+    const size_t batchCount = (count + batchRecords - 1) / batchRecords;
+    if (batchCount > 0) {
+        formatBatch(0);
+    }
+    for (size_t batch = 0; batch < batchCount; ++batch) {
+        if (batch + 1 < batchCount) {
+            parallelInvoke([&]() { writeBatch(batch); }, [&]() { formatBatch(batch + 1); });
+        } else {
+            writeBatch(batch);
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+// Longest shortest-round-trip text of a float ("-1.17549435e-38") and of an int
+const size_t kMaxFloatChars = 15;
+const size_t kMaxIndexChars = 10;
+
+static char* appendFloat(char* out, float value) {
+    return std::to_chars(out, out + kMaxFloatChars, value).ptr;
+}
+
+static char* appendIndex(char* out, uint32_t value) {
+    return std::to_chars(out, out + kMaxIndexChars, value).ptr;
+}
+
+bool writeOBJ(const std::string& filename, const VertexArray& vertices, const FaceArray& faces,
+              const std::vector<Normal>* normals) {
+    TRACE_SCOPE("writeOBJ");
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    const bool withNormals = normals && normals->size() == vertices.size();
+    file << "# " << vertices.size() << " vertices, " << faces.size() << " faces\n";
+
+    // "v x y z" and "vn x y z" lines
+    const size_t maxVertexLine = 3 + 3 * (kMaxFloatChars + 1);
+    auto formatVectors = [&](const char* prefix, size_t prefixLength, bool unscale) {
+        return [&, prefix, prefixLength, unscale](size_t first, size_t last, char* out) {
+            char* p = out;
+            for (size_t i = first; i < last; ++i) {
+                float x, y, z;
+                if (unscale) {
+                    x = vertices[i].x / kOBJScale;
+                    y = vertices[i].y / kOBJScale;
+                    z = vertices[i].z / kOBJScale;
+                } else {
+                    x = (*normals)[i].x;
+                    y = (*normals)[i].y;
+                    z = (*normals)[i].z;
+                }
+                std::memcpy(p, prefix, prefixLength);
+                p = appendFloat(p + prefixLength, x);
+                *p++ = ' ';
+                p = appendFloat(p, y);
+                *p++ = ' ';
+                p = appendFloat(p, z);
+                *p++ = '\n';
+            }
+            return static_cast<size_t>(p - out);
+        };
+    };
+    bool written = writeRecords(file, vertices.size(), maxVertexLine, formatVectors("v ", 2, true));
+    if (withNormals) {
+        written = written && writeRecords(file, vertices.size(), maxVertexLine, formatVectors("vn ", 3, false));
+    }
+
+    // "f a b c" or "f a//a b//b c//c" lines, 1-based
+    const size_t maxFaceLine = 2 + 3 * (2 * kMaxIndexChars + 3);
+    written = written && writeRecords(file, faces.size(), maxFaceLine, [&](size_t first, size_t last, char* out) {
+        char* p = out;
+        for (size_t i = first; i < last; ++i) {
+            const int corners[3] = {faces[i].v1, faces[i].v2, faces[i].v3};
+            *p++ = 'f';
+            for (int corner : corners) {
+                uint32_t index = static_cast<uint32_t>(corner) + 1;
+                *p++ = ' ';
+                p = appendIndex(p, index);
+                if (withNormals) {
+                    *p++ = '/';
+                    *p++ = '/';
+                    p = appendIndex(p, index);
+                }
+            }
+            *p++ = '\n';
+        }
+        return static_cast<size_t>(p - out);
+    });
+
+    file.close();
+    if (!written || !file) {
+        std::cerr << "Error writing " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool writePLY(const std::string& filename, const VertexArray& vertices, const FaceArray& faces,
+              const std::vector<Normal>* normals) {
+    TRACE_SCOPE("writePLY");
+    // Records are copied as they are in memory
+    const uint16_t byteOrderProbe = 1;
+    if (*reinterpret_cast<const uint8_t*>(&byteOrderProbe) != 1) {
+        std::cerr << "Writing PLY needs a little-endian machine" << std::endl;
+        return false;
+    }
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    const bool withNormals = normals && normals->size() == vertices.size();
+    file << "ply\nformat binary_little_endian 1.0\nelement vertex " << vertices.size()
+         << "\nproperty float x\nproperty float y\nproperty float z\n";
+    if (withNormals) {
+        file << "property float nx\nproperty float ny\nproperty float nz\n";
+    }
+    file << "element face " << faces.size() << "\nproperty list uchar int vertex_indices\nend_header\n";
+
+    const size_t vertexBytes = withNormals ? 6 * sizeof(float) : 3 * sizeof(float);
+    bool written = writeRecords(file, vertices.size(), vertexBytes, [&](size_t first, size_t last, char* out) {
+        char* p = out;
+        for (size_t i = first; i < last; ++i) {
+            float values[6] = {vertices[i].x / kOBJScale, vertices[i].y / kOBJScale, vertices[i].z / kOBJScale, 0, 0, 0};
+            if (withNormals) {
+                values[3] = (*normals)[i].x;
+                values[4] = (*normals)[i].y;
+                values[5] = (*normals)[i].z;
+            }
+            std::memcpy(p, values, vertexBytes);
+            p += vertexBytes;
+        }
+        return static_cast<size_t>(p - out);
+    });
+
+    const size_t faceBytes = 1 + 3 * sizeof(int32_t);
+    written = written && writeRecords(file, faces.size(), faceBytes, [&](size_t first, size_t last, char* out) {
+        char* p = out;
+        for (size_t i = first; i < last; ++i) {
+            const int32_t corners[3] = {faces[i].v1, faces[i].v2, faces[i].v3};
+            *p = 3;
+            std::memcpy(p + 1, corners, sizeof(corners));
+            p += faceBytes;
+        }
+        return static_cast<size_t>(p - out);
+    });
+
+    file.close();
+    if (!written || !file) {
+        std::cerr << "Error writing " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
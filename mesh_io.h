@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mesh.h"
+
+// Vertices and faces parsed from one stretch of an OBJ file. Face indices
+// are already global and 0-based.
+struct OBJChunk {
+    VertexArray vertices;
+    FaceArray faces;
+};
+
+// Positions are scaled up by this on load ("increase the size"), as they always have been
+const float kOBJScale = 2.2f;
+
+// Function to load an OBJ file. Reads it in blocks and parses each block's
+// lines in parallel. Positions are scaled by 2.2; polygons are split into
+// triangle fans, and texture and normal indices (v/vt/vn) are ignored.
+bool loadOBJ(const std::string& filename, VertexArray& vertices, FaceArray& faces);
+
+// Function to read an OBJ file block by block, without keeping it in memory:
+// every parsed block is passed to visit, in file order
+bool readOBJChunks(const std::string& filename, const std::function<void(OBJChunk&&)>& visit);
+
+// Function to convert an OBJ file, block by block, into vertices.bin and
+// faces.bin (raw Vertex and Face records) in directory, for openMappedMesh
+bool convertOBJToMeshFiles(const std::string& filename, const std::string& directory);
+
+// Function to map vertices.bin and faces.bin of directory as the mesh
+// arrays, so the OS pages them in on demand. With writeBack, edits to the
+// arrays go straight to the files.
+bool openMappedMesh(const std::string& directory, VertexArray& vertices, FaceArray& faces, bool writeBack);
+
+// OBJ file parsed on a background thread and handed over in chunks as it is
+// read. The first chunks are small so something can be shown right away;
+// later ones grow up to maxChunkBytes of file each.
+struct OBJStream {
+    std::thread thread;
+    std::mutex mutex;
+    std::deque<OBJChunk> chunks;
+    std::atomic<bool> finished{false};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> cancelRequested{false};
+    std::atomic<uint64_t> bytesRead{0};
+    uint64_t fileSize = 0;
+};
+
+// Function to open the file and start the loader thread. Returns false if
+// the file cannot be opened.
+bool startOBJStream(OBJStream& stream, const std::string& filename, size_t maxChunkBytes = 32u << 20);
+
+// Function to take the oldest parsed chunk, if one is ready
+bool takeOBJChunk(OBJStream& stream, OBJChunk& chunk);
+
+// Function to test whether the whole file was parsed and every chunk taken
+bool objStreamDone(OBJStream& stream);
+
+// Function to stop the loader thread early (if it is still running) and join it
+void stopOBJStream(OBJStream& stream);
+
+// Function to write an OBJ file that loadOBJ reads back: positions divided by
+// 2.2 to undo the load scale, then the normals (if given, one per vertex, as
+// vn lines with v//vn corners). Batches of lines are formatted in parallel,
+// with the shortest text that reads back to the same float, while the
+// previous batch is written.
+bool writeOBJ(const std::string& filename, const VertexArray& vertices, const FaceArray& faces,
+              const std::vector<Normal>* normals = nullptr);
+
+// Function to write a binary little-endian PLY file: float x, y, z (and nx,
+// ny, nz if normals are given) per vertex, divided by 2.2 like writeOBJ, and
+// a list of three ints per face
+bool writePLY(const std::string& filename, const VertexArray& vertices, const FaceArray& faces,
+              const std::vector<Normal>* normals = nullptr);
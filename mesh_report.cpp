@@ -0,0 +1,313 @@
+#include "mesh_report.h"
+#include "parallel.h"
+#include "radix_sort.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+// Keys of skipped edges and faces sort after every valid key
+static const uint64_t kInvalidKey = ~0ull;
+
+// Per-range partial sums of the face pass
+struct FacePartial {
+    double area = 0.0;
+    double volume = 0.0;
+    glm::dvec3 weightedCentroid = glm::dvec3(0.0);
+    glm::vec3 boundsMin = glm::vec3(INFINITY);
+    glm::vec3 boundsMax = glm::vec3(-INFINITY);
+    size_t histogram[kAspectRatioBinCount] = {};
+    size_t degenerate = 0;
+};
+
+// Per-range partial sums of the edge run scan
+struct EdgePartial {
+    size_t edges = 0;
+    size_t boundary = 0;
+    size_t nonManifold = 0;
+    size_t inconsistent = 0;
+    double lengthSum = 0.0;
+    float minLength = INFINITY;
+    float maxLength = 0.0f;
+};
+
+static glm::vec3 position(const Vertex& v) {
+    return glm::vec3(v.x, v.y, v.z);
+}
+
+// Half-edge 3f + k of face f starts at its k-th corner
+static int faceCorner(const Face& face, int k) {
+    return k == 0 ? face.v1 : (k == 1 ? face.v2 : face.v3);
+}
+
+static int aspectRatioBin(float aspect) {
+    int bin = 0;
+    while (bin < kAspectRatioBinCount - 1 && aspect >= kAspectRatioBinLimits[bin]) {
+        bin++;
+    }
+    return bin;
+}
+
+MeshReport computeMeshReport(const VertexArray& vertices, const FaceArray& faces) {
+    MeshReport report;
+    report.vertexCount = vertices.size();
+    report.faceCount = faces.size();
+    const size_t vertexCount = vertices.size();
+    const size_t halfEdgeCount = faces.size() * 3;
+
+    std::unique_ptr<std::atomic<unsigned char>[]> referenced(new std::atomic<unsigned char>[vertexCount]);
+    parallelFor(vertexCount, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            referenced[v].store(0, std::memory_order_relaxed);
+        }
+    });
+
+    // Fused pass: geometry sums, histogram and degeneracy per face, plus the
+    // edge keys (half-edge index as value) and sorted-corner face keys
+    std::vector<uint64_t> edgeKeys(halfEdgeCount), faceKeys(faces.size());
+    std::vector<uint32_t> edgeHalfEdges(halfEdgeCount), faceThirdCorner(faces.size());
+    FacePartial total;
+    std::mutex mutex;
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        FacePartial local;
+        for (size_t f = begin; f < end; ++f) {
+            const int corners[3] = {faces[f].v1, faces[f].v2, faces[f].v3};
+            bool inRange = true;
+            for (int corner : corners) {
+                inRange = inRange && corner >= 0 && static_cast<size_t>(corner) < vertexCount;
+            }
+            bool repeated = corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2];
+
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = static_cast<uint32_t>(corners[k]);
+                uint32_t b = static_cast<uint32_t>(corners[(k + 1) % 3]);
+                bool valid = inRange && a != b;
+                edgeKeys[f * 3 + k] = valid ? (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b) : kInvalidKey;
+                edgeHalfEdges[f * 3 + k] = static_cast<uint32_t>(f * 3 + k);
+            }
+            if (!inRange || repeated) {
+                faceKeys[f] = kInvalidKey;
+                faceThirdCorner[f] = 0;
+                local.degenerate++;
+                if (!inRange) {
+                    continue;
+                }
+            } else {
+                uint32_t sorted[3] = {static_cast<uint32_t>(corners[0]), static_cast<uint32_t>(corners[1]),
+                                      static_cast<uint32_t>(corners[2])};
+                std::sort(sorted, sorted + 3);
+                faceKeys[f] = (static_cast<uint64_t>(sorted[0]) << 32) | sorted[1];
+                faceThirdCorner[f] = sorted[2];
+            }
+            for (int corner : corners) {
+                referenced[corner].store(1, std::memory_order_relaxed);
+            }
+
+            glm::vec3 a = position(vertices[corners[0]]);
+            glm::vec3 b = position(vertices[corners[1]]);
+            glm::vec3 c = position(vertices[corners[2]]);
+            local.boundsMin = glm::min(local.boundsMin, glm::min(a, glm::min(b, c)));
+            local.boundsMax = glm::max(local.boundsMax, glm::max(a, glm::max(b, c)));
+
+            float area = 0.5f * glm::length(glm::cross(b - a, c - a));
+            local.area += area;
+            local.volume += glm::dot(a, glm::cross(b, c)) / 6.0;
+            local.weightedCentroid += glm::dvec3((a + b + c) * (area / 3.0f));
+
+            if (repeated) {
+                continue;
+            }
+            float l0 = glm::length(b - a), l1 = glm::length(c - b), l2 = glm::length(a - c);
+            float longest = std::max(l0, std::max(l1, l2));
+            if (!(area > 1e-12f * longest * longest)) {
+                local.degenerate++;
+                continue;
+            }
+            float aspect = longest * (l0 + l1 + l2) / (4.0f * std::sqrt(3.0f) * area);
+            local.histogram[aspectRatioBin(aspect)]++;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        total.area += local.area;
+        total.volume += local.volume;
+        total.weightedCentroid += local.weightedCentroid;
+        total.boundsMin = glm::min(total.boundsMin, local.boundsMin);
+        total.boundsMax = glm::max(total.boundsMax, local.boundsMax);
+        for (int i = 0; i < kAspectRatioBinCount; ++i) {
+            total.histogram[i] += local.histogram[i];
+        }
+        total.degenerate += local.degenerate;
+    });
+
+    report.surfaceArea = total.area;
+    report.volume = total.volume;
+    if (total.boundsMin.x <= total.boundsMax.x) {
+        report.boundsMin = total.boundsMin;
+        report.boundsMax = total.boundsMax;
+    }
+    if (total.area > 0.0) {
+        report.centroid = glm::vec3(total.weightedCentroid / total.area);
+    }
+    std::copy(total.histogram, total.histogram + kAspectRatioBinCount, report.aspectRatioHistogram);
+    report.degenerateFaceCount = total.degenerate;
+
+    size_t referencedCount = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        referencedCount += referenced[v].load(std::memory_order_relaxed);
+    }
+    report.referencedVertexCount = referencedCount;
+
+    radixSortPairs64(edgeKeys, edgeHalfEdges);
+    radixSortPairs64(faceKeys, faceThirdCorner);
+
+    // Classify every run of equal edge keys; workers start at the first run that begins in their range
+    EdgePartial edgeTotal;
+    parallelFor(halfEdgeCount, 1 << 14, [&](size_t begin, size_t end) {
+        EdgePartial local;
+        size_t i = begin;
+        while (i > 0 && i < halfEdgeCount && edgeKeys[i] == edgeKeys[i - 1]) {
+            i++;
+        }
+        while (i < end && edgeKeys[i] != kInvalidKey) {
+            size_t runEnd = i + 1;
+            while (runEnd < halfEdgeCount && edgeKeys[runEnd] == edgeKeys[i]) {
+                runEnd++;
+            }
+
+            size_t runLength = runEnd - i;
+            if (runLength == 1) {
+                local.boundary++;
+            } else if (runLength > 2) {
+                local.nonManifold++;
+            } else {
+                // Same direction when both half-edges start at the same vertex
+                uint32_t h0 = edgeHalfEdges[i], h1 = edgeHalfEdges[i + 1];
+                if (faceCorner(faces[h0 / 3], h0 % 3) == faceCorner(faces[h1 / 3], h1 % 3)) {
+                    local.inconsistent++;
+                }
+            }
+
+            const Vertex& a = vertices[edgeKeys[i] >> 32];
+            const Vertex& b = vertices[edgeKeys[i] & 0xffffffffu];
+            float length = glm::length(position(a) - position(b));
+            local.edges++;
+            local.lengthSum += length;
+            local.minLength = std::min(local.minLength, length);
+            local.maxLength = std::max(local.maxLength, length);
+            i = runEnd;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        edgeTotal.edges += local.edges;
+        edgeTotal.boundary += local.boundary;
+        edgeTotal.nonManifold += local.nonManifold;
+        edgeTotal.inconsistent += local.inconsistent;
+        edgeTotal.lengthSum += local.lengthSum;
+        edgeTotal.minLength = std::min(edgeTotal.minLength, local.minLength);
+        edgeTotal.maxLength = std::max(edgeTotal.maxLength, local.maxLength);
+    });
+
+    report.edgeCount = edgeTotal.edges;
+    report.boundaryEdgeCount = edgeTotal.boundary;
+    report.nonManifoldEdgeCount = edgeTotal.nonManifold;
+    report.inconsistentEdgeCount = edgeTotal.inconsistent;
+    if (edgeTotal.edges > 0) {
+        report.minEdgeLength = edgeTotal.minLength;
+        report.maxEdgeLength = edgeTotal.maxLength;
+        report.meanEdgeLength = static_cast<float>(edgeTotal.lengthSum / edgeTotal.edges);
+    }
+
+    // Duplicate faces share the two smallest corners, so only runs need a closer look
+    std::atomic<size_t> duplicates(0);
+    parallelFor(faces.size(), 1 << 14, [&](size_t begin, size_t end) {
+        size_t i = begin;
+        while (i > 0 && i < faces.size() && faceKeys[i] == faceKeys[i - 1]) {
+            i++;
+        }
+        size_t localDuplicates = 0;
+        std::vector<uint32_t> thirdCorners;
+        while (i < end && faceKeys[i] != kInvalidKey) {
+            size_t runEnd = i + 1;
+            while (runEnd < faces.size() && faceKeys[runEnd] == faceKeys[i]) {
+                runEnd++;
+            }
+            if (runEnd - i > 1) {
+                thirdCorners.assign(faceThirdCorner.begin() + i, faceThirdCorner.begin() + runEnd);
+                std::sort(thirdCorners.begin(), thirdCorners.end());
+                size_t unique = std::unique(thirdCorners.begin(), thirdCorners.end()) - thirdCorners.begin();
+                localDuplicates += thirdCorners.size() - unique;
+            }
+            i = runEnd;
+        }
+        duplicates += localDuplicates;
+    });
+    report.duplicateFaceCount = duplicates;
+
+    report.eulerCharacteristic = static_cast<long long>(report.referencedVertexCount) -
+                                 static_cast<long long>(report.edgeCount) + static_cast<long long>(report.faceCount);
+    return report;
+}
+
+static void writeVec3(std::ostream& out, const glm::vec3& v) {
+    out << "[" << v.x << ", " << v.y << ", " << v.z << "]";
+}
+
+std::string meshReportToJSON(const MeshReport& report) {
+    std::ostringstream out;
+    out.precision(9);
+    out << "{\n";
+    out << "  \"vertices\": " << report.vertexCount << ",\n";
+    out << "  \"referencedVertices\": " << report.referencedVertexCount << ",\n";
+    out << "  \"faces\": " << report.faceCount << ",\n";
+    out << "  \"edges\": " << report.edgeCount << ",\n";
+    out << "  \"surfaceArea\": " << report.surfaceArea << ",\n";
+    out << "  \"volume\": " << report.volume << ",\n";
+    out << "  \"boundsMin\": ";
+    writeVec3(out, report.boundsMin);
+    out << ",\n  \"boundsMax\": ";
+    writeVec3(out, report.boundsMax);
+    out << ",\n  \"centroid\": ";
+    writeVec3(out, report.centroid);
+    out << ",\n";
+    out << "  \"edgeLength\": {\"min\": " << report.minEdgeLength << ", \"mean\": " << report.meanEdgeLength
+        << ", \"max\": " << report.maxEdgeLength << "},\n";
+    out << "  \"aspectRatioHistogram\": [";
+    for (int i = 0; i < kAspectRatioBinCount; ++i) {
+        out << (i > 0 ? ", " : "") << "{\"upTo\": ";
+        if (i < kAspectRatioBinCount - 1) {
+            out << kAspectRatioBinLimits[i];
+        } else {
+            out << "null";
+        }
+        out << ", \"faces\": " << report.aspectRatioHistogram[i] << "}";
+    }
+    out << "],\n";
+    out << "  \"degenerateFaces\": " << report.degenerateFaceCount << ",\n";
+    out << "  \"duplicateFaces\": " << report.duplicateFaceCount << ",\n";
+    out << "  \"boundaryEdges\": " << report.boundaryEdgeCount << ",\n";
+    out << "  \"nonManifoldEdges\": " << report.nonManifoldEdgeCount << ",\n";
+    out << "  \"inconsistentEdges\": " << report.inconsistentEdgeCount << ",\n";
+    out << "  \"eulerCharacteristic\": " << report.eulerCharacteristic << "\n";
+    out << "}\n";
+    return out.str();
+}
+
+bool writeMeshReport(const MeshReport& report, const std::string& filename) {
+    std::string json = meshReportToJSON(report);
+    if (filename == "-") {
+        std::cout << json;
+        return true;
+    }
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    file << json;
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+
+// Upper bounds of the triangle aspect-ratio histogram bins; the last bin is open.
+// Aspect ratio is longest edge * perimeter / (4 * sqrt(3) * area), 1 for an
+// equilateral triangle.
+const int kAspectRatioBinCount = 6;
+const float kAspectRatioBinLimits[kAspectRatioBinCount - 1] = {1.5f, 2.0f, 3.0f, 5.0f, 10.0f};
+
+struct MeshReport {
+    size_t vertexCount = 0;
+    size_t referencedVertexCount = 0;
+    size_t faceCount = 0;
+    size_t edgeCount = 0;
+
+    double surfaceArea = 0.0;
+    // Signed sum of origin tetrahedra; only meaningful for closed, consistently oriented meshes
+    double volume = 0.0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // Area-weighted centroid of the surface
+    glm::vec3 centroid = glm::vec3(0.0f);
+
+    // Over unique edges
+    float minEdgeLength = 0.0f;
+    float meanEdgeLength = 0.0f;
+    float maxEdgeLength = 0.0f;
+
+    // Non-degenerate faces only
+    size_t aspectRatioHistogram[kAspectRatioBinCount] = {};
+
+    // Faces with repeated or out-of-range indices, or (near) zero area
+    size_t degenerateFaceCount = 0;
+    // Faces using the same three vertices as an earlier face, in any order
+    size_t duplicateFaceCount = 0;
+    size_t boundaryEdgeCount = 0;
+    // Edges shared by more than two faces
+    size_t nonManifoldEdgeCount = 0;
+    // Edges shared by two faces that traverse it in the same direction
+    size_t inconsistentEdgeCount = 0;
+    // Referenced vertices - edges + faces
+    long long eulerCharacteristic = 0;
+};
+
+// Function to analyze the mesh in one fused parallel pass over the faces,
+// with per-thread reductions; edge and duplicate-face statistics come from
+// the sorted edge and face keys emitted by that pass
+MeshReport computeMeshReport(const VertexArray& vertices, const FaceArray& faces);
+
+// Function to format the report as a JSON object
+std::string meshReportToJSON(const MeshReport& report);
+
+// Function to write the report as JSON to a file, or to standard output for "-"
+bool writeMeshReport(const MeshReport& report, const std::string& filename);
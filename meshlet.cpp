@@ -0,0 +1,232 @@
+#include "meshlet.h"
+#include "parallel.h"
+#include "radix_sort.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+// Spread the low 10 bits of v so there are two zero bits between each of them
+static uint32_t expandBits(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+static glm::vec3 toVec3(const Vertex& v) {
+    return glm::vec3(v.x, v.y, v.z);
+}
+
+static glm::vec3 faceCentroid(const VertexArray& vertices, const Face& face) {
+    return (toVec3(vertices[face.v1]) + toVec3(vertices[face.v2]) + toVec3(vertices[face.v3])) * (1.0f / 3.0f);
+}
+
+// Meshlets built by one worker over a contiguous run of the Morton-ordered faces
+struct MeshletSegment {
+    std::vector<Meshlet> meshlets;
+    std::vector<unsigned int> vertices;
+    std::vector<unsigned char> triangles;
+    std::vector<unsigned int> faces;
+};
+
+static void buildSegment(const FaceArray& faces, const std::vector<uint64_t>& order,
+                         size_t begin, size_t end, unsigned int maxVertices, unsigned int maxTriangles,
+                         MeshletSegment& segment) {
+    size_t estimate = (end - begin + maxTriangles - 1) / maxTriangles;
+    segment.meshlets.reserve(estimate);
+    segment.vertices.reserve(estimate * maxVertices);
+    segment.triangles.reserve((end - begin) * 3);
+    segment.faces.reserve(end - begin);
+
+    Meshlet current = {0, 0, 0, 0};
+    for (size_t i = begin; i < end; ++i) {
+        unsigned int faceIndex = static_cast<unsigned int>(order[i] & 0xffffffffu);
+        const Face& face = faces[faceIndex];
+        unsigned int corners[3] = {static_cast<unsigned int>(face.v1), static_cast<unsigned int>(face.v2),
+                                   static_cast<unsigned int>(face.v3)};
+
+        // Count the corners that are not yet part of the current meshlet
+        const unsigned int* local = segment.vertices.data() + current.vertexOffset;
+        unsigned int missing = 0;
+        for (int k = 0; k < 3; ++k) {
+            bool found = std::find(local, local + current.vertexCount, corners[k]) != local + current.vertexCount;
+            bool repeated = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+            if (!found && !repeated) {
+                missing++;
+            }
+        }
+
+        if (current.vertexCount + missing > maxVertices || current.triangleCount + 1 > maxTriangles) {
+            segment.meshlets.push_back(current);
+            current.vertexOffset += current.vertexCount;
+            current.triangleOffset += current.triangleCount;
+            current.vertexCount = 0;
+            current.triangleCount = 0;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            local = segment.vertices.data() + current.vertexOffset;
+            unsigned int slot = static_cast<unsigned int>(std::find(local, local + current.vertexCount, corners[k]) - local);
+            if (slot == current.vertexCount) {
+                segment.vertices.push_back(corners[k]);
+                current.vertexCount++;
+            }
+            segment.triangles.push_back(static_cast<unsigned char>(slot));
+        }
+        segment.faces.push_back(faceIndex);
+        current.triangleCount++;
+    }
+
+    if (current.triangleCount > 0) {
+        segment.meshlets.push_back(current);
+    }
+}
+
+MeshletMesh buildMeshlets(const VertexArray& vertices, const FaceArray& faces,
+                          unsigned int maxVertices, unsigned int maxTriangles) {
+    MeshletMesh result;
+    if (faces.empty()) {
+        return result;
+    }
+
+    // Local indices are stored in a byte, and a triangle needs three vertices
+    maxVertices = std::min(std::max(maxVertices, 3u), 256u);
+    maxTriangles = std::max(maxTriangles, 1u);
+
+    // Bounds of the face centroids, used to quantize them for the Morton curve
+    glm::vec3 sceneMin(INFINITY), sceneMax(-INFINITY);
+    std::mutex boundsMutex;
+    parallelFor(faces.size(), 1 << 16, [&](size_t begin, size_t end) {
+        glm::vec3 localMin(INFINITY), localMax(-INFINITY);
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 centroid = faceCentroid(vertices, faces[i]);
+            localMin = glm::min(localMin, centroid);
+            localMax = glm::max(localMax, centroid);
+        }
+        std::lock_guard<std::mutex> lock(boundsMutex);
+        sceneMin = glm::min(sceneMin, localMin);
+        sceneMax = glm::max(sceneMax, localMax);
+    });
+
+    glm::vec3 extent = glm::max(sceneMax - sceneMin, glm::vec3(1e-20f));
+    glm::vec3 scale = glm::vec3(1023.0f) / extent;
+
+    // Morton code in the high half of the key, face index in the low half
+    std::vector<uint64_t> order(faces.size());
+    parallelFor(faces.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 cell = (faceCentroid(vertices, faces[i]) - sceneMin) * scale;
+            uint32_t code = (expandBits(static_cast<uint32_t>(cell.x)) << 2) |
+                            (expandBits(static_cast<uint32_t>(cell.y)) << 1) |
+                            expandBits(static_cast<uint32_t>(cell.z));
+            order[i] = (static_cast<uint64_t>(code) << 32) | i;
+        }
+    });
+    radixSort64(order, 32, 62);
+
+    // Every worker fills meshlets greedily over its own run of the curve
+    const size_t segmentGrain = 1 << 15;
+    size_t segmentCount = std::min<size_t>(parallelThreadCount(), (faces.size() + segmentGrain - 1) / segmentGrain);
+    segmentCount = std::max<size_t>(segmentCount, 1);
+    size_t segmentSize = (faces.size() + segmentCount - 1) / segmentCount;
+    std::vector<MeshletSegment> segments(segmentCount);
+    parallelFor(segmentCount, 1, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            size_t first = std::min(faces.size(), s * segmentSize);
+            size_t last = std::min(faces.size(), first + segmentSize);
+            buildSegment(faces, order, first, last, maxVertices, maxTriangles, segments[s]);
+        }
+    });
+
+    // Concatenate the segments, rebasing their offsets
+    size_t meshletCount = 0, vertexCount = 0;
+    for (const auto& segment : segments) {
+        meshletCount += segment.meshlets.size();
+        vertexCount += segment.vertices.size();
+    }
+    result.meshlets.reserve(meshletCount);
+    result.meshletVertices.reserve(vertexCount);
+    result.meshletTriangles.reserve(faces.size() * 3);
+    result.meshletFaces.reserve(faces.size());
+
+    for (const auto& segment : segments) {
+        unsigned int vertexBase = static_cast<unsigned int>(result.meshletVertices.size());
+        unsigned int triangleBase = static_cast<unsigned int>(result.meshletFaces.size());
+        for (Meshlet meshlet : segment.meshlets) {
+            meshlet.vertexOffset += vertexBase;
+            meshlet.triangleOffset += triangleBase;
+            result.meshlets.push_back(meshlet);
+        }
+        result.meshletVertices.insert(result.meshletVertices.end(), segment.vertices.begin(), segment.vertices.end());
+        result.meshletTriangles.insert(result.meshletTriangles.end(), segment.triangles.begin(), segment.triangles.end());
+        result.meshletFaces.insert(result.meshletFaces.end(), segment.faces.begin(), segment.faces.end());
+    }
+
+    updateMeshletBounds(result, vertices);
+    return result;
+}
+
+void updateMeshletBounds(MeshletMesh& mesh, const VertexArray& vertices) {
+    mesh.bounds.resize(mesh.meshlets.size());
+
+    parallelFor(mesh.meshlets.size(), 256, [&](size_t begin, size_t end) {
+        for (size_t m = begin; m < end; ++m) {
+            const Meshlet& meshlet = mesh.meshlets[m];
+            const unsigned int* indices = mesh.meshletVertices.data() + meshlet.vertexOffset;
+            const unsigned char* triangles = mesh.meshletTriangles.data() + meshlet.triangleOffset * 3;
+            MeshletBounds& bounds = mesh.bounds[m];
+
+            // Sphere around the center of the vertex AABB
+            glm::vec3 boxMin(INFINITY), boxMax(-INFINITY);
+            for (unsigned int i = 0; i < meshlet.vertexCount; ++i) {
+                glm::vec3 p = toVec3(vertices[indices[i]]);
+                boxMin = glm::min(boxMin, p);
+                boxMax = glm::max(boxMax, p);
+            }
+            bounds.center = (boxMin + boxMax) * 0.5f;
+            float radiusSquared = 0.0f;
+            for (unsigned int i = 0; i < meshlet.vertexCount; ++i) {
+                glm::vec3 d = toVec3(vertices[indices[i]]) - bounds.center;
+                radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+            }
+            bounds.radius = std::sqrt(radiusSquared);
+
+            // Normal cone: average of the unit face normals, widened to cover all of them
+            auto triangleNormal = [&](unsigned int t) {
+                glm::vec3 a = toVec3(vertices[indices[triangles[t * 3 + 0]]]);
+                glm::vec3 b = toVec3(vertices[indices[triangles[t * 3 + 1]]]);
+                glm::vec3 c = toVec3(vertices[indices[triangles[t * 3 + 2]]]);
+                glm::vec3 n = glm::cross(b - a, c - a);
+                float length = glm::length(n);
+                return length > 0.0f ? n / length : glm::vec3(0.0f);
+            };
+
+            glm::vec3 axis(0.0f);
+            for (unsigned int t = 0; t < meshlet.triangleCount; ++t) {
+                axis += triangleNormal(t);
+            }
+
+            float axisLength = glm::length(axis);
+            if (axisLength == 0.0f) {
+                bounds.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+                bounds.coneCutoff = 1.0f;
+                continue;
+            }
+            bounds.coneAxis = axis / axisLength;
+
+            // Degenerate triangles have a zero normal and never affect visibility
+            float minDot = 1.0f;
+            for (unsigned int t = 0; t < meshlet.triangleCount; ++t) {
+                glm::vec3 n = triangleNormal(t);
+                if (n != glm::vec3(0.0f)) {
+                    minDot = std::min(minDot, glm::dot(n, bounds.coneAxis));
+                }
+            }
+            // Cones wider than ~84 degrees almost never cull, so disable them
+            bounds.coneCutoff = (minDot <= 0.1f) ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+        }
+    });
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+
+// Limits used when partitioning faces into meshlets
+const unsigned int kMeshletMaxVertices = 64;
+const unsigned int kMeshletMaxTriangles = 124;
+
+// A meshlet references a run of meshletVertices (global vertex indices) and
+// a run of triangles in meshletTriangles (three local indices per triangle).
+// Both offsets count elements of their run, so triangle t of a meshlet starts
+// at meshletTriangles[3 * (triangleOffset + t)].
+struct Meshlet {
+    unsigned int vertexOffset;
+    unsigned int triangleOffset;
+    unsigned int vertexCount;
+    unsigned int triangleCount;
+};
+
+// Culling data for one meshlet: a bounding sphere and a normal cone.
+// The cluster is entirely backfacing when
+//     dot(center - cameraPos, coneAxis) >= coneCutoff * length(center - cameraPos) + radius
+// A coneCutoff of 1 disables cone culling for that meshlet.
+struct MeshletBounds {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Meshlets are the unit of work for the culling and the bounds refit, which
+// run per cluster. The other CPU kernels split faces and vertices into
+// parallelFor index ranges instead; they scatter into shared vertices, which
+// cluster boundaries would not make any safer.
+struct MeshletMesh {
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;
+    std::vector<unsigned int> meshletVertices;
+    std::vector<unsigned char> meshletTriangles;
+    // Index into the source faces for every meshlet triangle, in meshlet order
+    std::vector<unsigned int> meshletFaces;
+};
+
+// Function to partition faces into spatially coherent meshlets.
+// Faces are ordered along a Morton curve of their centroids and then filled
+// greedily into meshlets, so every meshlet covers a compact patch of surface.
+MeshletMesh buildMeshlets(const VertexArray& vertices, const FaceArray& faces,
+                          unsigned int maxVertices = kMeshletMaxVertices,
+                          unsigned int maxTriangles = kMeshletMaxTriangles);
+
+// Function to recompute bounding spheres and normal cones, e.g. after the
+// vertex positions were changed by noise or smoothing
+void updateMeshletBounds(MeshletMesh& mesh, const VertexArray& vertices);
+
+// Function to test a meshlet's normal cone against the camera position
+inline bool isMeshletBackfacing(const MeshletBounds& bounds, const glm::vec3& cameraPos) {
+    glm::vec3 toCenter = bounds.center - cameraPos;
+    return glm::dot(toCenter, bounds.coneAxis) >= bounds.coneCutoff * glm::length(toCenter) + bounds.radius;
+}
@@ -0,0 +1,794 @@
+#include "out_of_core.h"
+#include "halfedge.h"
+#include "mesh.h"
+#include "mesh_io.h"
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// A face with its corner positions, as stored in the soup and chunk files
+struct SoupCorner {
+    int id;
+    float x, y, z;
+};
+
+struct SoupFace {
+    SoupCorner corners[3];
+};
+
+// Faces read, filled in and written back per step of the soup pass
+const size_t kSoupBlockFaces = 1 << 16;
+
+// Edges longer than the halo edge length, as a fraction of all edges
+const double kLongEdgeFraction = 1e-4;
+// Edge lengths are counted in bins of an eighth of an octave, indexed by the
+// float exponent and the top three mantissa bits
+const int kEdgeBinsPerOctave = 8;
+const int kEdgeBinExponentOffset = 160;
+const size_t kEdgeLengthBins = (kEdgeBinExponentOffset + 130) * kEdgeBinsPerOctave;
+
+static std::string filePath(const std::string& directory, const std::string& name) {
+    return (fs::path(directory) / name).string();
+}
+
+static std::string chunkFile(const std::string& directory, int cell) {
+    return filePath(directory, "chunk_" + std::to_string(cell) + ".bin");
+}
+
+static std::string resultFile(const std::string& directory, int cell) {
+    return filePath(directory, "result_" + std::to_string(cell) + ".bin");
+}
+
+static int cellCoordinate(float p, float min, float size, int count) {
+    int c = static_cast<int>(std::floor((p - min) / size));
+    return std::min(std::max(c, 0), count - 1);
+}
+
+static int cellOf(const ChunkedMeshLayout& layout, float x, float y, float z) {
+    int cx = cellCoordinate(x, layout.boundsMin[0], layout.cellSize, layout.grid[0]);
+    int cy = cellCoordinate(y, layout.boundsMin[1], layout.cellSize, layout.grid[1]);
+    int cz = cellCoordinate(z, layout.boundsMin[2], layout.cellSize, layout.grid[2]);
+    return (cz * layout.grid[1] + cy) * layout.grid[0] + cx;
+}
+
+// Function to add every cell whose box, grown by the halo width, contains the corner
+static void addHaloCells(const ChunkedMeshLayout& layout, const SoupCorner& corner, std::vector<int>& cells) {
+    const float p[3] = {corner.x, corner.y, corner.z};
+    int low[3], high[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        low[axis] = cellCoordinate(p[axis] - layout.haloWidth, layout.boundsMin[axis], layout.cellSize, layout.grid[axis]);
+        high[axis] = cellCoordinate(p[axis] + layout.haloWidth, layout.boundsMin[axis], layout.cellSize, layout.grid[axis]);
+    }
+    for (int z = low[2]; z <= high[2]; ++z) {
+        for (int y = low[1]; y <= high[1]; ++y) {
+            for (int x = low[0]; x <= high[0]; ++x) {
+                cells.push_back((z * layout.grid[1] + y) * layout.grid[0] + x);
+            }
+        }
+    }
+}
+
+static float cornerDistance(const SoupCorner& a, const SoupCorner& b) {
+    float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+static size_t edgeLengthBin(float length) {
+    if (!(length > 0.0f)) {
+        return 0;
+    }
+    int exponent = 0;
+    float mantissa = std::frexp(length, &exponent);
+    int sub = std::min(static_cast<int>((mantissa - 0.5f) * 2 * kEdgeBinsPerOctave), kEdgeBinsPerOctave - 1);
+    int bin = (exponent + kEdgeBinExponentOffset) * kEdgeBinsPerOctave + sub;
+    return static_cast<size_t>(std::min(std::max(bin, 0), static_cast<int>(kEdgeLengthBins) - 1));
+}
+
+// Upper end of the lengths counted in a bin
+static float edgeLengthBinEnd(size_t bin) {
+    int exponent = static_cast<int>(bin) / kEdgeBinsPerOctave - kEdgeBinExponentOffset;
+    int sub = static_cast<int>(bin) % kEdgeBinsPerOctave;
+    return std::ldexp(0.5f + 0.5f * (sub + 1) / kEdgeBinsPerOctave, exponent);
+}
+
+template <typename T, typename Allocator>
+static bool readRecords(const std::string& path, std::vector<T, Allocator>& records) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    records.resize(static_cast<size_t>(file.tellg()) / sizeof(T));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(T)));
+    return static_cast<bool>(file);
+}
+
+static bool writeLayout(const std::string& directory, const ChunkedMeshLayout& layout) {
+    std::ofstream file(filePath(directory, "layout.txt"));
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filePath(directory, "layout.txt") << std::endl;
+        return false;
+    }
+    file.precision(9);
+    file << "vertices " << layout.vertexCount << "\n";
+    file << "faces " << layout.faceCount << "\n";
+    file << "origin " << layout.boundsMin[0] << " " << layout.boundsMin[1] << " " << layout.boundsMin[2] << "\n";
+    file << "cell " << layout.cellSize << "\n";
+    file << "grid " << layout.grid[0] << " " << layout.grid[1] << " " << layout.grid[2] << "\n";
+    file << "halo " << layout.haloRings << " " << layout.haloWidth << "\n";
+    file << "maxedge " << layout.maxEdgeLength << "\n";
+    file << "haloedge " << layout.haloEdgeLength << " " << layout.longEdgeCount << "\n";
+    for (size_t i = 0; i < layout.cells.size(); ++i) {
+        file << "chunk " << layout.cells[i] << " " << layout.cellFaces[i] << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+bool readChunkedMeshLayout(const std::string& directory, ChunkedMeshLayout& layout) {
+    std::ifstream file(filePath(directory, "layout.txt"));
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filePath(directory, "layout.txt") << std::endl;
+        return false;
+    }
+    layout = ChunkedMeshLayout();
+    std::string key;
+    while (file >> key) {
+        if (key == "vertices") {
+            file >> layout.vertexCount;
+        } else if (key == "faces") {
+            file >> layout.faceCount;
+        } else if (key == "origin") {
+            file >> layout.boundsMin[0] >> layout.boundsMin[1] >> layout.boundsMin[2];
+        } else if (key == "cell") {
+            file >> layout.cellSize;
+        } else if (key == "grid") {
+            file >> layout.grid[0] >> layout.grid[1] >> layout.grid[2];
+        } else if (key == "halo") {
+            file >> layout.haloRings >> layout.haloWidth;
+        } else if (key == "maxedge") {
+            file >> layout.maxEdgeLength;
+        } else if (key == "haloedge") {
+            file >> layout.haloEdgeLength >> layout.longEdgeCount;
+        } else if (key == "chunk") {
+            int cell;
+            size_t faces;
+            file >> cell >> faces;
+            layout.cells.push_back(cell);
+            layout.cellFaces.push_back(faces);
+        } else {
+            std::cerr << "Unknown entry in chunked mesh layout: " << key << std::endl;
+            return false;
+        }
+    }
+    return !file.bad();
+}
+
+// Function to write the raw vertex and face files and measure the bounds
+static bool ingestOBJ(const std::string& objPath, const std::string& directory, ChunkedMeshLayout& layout,
+                      float boundsMax[3]) {
+    TRACE_SCOPE("ingestOBJ");
+    std::ofstream vertexFile(filePath(directory, "vertices.bin"), std::ios::binary | std::ios::trunc);
+    std::ofstream faceFile(filePath(directory, "faces.bin"), std::ios::binary | std::ios::trunc);
+    if (!vertexFile.is_open() || !faceFile.is_open()) {
+        std::cerr << "Error creating files in " << directory << std::endl;
+        return false;
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        layout.boundsMin[axis] = INFINITY;
+        boundsMax[axis] = -INFINITY;
+    }
+    bool read = readOBJChunks(objPath, [&](OBJChunk&& chunk) {
+        for (const Vertex& v : chunk.vertices) {
+            const float p[3] = {v.x, v.y, v.z};
+            for (int axis = 0; axis < 3; ++axis) {
+                layout.boundsMin[axis] = std::min(layout.boundsMin[axis], p[axis]);
+                boundsMax[axis] = std::max(boundsMax[axis], p[axis]);
+            }
+        }
+        vertexFile.write(reinterpret_cast<const char*>(chunk.vertices.data()),
+                         static_cast<std::streamsize>(chunk.vertices.size() * sizeof(Vertex)));
+        faceFile.write(reinterpret_cast<const char*>(chunk.faces.data()),
+                       static_cast<std::streamsize>(chunk.faces.size() * sizeof(Face)));
+        layout.vertexCount += chunk.vertices.size();
+        layout.faceCount += chunk.faces.size();
+    });
+    return read && vertexFile && faceFile;
+}
+
+// Function to build the triangle soup: for every window of vertices that
+// fits the budget, stream all faces and fill in the corners in the window.
+// Counts the edge lengths (three per face) into edgeLengths.
+static bool buildSoup(const std::string& directory, const ChunkedMeshOptions& options, ChunkedMeshLayout& layout,
+                      std::vector<size_t>& edgeLengths) {
+    TRACE_SCOPE("buildSoup");
+    const size_t V = layout.vertexCount, F = layout.faceCount;
+    const std::string soupPath = filePath(directory, "soup.bin");
+    std::ofstream(soupPath, std::ios::binary | std::ios::trunc).close();
+    fs::resize_file(soupPath, F * sizeof(SoupFace));
+    std::fstream soupFile(soupPath, std::ios::binary | std::ios::in | std::ios::out);
+    std::ifstream vertexFile(filePath(directory, "vertices.bin"), std::ios::binary);
+    if (!soupFile.is_open() || !vertexFile.is_open()) {
+        std::cerr << "Error opening files in " << directory << std::endl;
+        return false;
+    }
+
+    const size_t blockBytes = kSoupBlockFaces * (sizeof(Face) + sizeof(SoupFace));
+    const size_t window = std::max<size_t>(1, (options.memoryBudget - std::min(options.memoryBudget, blockBytes)) / sizeof(Vertex));
+    VertexArray positions;
+    FaceArray faces;
+    std::vector<SoupFace> soup;
+    float maxEdge = 0.0f;
+    edgeLengths.assign(kEdgeLengthBins, 0);
+    for (size_t windowStart = 0; windowStart < V; windowStart += window) {
+        const size_t windowEnd = std::min(V, windowStart + window);
+        const bool firstWindow = windowStart == 0, lastWindow = windowEnd == V;
+        positions.resize(windowEnd - windowStart);
+        vertexFile.seekg(static_cast<std::streamoff>(windowStart * sizeof(Vertex)));
+        vertexFile.read(reinterpret_cast<char*>(positions.data()), static_cast<std::streamsize>(positions.size() * sizeof(Vertex)));
+
+        std::ifstream faceFile(filePath(directory, "faces.bin"), std::ios::binary);
+        for (size_t first = 0; first < F; first += kSoupBlockFaces) {
+            const size_t count = std::min(kSoupBlockFaces, F - first);
+            faces.resize(count);
+            soup.resize(count);
+            faceFile.read(reinterpret_cast<char*>(faces.data()), static_cast<std::streamsize>(count * sizeof(Face)));
+            if (!firstWindow) {
+                soupFile.seekg(static_cast<std::streamoff>(first * sizeof(SoupFace)));
+                soupFile.read(reinterpret_cast<char*>(soup.data()), static_cast<std::streamsize>(count * sizeof(SoupFace)));
+            }
+
+            bool valid = true;
+            for (size_t i = 0; i < count; ++i) {
+                const int corners[3] = {faces[i].v1, faces[i].v2, faces[i].v3};
+                for (int k = 0; k < 3; ++k) {
+                    size_t id = static_cast<size_t>(corners[k]);
+                    if (corners[k] < 0 || id >= V) {
+                        valid = false;
+                    } else if (id >= windowStart && id < windowEnd) {
+                        const Vertex& v = positions[id - windowStart];
+                        soup[i].corners[k] = {corners[k], v.x, v.y, v.z};
+                    }
+                }
+                if (lastWindow) {
+                    const SoupCorner* c = soup[i].corners;
+                    const float edges[3] = {cornerDistance(c[0], c[1]), cornerDistance(c[1], c[2]), cornerDistance(c[2], c[0])};
+                    for (float edge : edges) {
+                        maxEdge = std::max(maxEdge, edge);
+                        edgeLengths[edgeLengthBin(edge)]++;
+                    }
+                }
+            }
+            if (!valid) {
+                std::cerr << "Face index out of range in faces " << first << " to " << first + count << std::endl;
+                return false;
+            }
+
+            soupFile.seekp(static_cast<std::streamoff>(first * sizeof(SoupFace)));
+            soupFile.write(reinterpret_cast<const char*>(soup.data()), static_cast<std::streamsize>(count * sizeof(SoupFace)));
+        }
+        if (!faceFile || !soupFile) {
+            std::cerr << "Error building the face soup in " << directory << std::endl;
+            return false;
+        }
+    }
+    if (F > 0 && V == 0) {
+        std::cerr << "Faces without vertices" << std::endl;
+        return false;
+    }
+    layout.maxEdgeLength = maxEdge;
+    return true;
+}
+
+// Function to copy every soup face into the chunk of each cell it touches
+// (its own and the halos), through per-cell buffers flushed to the chunk
+// files whenever together they outgrow half the budget
+static bool distributeSoup(const std::string& directory, const ChunkedMeshOptions& options, ChunkedMeshLayout& layout) {
+    TRACE_SCOPE("distributeSoup");
+    std::ifstream soupFile(filePath(directory, "soup.bin"), std::ios::binary);
+    if (!soupFile.is_open()) {
+        std::cerr << "Error opening file: " << filePath(directory, "soup.bin") << std::endl;
+        return false;
+    }
+
+    std::unordered_map<int, std::vector<SoupFace>> buffers;
+    std::unordered_map<int, size_t> cellFaces;
+    size_t buffered = 0;
+    bool written = true;
+    auto flush = [&]() {
+        for (auto& entry : buffers) {
+            if (entry.second.empty()) {
+                continue;
+            }
+            std::ofstream chunk(chunkFile(directory, entry.first), std::ios::binary | std::ios::app);
+            chunk.write(reinterpret_cast<const char*>(entry.second.data()),
+                        static_cast<std::streamsize>(entry.second.size() * sizeof(SoupFace)));
+            written = written && static_cast<bool>(chunk);
+            entry.second.clear();
+        }
+        buffered = 0;
+    };
+
+    std::vector<SoupFace> soup;
+    std::vector<int> cells;
+    for (size_t first = 0; first < layout.faceCount; first += kSoupBlockFaces) {
+        const size_t count = std::min(kSoupBlockFaces, layout.faceCount - first);
+        soup.resize(count);
+        soupFile.read(reinterpret_cast<char*>(soup.data()), static_cast<std::streamsize>(count * sizeof(SoupFace)));
+        for (const SoupFace& face : soup) {
+            cells.clear();
+            for (const SoupCorner& corner : face.corners) {
+                addHaloCells(layout, corner, cells);
+            }
+            std::sort(cells.begin(), cells.end());
+            cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+            for (int cell : cells) {
+                buffers[cell].push_back(face);
+                cellFaces[cell]++;
+            }
+            buffered += cells.size() * sizeof(SoupFace);
+            if (buffered > options.memoryBudget / 2) {
+                flush();
+            }
+        }
+    }
+    flush();
+    if (!soupFile || !written) {
+        std::cerr << "Error writing chunks in " << directory << std::endl;
+        return false;
+    }
+
+    for (const auto& entry : cellFaces) {
+        layout.cells.push_back(entry.first);
+    }
+    std::sort(layout.cells.begin(), layout.cells.end());
+    for (int cell : layout.cells) {
+        layout.cellFaces.push_back(cellFaces[cell]);
+    }
+    return true;
+}
+
+bool buildChunkedMesh(const std::string& objPath, const std::string& directory, const ChunkedMeshOptions& options) {
+    TRACE_SCOPE("buildChunkedMesh");
+    std::error_code error;
+    fs::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Error creating directory " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+    // Chunk files are appended to, so clear out those of an earlier run
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("chunk_", 0) == 0 || name.rfind("result_", 0) == 0) {
+            fs::remove(entry.path());
+        }
+    }
+
+    ChunkedMeshLayout layout;
+    float boundsMax[3];
+    std::vector<size_t> edgeLengths;
+    if (!ingestOBJ(objPath, directory, layout, boundsMax) || !buildSoup(directory, options, layout, edgeLengths)) {
+        return false;
+    }
+
+    // A surface crosses about n^2 cells of an n^3 grid, so n is picked from
+    // the number of chunks wanted and the longest side
+    float extent[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        extent[axis] = layout.vertexCount > 0 ? boundsMax[axis] - layout.boundsMin[axis] : 0.0f;
+        if (layout.vertexCount == 0) {
+            layout.boundsMin[axis] = 0.0f;
+        }
+    }
+    float longest = std::max({extent[0], extent[1], extent[2], 1e-6f});
+    double chunksWanted = std::max(1.0, static_cast<double>(layout.faceCount) / std::max<size_t>(options.targetFacesPerChunk, 1));
+    int n = std::max(1, static_cast<int>(std::ceil(std::sqrt(chunksWanted))));
+    layout.cellSize = longest / n;
+    for (int axis = 0; axis < 3; ++axis) {
+        layout.grid[axis] = std::max(1, static_cast<int>(std::ceil(extent[axis] / layout.cellSize)));
+    }
+    layout.haloRings = std::max(options.haloRings, 0);
+
+    // The halo edge length leaves out the longest kLongEdgeFraction of the
+    // edges, and a halo never reaches further than the next cell
+    const size_t allowedLongEdges = static_cast<size_t>(kLongEdgeFraction * 3.0 * layout.faceCount);
+    size_t longer = 0;
+    size_t bin = kEdgeLengthBins;
+    while (bin > 0 && longer + edgeLengths[bin - 1] <= allowedLongEdges) {
+        longer += edgeLengths[--bin];
+    }
+    layout.haloEdgeLength = bin > 0 ? std::min(edgeLengthBinEnd(bin - 1), layout.maxEdgeLength) : 0.0f;
+    // A little slack so an edge of exactly the halo edge length stays inside
+    layout.haloWidth = std::min(layout.haloRings * layout.haloEdgeLength * 1.001f, layout.cellSize);
+    const float coveredEdge = layout.haloRings > 0 ? layout.haloWidth / layout.haloRings : INFINITY;
+    if (layout.maxEdgeLength > coveredEdge) {
+        for (size_t b = 0; b < kEdgeLengthBins; ++b) {
+            if (edgeLengthBinEnd(b) > coveredEdge) {
+                layout.longEdgeCount += edgeLengths[b];
+            }
+        }
+        std::cerr << "Warning: about " << layout.longEdgeCount << " edges are longer than the chunk halo covers ("
+                  << coveredEdge << ", the longest is " << layout.maxEdgeLength << "); within " << layout.haloRings
+                  << " rings of them, results at chunk borders may differ from processing in memory" << std::endl;
+    }
+
+    if (!distributeSoup(directory, options, layout)) {
+        return false;
+    }
+    fs::remove(filePath(directory, "soup.bin"));
+    fs::remove(filePath(directory, "faces.bin"));
+    return writeLayout(directory, layout);
+}
+
+// Function to smooth like laplacianSmoothing, but visiting the faces once
+// instead of once per vertex. Each vertex sums its neighbors in the same
+// order as laplacianSmoothing does, so the results are identical.
+static void smoothByFaces(VertexArray& vertices, const FaceArray& faces, float smoothingFactor) {
+    VertexArray sums(vertices.size(), {0, 0, 0});
+    std::vector<int> counts(vertices.size(), 0);
+    for (const Face& face : faces) {
+        const int corners[3] = {face.v1, face.v2, face.v3};
+        for (int k = 0; k < 3; ++k) {
+            int v = corners[k];
+            // A repeated corner counts the face once
+            if ((k > 0 && corners[0] == v) || (k > 1 && corners[1] == v)) {
+                continue;
+            }
+            for (int other : corners) {
+                if (other != v) {
+                    sums[v].x += vertices[other].x;
+                    sums[v].y += vertices[other].y;
+                    sums[v].z += vertices[other].z;
+                    counts[v]++;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        if (counts[i] > 0) {
+            Vertex sum = sums[i];
+            sum.x /= counts[i];
+            sum.y /= counts[i];
+            sum.z /= counts[i];
+            vertices[i].x += (sum.x - vertices[i].x) * smoothingFactor;
+            vertices[i].y += (sum.y - vertices[i].y) * smoothingFactor;
+            vertices[i].z += (sum.z - vertices[i].z) * smoothingFactor;
+        }
+    }
+}
+
+// Function to collapse the shortest edges between free vertices until
+// (1 - ratio) of the owned faces are gone. A vertex is free when it, its
+// neighbors and its faces all belong to this chunk and it is surrounded by
+// one closed fan, so no other chunk sees any face or position it changes.
+// Returns the faces left, with ownedFaces updated to match.
+static FaceArray decimateChunk(VertexArray& vertices, const FaceArray& faces, const std::vector<char>& ownedVertices,
+                               std::vector<char>& ownedFaces, float ratio) {
+    HalfEdgeMesh mesh = buildHalfEdgeMesh(vertices.size(), faces);
+    std::vector<int> faceCount(vertices.size(), 0);
+    size_t ownedFaceCount = 0;
+    for (size_t f = 0; f < faces.size(); ++f) {
+        faceCount[faces[f].v1]++;
+        faceCount[faces[f].v2]++;
+        faceCount[faces[f].v3]++;
+        ownedFaceCount += ownedFaces[f];
+    }
+
+    std::vector<char> free(vertices.size(), 0);
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        if (!ownedVertices[v] || mesh.vertexHalfEdge[v] < 0 || isBoundaryVertex(mesh, static_cast<int>(v))) {
+            continue;
+        }
+        bool ok = true;
+        int fan = 0;
+        forEachOutgoingHalfEdge(mesh, static_cast<int>(v), [&](int h) {
+            ok = ok && ownedFaces[mesh.face[h]] && ownedVertices[mesh.vertex[h]] &&
+                 !(mesh.flags[h] & kHalfEdgeNonManifold);
+            fan++;
+        });
+        free[v] = ok && fan == faceCount[v];
+    }
+
+    const size_t target = static_cast<size_t>((1.0f - ratio) * ownedFaceCount);
+    size_t removed = 0;
+    std::vector<std::pair<float, int>> candidates;
+    while (removed < target) {
+        candidates.clear();
+        for (size_t h = 0; h < mesh.next.size(); ++h) {
+            if (mesh.flags[h] & kHalfEdgeDeleted) {
+                continue;
+            }
+            int a = originVertex(mesh, static_cast<int>(h)), b = mesh.vertex[h];
+            if (a < b && free[a] && free[b]) {
+                float dx = vertices[a].x - vertices[b].x, dy = vertices[a].y - vertices[b].y, dz = vertices[a].z - vertices[b].z;
+                candidates.push_back({dx * dx + dy * dy + dz * dz, static_cast<int>(h)});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        size_t collapsed = 0;
+        for (const auto& candidate : candidates) {
+            int h = candidate.second;
+            if (removed >= target) {
+                break;
+            }
+            if (mesh.flags[h] & kHalfEdgeDeleted) {
+                continue;
+            }
+            int a = originVertex(mesh, h), b = mesh.vertex[h];
+            Vertex midpoint = {(vertices[a].x + vertices[b].x) * 0.5f, (vertices[a].y + vertices[b].y) * 0.5f,
+                               (vertices[a].z + vertices[b].z) * 0.5f};
+            if (collapseEdge(mesh, h)) {
+                vertices[b] = midpoint;
+                removed += 2;
+                collapsed++;
+            }
+        }
+        if (collapsed == 0) {
+            break;
+        }
+    }
+
+    FaceArray remaining;
+    std::vector<char> remainingOwned;
+    for (size_t f = 0; f < faces.size(); ++f) {
+        int h = mesh.faceHalfEdge[f];
+        if (h < 0) {
+            continue;
+        }
+        remaining.push_back({originVertex(mesh, h), mesh.vertex[h], mesh.vertex[mesh.next[h]]});
+        remainingOwned.push_back(ownedFaces[f]);
+    }
+    ownedFaces.swap(remainingOwned);
+    return remaining;
+}
+
+// Function to write the given vertices of a chunk at their global slots,
+// one write per run of consecutive global indices
+template <typename T, typename Allocator>
+static void writeOwned(std::fstream& file, const std::vector<int>& globalIds, const std::vector<char>& owned,
+                       const std::vector<T, Allocator>& values) {
+    size_t i = 0;
+    while (i < globalIds.size()) {
+        if (!owned[i]) {
+            ++i;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < globalIds.size() && owned[end] && globalIds[end] == globalIds[end - 1] + 1) {
+            ++end;
+        }
+        file.seekp(static_cast<std::streamoff>(globalIds[i] * sizeof(T)));
+        file.write(reinterpret_cast<const char*>(&values[i]), static_cast<std::streamsize>((end - i) * sizeof(T)));
+        i = end;
+    }
+}
+
+static bool processChunk(const std::string& directory, const ChunkedMeshLayout& layout, int cell,
+                         const ChunkProcessing& processing, std::fstream& positionFile, std::fstream& normalFile) {
+    TRACE_SCOPE("processChunk");
+    std::vector<SoupFace> soup;
+    if (!readRecords(chunkFile(directory, cell), soup)) {
+        return false;
+    }
+
+    // Number the chunk's vertices in global order
+    std::vector<int> globalIds;
+    globalIds.reserve(soup.size() * 3);
+    for (const SoupFace& face : soup) {
+        for (const SoupCorner& corner : face.corners) {
+            globalIds.push_back(corner.id);
+        }
+    }
+    std::sort(globalIds.begin(), globalIds.end());
+    globalIds.erase(std::unique(globalIds.begin(), globalIds.end()), globalIds.end());
+
+    VertexArray vertices(globalIds.size());
+    FaceArray faces(soup.size());
+    std::vector<char> ownedFaces(soup.size());
+    for (size_t f = 0; f < soup.size(); ++f) {
+        int local[3];
+        for (int k = 0; k < 3; ++k) {
+            const SoupCorner& corner = soup[f].corners[k];
+            local[k] = static_cast<int>(std::lower_bound(globalIds.begin(), globalIds.end(), corner.id) - globalIds.begin());
+            vertices[local[k]] = {corner.x, corner.y, corner.z};
+        }
+        faces[f] = {local[0], local[1], local[2]};
+        const SoupCorner& first = soup[f].corners[0];
+        ownedFaces[f] = cellOf(layout, first.x, first.y, first.z) == cell;
+    }
+    std::vector<char> ownedVertices(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        ownedVertices[v] = cellOf(layout, vertices[v].x, vertices[v].y, vertices[v].z) == cell;
+    }
+    soup = std::vector<SoupFace>();
+
+    for (int i = 0; i < processing.smoothingIterations; ++i) {
+        smoothByFaces(vertices, faces, processing.smoothingFactor);
+    }
+    if (processing.decimationRatio < 1.0f) {
+        faces = decimateChunk(vertices, faces, ownedVertices, ownedFaces, processing.decimationRatio);
+    }
+
+    writeOwned(positionFile, globalIds, ownedVertices, vertices);
+    if (processing.computeNormals) {
+        std::vector<Normal> normals;
+        calculateVertexNormals(vertices, faces, normals);
+        writeOwned(normalFile, globalIds, ownedVertices, normals);
+    }
+
+    FaceArray result;
+    for (size_t f = 0; f < faces.size(); ++f) {
+        if (ownedFaces[f]) {
+            result.push_back({globalIds[faces[f].v1], globalIds[faces[f].v2], globalIds[faces[f].v3]});
+        }
+    }
+    std::ofstream resultStream(resultFile(directory, cell), std::ios::binary | std::ios::trunc);
+    resultStream.write(reinterpret_cast<const char*>(result.data()), static_cast<std::streamsize>(result.size() * sizeof(Face)));
+    return resultStream && positionFile && (!processing.computeNormals || normalFile);
+}
+
+// Function to count the set bits of a word
+static uint32_t countBits(uint64_t bits) {
+#if defined(_MSC_VER)
+    return static_cast<uint32_t>(std::bitset<64>(bits).count());
+#else
+    return static_cast<uint32_t>(__builtin_popcountll(bits));
+#endif
+}
+
+// Function to write the processed mesh as OBJ, keeping only the vertices the
+// faces still use: a bit per vertex marks them, and a count per 64 vertices
+// turns a global index into its new one
+static bool writeChunkedOBJ(const std::string& directory, const ChunkedMeshLayout& layout, bool withNormals,
+                            const std::string& outputPath) {
+    TRACE_SCOPE("writeChunkedOBJ");
+    const size_t V = layout.vertexCount;
+    std::vector<uint64_t> used((V + 63) / 64, 0);
+    FaceArray faces;
+    for (int cell : layout.cells) {
+        if (!readRecords(resultFile(directory, cell), faces)) {
+            return false;
+        }
+        for (const Face& face : faces) {
+            for (int v : {face.v1, face.v2, face.v3}) {
+                used[v >> 6] |= uint64_t(1) << (v & 63);
+            }
+        }
+    }
+    std::vector<uint32_t> usedBefore(used.size() + 1, 0);
+    for (size_t i = 0; i < used.size(); ++i) {
+        usedBefore[i + 1] = usedBefore[i] + countBits(used[i]);
+    }
+    auto newIndex = [&](int v) {
+        uint64_t below = used[v >> 6] & ((uint64_t(1) << (v & 63)) - 1);
+        return usedBefore[v >> 6] + countBits(below) + 1;
+    };
+
+    FILE* out = std::fopen(outputPath.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Error opening file: " << outputPath << std::endl;
+        return false;
+    }
+    std::ifstream positionFile(filePath(directory, "positions.bin"), std::ios::binary);
+    std::ifstream normalFile(filePath(directory, "normals.bin"), std::ios::binary);
+    const size_t kBlockVertices = 1 << 16;
+    VertexArray positions;
+    std::vector<Normal> normals;
+    for (int pass = 0; pass < (withNormals ? 2 : 1); ++pass) {
+        for (size_t first = 0; first < V; first += kBlockVertices) {
+            size_t count = std::min(kBlockVertices, V - first);
+            if (pass == 0) {
+                positions.resize(count);
+                positionFile.read(reinterpret_cast<char*>(positions.data()), static_cast<std::streamsize>(count * sizeof(Vertex)));
+            } else {
+                normals.resize(count);
+                normalFile.read(reinterpret_cast<char*>(normals.data()), static_cast<std::streamsize>(count * sizeof(Normal)));
+            }
+            for (size_t i = 0; i < count; ++i) {
+                size_t v = first + i;
+                if (!(used[v >> 6] >> (v & 63) & 1)) {
+                    continue;
+                }
+                if (pass == 0) {
+                    // Undo the scale loadOBJ applied
+                    std::fprintf(out, "v %.9g %.9g %.9g\n", positions[i].x / kOBJScale, positions[i].y / kOBJScale,
+                                 positions[i].z / kOBJScale);
+                } else {
+                    std::fprintf(out, "vn %.6g %.6g %.6g\n", normals[i].x, normals[i].y, normals[i].z);
+                }
+            }
+        }
+    }
+    for (int cell : layout.cells) {
+        if (!readRecords(resultFile(directory, cell), faces)) {
+            std::fclose(out);
+            return false;
+        }
+        for (const Face& face : faces) {
+            uint32_t a = newIndex(face.v1), b = newIndex(face.v2), c = newIndex(face.v3);
+            if (withNormals) {
+                std::fprintf(out, "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c);
+            } else {
+                std::fprintf(out, "f %u %u %u\n", a, b, c);
+            }
+        }
+    }
+    bool ok = positionFile && (!withNormals || normalFile);
+    if (std::fclose(out) != 0 || !ok) {
+        std::cerr << "Error writing " << outputPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool processChunkedMesh(const std::string& directory, const ChunkProcessing& processing, const std::string& outputPath) {
+    TRACE_SCOPE("processChunkedMesh");
+    ChunkedMeshLayout layout;
+    if (!readChunkedMeshLayout(directory, layout)) {
+        return false;
+    }
+    int neededRings = std::max(processing.smoothingIterations - 1, 0) + (processing.computeNormals ? 1 : 0);
+    if (layout.haloRings < neededRings) {
+        std::cerr << "The chunks have a halo of " << layout.haloRings << " rings, but " << neededRings
+                  << " are needed for this processing" << std::endl;
+        return false;
+    }
+
+    // Vertices no chunk owns (unused ones) keep their input position
+    std::error_code error;
+    fs::copy_file(filePath(directory, "vertices.bin"), filePath(directory, "positions.bin"),
+                  fs::copy_options::overwrite_existing, error);
+    if (!error && processing.computeNormals) {
+        std::ofstream(filePath(directory, "normals.bin"), std::ios::binary | std::ios::trunc).close();
+        fs::resize_file(filePath(directory, "normals.bin"), layout.vertexCount * sizeof(Normal), error);
+    }
+    if (error) {
+        std::cerr << "Error preparing output files in " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    // Each worker pulls the next chunk until none are left; with several in
+    // flight, one worker's reads and writes overlap the others' compute
+    unsigned int workers = processing.chunksInFlight ? processing.chunksInFlight : parallelThreadCount();
+    workers = std::max(1u, std::min<unsigned int>(workers, static_cast<unsigned int>(layout.cells.size())));
+    std::atomic<size_t> nextChunk{0};
+    std::atomic<bool> failed{false};
+    TaskGroup group;
+    for (unsigned int w = 0; w < workers; ++w) {
+        runTask(group, [&]() {
+            std::fstream positionFile(filePath(directory, "positions.bin"), std::ios::binary | std::ios::in | std::ios::out);
+            std::fstream normalFile;
+            if (processing.computeNormals) {
+                normalFile.open(filePath(directory, "normals.bin"), std::ios::binary | std::ios::in | std::ios::out);
+            }
+            for (;;) {
+                size_t i = nextChunk.fetch_add(1);
+                if (i >= layout.cells.size() || failed.load()) {
+                    return;
+                }
+                if (!processChunk(directory, layout, layout.cells[i], processing, positionFile, normalFile)) {
+                    std::cerr << "Error processing chunk " << layout.cells[i] << std::endl;
+                    failed = true;
+                }
+            }
+        });
+    }
+    waitTaskGroup(group);
+    if (failed) {
+        return false;
+    }
+    return writeChunkedOBJ(directory, layout, processing.computeNormals, outputPath);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Processing of meshes too large for memory. The OBJ file is converted once
+// into a directory of spatial chunks: a grid of cubic cells, where each cell
+// holds every face with a corner in the cell or within the halo width of it.
+// The halo is a number of rings of a long edge (one that all but 1 in 10,000
+// edges are shorter than), capped at the cell size, so a chunk holds the full
+// neighborhood its own vertices need for that many smoothing steps, except
+// next to the few longer edges. A single long edge therefore cannot make
+// every chunk take in most of the mesh.
+// Chunks are then processed on their own, a few at a time, and every chunk
+// writes back only what it owns: the vertices inside its cell and the faces
+// whose first corner is inside it.
+//
+// Every pass streams its files, so memory is bounded by memoryBudget and the
+// largest chunks in flight, except for the final OBJ writer, which keeps 1.5
+// bits per vertex to drop the vertices decimation removed.
+
+struct ChunkedMeshOptions {
+    // Approximate number of faces owned by one chunk
+    size_t targetFacesPerChunk = 1 << 20;
+    // Rings of the halo edge length around each cell stored with its chunk
+    int haloRings = 2;
+    // Memory used for vertex positions and write buffers while converting
+    size_t memoryBudget = size_t(1) << 30;
+};
+
+// Grid and statistics of a chunked mesh directory, as written to layout.txt
+struct ChunkedMeshLayout {
+    size_t vertexCount = 0;
+    size_t faceCount = 0;
+    float boundsMin[3] = {0, 0, 0};
+    float cellSize = 1.0f;
+    int grid[3] = {1, 1, 1};
+    int haloRings = 0;
+    float haloWidth = 0.0f;
+    float maxEdgeLength = 0.0f;
+    // Edge length the halo is measured in, and the edges longer than it
+    float haloEdgeLength = 0.0f;
+    size_t longEdgeCount = 0;
+    // Occupied cells, with the number of faces stored for each (halo included)
+    std::vector<int> cells;
+    std::vector<size_t> cellFaces;
+};
+
+struct ChunkProcessing {
+    // Laplacian smoothing steps, identical to laplacianSmoothing on the whole
+    // mesh; needs haloRings >= smoothingIterations - 1, plus one for normals
+    int smoothingIterations = 0;
+    float smoothingFactor = 0.5f;
+    // Fraction of faces to keep by collapsing the shortest edges (1 keeps
+    // all). Only edges deep inside a chunk are collapsed, so the seams
+    // between chunks keep their full resolution.
+    float decimationRatio = 1.0f;
+    bool computeNormals = true;
+    // Chunks loaded at the same time (0 means one per thread). While one
+    // chunk is read or written, the others compute.
+    unsigned int chunksInFlight = 0;
+};
+
+// Function to convert an OBJ file into a chunked mesh directory, in four
+// streaming passes: the OBJ into raw vertex and face files, the faces into a
+// triangle soup with their corner positions (one pass per window of vertices
+// that fits the budget), then the soup into one file per occupied cell
+bool buildChunkedMesh(const std::string& objPath, const std::string& directory, const ChunkedMeshOptions& options);
+
+// Function to read layout.txt of a chunked mesh directory
+bool readChunkedMeshLayout(const std::string& directory, ChunkedMeshLayout& layout);
+
+// Function to process every chunk in parallel, write the results back into
+// the directory as each chunk finishes and then write them out as an OBJ file
+bool processChunkedMesh(const std::string& directory, const ChunkProcessing& processing, const std::string& outputPath);
@@ -0,0 +1,464 @@
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct Task {
+    std::function<void()> fn;
+    TaskGroup* group;
+    // Set instead of fn for the upper half of a parallelFor range
+    const RangeFunction* rangeFn;
+    size_t begin, end, grain;
+};
+
+// Power-of-two ring of task pointers, indexed by the deque's unbounded counters
+struct TaskArray {
+    explicit TaskArray(int64_t capacity) : mask(capacity - 1), slots(new std::atomic<Task*>[capacity]) {}
+
+    int64_t capacity() const { return mask + 1; }
+    Task* get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+    void put(int64_t i, Task* task) { slots[i & mask].store(task, std::memory_order_relaxed); }
+
+    int64_t mask;
+    std::unique_ptr<std::atomic<Task*>[]> slots;
+};
+
+// Chase-Lev deque, in the C11 formulation of Le, Pop, Cohen and Zappa Nardelli.
+// The owner pushes and pops at the bottom; thieves take from the top, so they
+// get the oldest (and, for split ranges, the largest) tasks.
+struct WorkDeque {
+    std::atomic<int64_t> top{0};
+    std::atomic<int64_t> bottom{0};
+    std::atomic<TaskArray*> array{nullptr};
+    // Outgrown arrays stay alive until the pool shuts down, since a thief may still be reading one
+    std::vector<std::unique_ptr<TaskArray>> arrays;
+
+    WorkDeque() {
+        arrays.emplace_back(new TaskArray(256));
+        array.store(arrays.back().get(), std::memory_order_relaxed);
+    }
+};
+
+static void pushBottom(WorkDeque& deque, Task* task) {
+    int64_t b = deque.bottom.load(std::memory_order_relaxed);
+    int64_t t = deque.top.load(std::memory_order_acquire);
+    TaskArray* array = deque.array.load(std::memory_order_relaxed);
+    if (b - t > array->capacity() - 1) {
+        TaskArray* grown = new TaskArray(array->capacity() * 2);
+        for (int64_t i = t; i < b; ++i) {
+            grown->put(i, array->get(i));
+        }
+        deque.arrays.emplace_back(grown);
+        deque.array.store(grown, std::memory_order_release);
+        array = grown;
+    }
+    array->put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);
+    deque.bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+static Task* popBottom(WorkDeque& deque) {
+    int64_t b = deque.bottom.load(std::memory_order_relaxed) - 1;
+    TaskArray* array = deque.array.load(std::memory_order_relaxed);
+    deque.bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = deque.top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // Empty
+        deque.bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Task* task = array->get(b);
+    if (t == b) {
+        // Last task: race the thieves for it
+        if (!deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;
+        }
+        deque.bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+static Task* stealTop(WorkDeque& deque) {
+    int64_t t = deque.top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = deque.bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return nullptr;
+    }
+    TaskArray* array = deque.array.load(std::memory_order_acquire);
+    Task* task = array->get(t);
+    if (!deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        // Lost the race to another thief or the owner
+        return nullptr;
+    }
+    return task;
+}
+
+struct Scheduler {
+    unsigned int threadCount = 1;
+    bool pinning = false;
+    std::vector<std::unique_ptr<WorkDeque>> deques; // one per worker
+    std::vector<std::thread> workers;
+
+    // Tasks pushed by threads outside the pool
+    std::mutex sharedMutex;
+    std::deque<Task*> shared;
+    std::atomic<size_t> sharedCount{0};
+
+    // Idle workers sleep until the epoch moves, which every push does
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<int> sleepers{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<bool> stopping{false};
+};
+
+static thread_local WorkDeque* currentDeque = nullptr;
+static thread_local uint32_t stealSeed = 0x9e3779b9u;
+
+// Finished tasks, kept by the thread that ran them for its next spawns, so
+// steady parallel work does not allocate
+struct TaskFreeList {
+    std::vector<Task*> tasks;
+
+    ~TaskFreeList() {
+        for (Task* task : tasks) {
+            delete task;
+        }
+    }
+};
+static thread_local TaskFreeList freeTasks;
+
+static Task* allocateTask(TaskGroup& group) {
+    Task* task;
+    if (freeTasks.tasks.empty()) {
+        task = new Task();
+    } else {
+        task = freeTasks.tasks.back();
+        freeTasks.tasks.pop_back();
+    }
+    task->group = &group;
+    task->rangeFn = nullptr;
+    return task;
+}
+
+static std::mutex configMutex;
+static unsigned int configuredThreadCount = 0;
+static bool configuredPinning = false;
+static std::unique_ptr<Scheduler> schedulerInstance;
+static std::atomic<Scheduler*> schedulerPointer{nullptr};
+
+static Task* findTask(Scheduler& scheduler) {
+    if (currentDeque) {
+        if (Task* task = popBottom(*currentDeque)) {
+            return task;
+        }
+    }
+    if (scheduler.sharedCount.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(scheduler.sharedMutex);
+        if (!scheduler.shared.empty()) {
+            Task* task = scheduler.shared.front();
+            scheduler.shared.pop_front();
+            scheduler.sharedCount.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+
+    // Try every other deque once, starting at a random victim
+    size_t dequeCount = scheduler.deques.size();
+    if (dequeCount == 0) {
+        return nullptr;
+    }
+    stealSeed ^= stealSeed << 13;
+    stealSeed ^= stealSeed >> 17;
+    stealSeed ^= stealSeed << 5;
+    size_t start = stealSeed % dequeCount;
+    for (size_t k = 0; k < dequeCount; ++k) {
+        WorkDeque& victim = *scheduler.deques[(start + k) % dequeCount];
+        if (&victim == currentDeque) {
+            continue;
+        }
+        if (Task* task = stealTop(victim)) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+static void splitRange(TaskGroup& group, size_t begin, size_t end, size_t grain,
+                       const RangeFunction& fn);
+
+static void executeTask(Task* task) {
+    if (task->rangeFn) {
+        splitRange(*task->group, task->begin, task->end, task->grain, *task->rangeFn);
+    } else {
+        task->fn();
+        task->fn = nullptr;
+    }
+    TaskGroup* group = task->group;
+    if (freeTasks.tasks.size() < 1024) {
+        freeTasks.tasks.push_back(task);
+    } else {
+        delete task;
+    }
+    group->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+static void pinCurrentThread(unsigned int cpu) {
+#if defined(__linux__)
+    unsigned int cpuCount = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % cpuCount, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+static void workerLoop(Scheduler& scheduler, unsigned int index) {
+    setTraceThreadName("pool worker");
+    currentDeque = scheduler.deques[index].get();
+    stealSeed = 0x9e3779b9u * (index + 1);
+    if (scheduler.pinning) {
+        // CPU 0 is left to the thread that created the pool
+        pinCurrentThread(index + 1);
+    }
+
+    int idleRounds = 0;
+    while (!scheduler.stopping.load(std::memory_order_acquire)) {
+        uint64_t epoch = scheduler.epoch.load();
+        if (Task* task = findTask(scheduler)) {
+            executeTask(task);
+            idleRounds = 0;
+            continue;
+        }
+        if (++idleRounds < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Nothing was pushed since the epoch was read, so nothing can be missed by sleeping
+        scheduler.sleepers.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(scheduler.sleepMutex);
+            scheduler.sleepCondition.wait(lock, [&]() {
+                return scheduler.epoch.load() != epoch || scheduler.stopping.load();
+            });
+        }
+        scheduler.sleepers.fetch_sub(1);
+        idleRounds = 0;
+    }
+}
+
+static unsigned int defaultThreadCount() {
+    if (const char* value = std::getenv("MESH_THREADS")) {
+        int count = std::atoi(value);
+        if (count > 0) {
+            return static_cast<unsigned int>(count);
+        }
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+static void shutDownScheduler() {
+    if (!schedulerInstance) {
+        return;
+    }
+    Scheduler& scheduler = *schedulerInstance;
+    {
+        std::lock_guard<std::mutex> lock(scheduler.sleepMutex);
+        scheduler.stopping = true;
+        scheduler.epoch.fetch_add(1);
+    }
+    scheduler.sleepCondition.notify_all();
+    for (auto& worker : scheduler.workers) {
+        worker.join();
+    }
+    schedulerPointer.store(nullptr, std::memory_order_release);
+    schedulerInstance.reset();
+}
+
+// Joins the workers when the program exits
+struct SchedulerShutdown {
+    ~SchedulerShutdown() {
+        std::lock_guard<std::mutex> lock(configMutex);
+        shutDownScheduler();
+    }
+};
+static SchedulerShutdown schedulerShutdown;
+
+static Scheduler& getScheduler() {
+    Scheduler* scheduler = schedulerPointer.load(std::memory_order_acquire);
+    if (scheduler) {
+        return *scheduler;
+    }
+
+    std::lock_guard<std::mutex> lock(configMutex);
+    if (!schedulerInstance) {
+        schedulerInstance.reset(new Scheduler());
+        Scheduler& created = *schedulerInstance;
+        created.threadCount = configuredThreadCount ? configuredThreadCount : defaultThreadCount();
+        created.pinning = configuredPinning;
+        for (unsigned int i = 0; i + 1 < created.threadCount; ++i) {
+            created.deques.emplace_back(new WorkDeque());
+        }
+        for (unsigned int i = 0; i + 1 < created.threadCount; ++i) {
+            created.workers.emplace_back(workerLoop, std::ref(created), i);
+        }
+        schedulerPointer.store(&created, std::memory_order_release);
+    }
+    return *schedulerInstance;
+}
+
+unsigned int parallelThreadCount() {
+    return getScheduler().threadCount;
+}
+
+void setParallelThreadCount(unsigned int count) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    configuredThreadCount = count;
+    shutDownScheduler();
+}
+
+void setParallelCpuPinning(bool enabled) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    configuredPinning = enabled;
+    shutDownScheduler();
+}
+
+// Function to queue a task on the calling thread's deque, or on the shared
+// queue when called from outside the pool
+static void submitTask(Task* task) {
+    Scheduler& scheduler = getScheduler();
+    task->group->pending.fetch_add(1, std::memory_order_relaxed);
+    if (currentDeque) {
+        pushBottom(*currentDeque, task);
+    } else {
+        std::lock_guard<std::mutex> lock(scheduler.sharedMutex);
+        scheduler.shared.push_back(task);
+        scheduler.sharedCount.fetch_add(1, std::memory_order_release);
+    }
+
+    scheduler.epoch.fetch_add(1);
+    if (scheduler.sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(scheduler.sleepMutex);
+        scheduler.sleepCondition.notify_one();
+    }
+}
+
+void runTask(TaskGroup& group, std::function<void()> fn) {
+    Task* task = allocateTask(group);
+    task->fn = std::move(fn);
+    submitTask(task);
+}
+
+void waitTaskGroup(TaskGroup& group) {
+    Scheduler& scheduler = getScheduler();
+    while (group.pending.load(std::memory_order_acquire) != 0) {
+        if (Task* task = findTask(scheduler)) {
+            executeTask(task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Function to split [begin, end) in halves, queueing the upper halves, and run what is left
+static void splitRange(TaskGroup& group, size_t begin, size_t end, size_t grain,
+                       const RangeFunction& fn) {
+    while (end - begin >= 2 * grain) {
+        size_t mid = begin + (end - begin) / 2;
+        Task* task = allocateTask(group);
+        task->rangeFn = &fn;
+        task->begin = mid;
+        task->end = end;
+        task->grain = grain;
+        submitTask(task);
+        end = mid;
+    }
+    fn(begin, end);
+}
+
+void parallelFor(size_t count, size_t minGrain, const RangeFunction& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    size_t grain = std::max<size_t>(minGrain, 1);
+    unsigned int threads = parallelThreadCount();
+    if (threads <= 1 || count < 2 * grain) {
+        fn(0, count);
+        return;
+    }
+
+    // About eight ranges per thread: enough to balance, few enough to keep the task overhead small
+    grain = std::max<size_t>(grain, count / (static_cast<size_t>(threads) * 8));
+    TaskGroup group;
+    splitRange(group, 0, count, grain, fn);
+    waitTaskGroup(group);
+}
+
+void parallelInvoke(const std::function<void()>& first, const std::function<void()>& second) {
+    if (parallelThreadCount() <= 1) {
+        first();
+        second();
+        return;
+    }
+
+    // The caller runs the second task and, unless a thief took it, the first one too
+    TaskGroup group;
+    runTask(group, [&first]() { first(); });
+    second();
+    waitTaskGroup(group);
+}
+
+SchedulerBenchmark benchmarkScheduler(size_t taskCount) {
+    SchedulerBenchmark benchmark;
+    benchmark.threadCount = parallelThreadCount();
+    taskCount = std::max<size_t>(taskCount, 1);
+    std::atomic<size_t> counter(0);
+
+    // Spawn from inside the pool, as nested kernels do
+    auto start = std::chrono::steady_clock::now();
+    TaskGroup root;
+    runTask(root, [&]() {
+        TaskGroup group;
+        for (size_t i = 0; i < taskCount; ++i) {
+            runTask(group, [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+        }
+        waitTaskGroup(group);
+    });
+    waitTaskGroup(root);
+    double spawnSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Fork and join of a parallelFor split into single items
+    size_t rangeCount = static_cast<size_t>(benchmark.threadCount) * 8;
+    size_t callCount = std::max<size_t>(taskCount / rangeCount, 1);
+    start = std::chrono::steady_clock::now();
+    for (size_t call = 0; call < callCount; ++call) {
+        parallelFor(rangeCount, 1, [&counter](size_t begin, size_t end) {
+            counter.fetch_add(end - begin, std::memory_order_relaxed);
+        });
+    }
+    double forSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    benchmark.spawnNanoseconds = spawnSeconds * 1e9 / taskCount;
+    benchmark.parallelForNanoseconds = forSeconds * 1e9 / (callCount * rangeCount);
+    benchmark.tasksPerSecond = taskCount / spawnSeconds;
+    return benchmark;
+}
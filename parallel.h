@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+// All parallel work runs on one shared work-stealing scheduler: a pool of
+// worker threads, each with its own Chase-Lev deque. Threads push and pop
+// tasks at the bottom of their own deque and steal from the top of the
+// others' when they run dry. Threads outside the pool (the render loop, job
+// workers) hand their tasks to a shared queue and help run tasks while they
+// wait, so nested parallel calls never block a core.
+
+// Number of threads the parallel helpers split work across, counting the caller
+unsigned int parallelThreadCount();
+
+// Function to choose the thread count (0 means one per hardware thread; the
+// MESH_THREADS environment variable is used if this is never called). Call
+// it before any parallel work; it restarts the pool.
+void setParallelThreadCount(unsigned int count);
+
+// Function to pin pool worker i to CPU i + 1, leaving CPU 0 to the thread
+// that starts the pool (Linux only; a no-op elsewhere).
+// Call it before any parallel work; it restarts the pool.
+void setParallelCpuPinning(bool enabled);
+
+// Non-owning reference to a callable taking a range. parallelFor waits for
+// its ranges, so it can refer to the caller's lambda instead of copying it
+// into a std::function, which would allocate for larger captures.
+class RangeFunction {
+public:
+    template <typename Fn>
+    RangeFunction(const Fn& fn)
+        : object(&fn), call([](const void* target, size_t begin, size_t end) { (*static_cast<const Fn*>(target))(begin, end); }) {}
+
+    void operator()(size_t begin, size_t end) const { call(object, begin, end); }
+
+private:
+    const void* object;
+    void (*call)(const void*, size_t, size_t);
+};
+
+// Function to run fn(begin, end) over contiguous sub-ranges of [0, count).
+// Ranges are never smaller than minGrain items, so small inputs run inline
+// on the calling thread. Larger inputs are split in halves, as stealable
+// tasks, down to a grain that adapts to the input size: about eight ranges
+// per thread, so idle threads can balance uneven work.
+void parallelFor(size_t count, size_t minGrain, const RangeFunction& fn);
+
+// Function to run two independent tasks, possibly concurrently, and wait for both
+void parallelInvoke(const std::function<void()>& first, const std::function<void()>& second);
+
+// A set of tasks to wait for together. The group must outlive its tasks.
+struct TaskGroup {
+    std::atomic<size_t> pending{0};
+};
+
+// Function to queue fn as a task of the group
+void runTask(TaskGroup& group, std::function<void()> fn);
+
+// Function to wait until every task of the group has finished, running
+// queued tasks in the meantime
+void waitTaskGroup(TaskGroup& group);
+
+struct SchedulerBenchmark {
+    unsigned int threadCount;
+    double spawnNanoseconds;       // per empty task spawned and waited for from one thread
+    double parallelForNanoseconds; // per single-item range of a parallelFor with grain 1
+    double tasksPerSecond;
+};
+
+// Function to measure the cost of scheduling taskCount empty tasks
+SchedulerBenchmark benchmarkScheduler(size_t taskCount = 1 << 20);
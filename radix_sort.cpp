@@ -0,0 +1,127 @@
+#include "radix_sort.h"
+#include "parallel.h"
+#include <algorithm>
+
+// Shared implementation; values may be null when only keys are sorted
+static void radixSortImpl(std::vector<uint64_t>& keys, std::vector<uint32_t>* values, int firstBit, int lastBit) {
+    const size_t count = keys.size();
+    if (count < 2 || firstBit >= lastBit) {
+        return;
+    }
+
+    // Small inputs are faster with a comparison sort on the masked keys
+    if (count < 4096) {
+        uint64_t mask = (lastBit - firstBit >= 64) ? ~0ull : (((1ull << (lastBit - firstBit)) - 1) << firstBit);
+        if (!values) {
+            std::stable_sort(keys.begin(), keys.end(), [mask](uint64_t a, uint64_t b) { return (a & mask) < (b & mask); });
+            return;
+        }
+        std::vector<uint32_t> order(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = static_cast<uint32_t>(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return (keys[a] & mask) < (keys[b] & mask); });
+        std::vector<uint64_t> sortedKeys(count);
+        std::vector<uint32_t> sortedValues(count);
+        for (size_t i = 0; i < count; ++i) {
+            sortedKeys[i] = keys[order[i]];
+            sortedValues[i] = (*values)[order[i]];
+        }
+        keys.swap(sortedKeys);
+        values->swap(sortedValues);
+        return;
+    }
+
+    const size_t grain = 1 << 16;
+    const size_t blockCount = std::min<size_t>(parallelThreadCount() * 4, (count + grain - 1) / grain);
+    const size_t blockSize = (count + blockCount - 1) / blockCount;
+
+    std::vector<uint64_t> scratch(count);
+    std::vector<size_t> histograms(blockCount * 256);
+    uint64_t* src = keys.data();
+    uint64_t* dst = scratch.data();
+    std::vector<uint32_t> valueScratch(values ? count : 0);
+    uint32_t* valueSrc = values ? values->data() : nullptr;
+    uint32_t* valueDst = values ? valueScratch.data() : nullptr;
+
+    for (int shift = firstBit; shift < lastBit; shift += 8) {
+        int bits = std::min(8, lastBit - shift);
+        uint64_t digitMask = (1ull << bits) - 1;
+
+        // Per-block digit histograms
+        std::fill(histograms.begin(), histograms.end(), 0);
+        parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t* histogram = &histograms[b * 256];
+                size_t first = b * blockSize;
+                size_t last = std::min(count, first + blockSize);
+                for (size_t i = first; i < last; ++i) {
+                    histogram[(src[i] >> shift) & digitMask]++;
+                }
+            }
+        });
+
+        // Skip passes where every key has the same digit
+        bool trivial = false;
+        for (size_t digit = 0; digit < 256 && !trivial; ++digit) {
+            size_t total = 0;
+            for (size_t b = 0; b < blockCount; ++b) {
+                total += histograms[b * 256 + digit];
+            }
+            if (total == count) {
+                trivial = true;
+            } else if (total != 0) {
+                break;
+            }
+        }
+        if (trivial) {
+            continue;
+        }
+
+        // Exclusive prefix over (digit, block) gives every block its scatter offsets
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; ++digit) {
+            for (size_t b = 0; b < blockCount; ++b) {
+                size_t value = histograms[b * 256 + digit];
+                histograms[b * 256 + digit] = offset;
+                offset += value;
+            }
+        }
+
+        parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t* offsets = &histograms[b * 256];
+                size_t first = b * blockSize;
+                size_t last = std::min(count, first + blockSize);
+                if (valueSrc) {
+                    for (size_t i = first; i < last; ++i) {
+                        size_t slot = offsets[(src[i] >> shift) & digitMask]++;
+                        dst[slot] = src[i];
+                        valueDst[slot] = valueSrc[i];
+                    }
+                } else {
+                    for (size_t i = first; i < last; ++i) {
+                        dst[offsets[(src[i] >> shift) & digitMask]++] = src[i];
+                    }
+                }
+            }
+        });
+        std::swap(src, dst);
+        std::swap(valueSrc, valueDst);
+    }
+
+    if (src != keys.data()) {
+        std::copy(src, src + count, keys.data());
+        if (values) {
+            std::copy(valueSrc, valueSrc + count, values->data());
+        }
+    }
+}
+
+void radixSort64(std::vector<uint64_t>& keys, int firstBit, int lastBit) {
+    radixSortImpl(keys, nullptr, firstBit, lastBit);
+}
+
+void radixSortPairs64(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, int firstBit, int lastBit) {
+    radixSortImpl(keys, &values, firstBit, lastBit);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Function to sort 64-bit keys in ascending order with a parallel LSD radix sort.
+// Only bits [firstBit, lastBit) take part in the ordering; the sort is stable,
+// so keys that compare equal on those bits keep their relative order.
+void radixSort64(std::vector<uint64_t>& keys, int firstBit = 0, int lastBit = 64);
+
+// Function to sort keys as above while permuting values alongside them
+void radixSortPairs64(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, int firstBit = 0, int lastBit = 64);
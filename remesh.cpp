@@ -0,0 +1,400 @@
+#include "remesh.h"
+#include "bvh.h"
+#include "halfedge.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+// Rounds per batch pass before the remaining candidates are left for the next iteration
+const int kMaxBatchRounds = 64;
+
+static glm::vec3 position(const Vertex& v) {
+    return glm::vec3(v.x, v.y, v.z);
+}
+
+static Vertex toVertex(const glm::vec3& p) {
+    return {p.x, p.y, p.z};
+}
+
+static uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Function to list the live half-edges that own their edge and pass the
+// predicate, in index order, using one output list per fixed-size block
+template <typename Predicate>
+static std::vector<int> collectEdges(const HalfEdgeMesh& mesh, Predicate predicate) {
+    const size_t halfEdgeCount = mesh.next.size();
+    const size_t grain = 1 << 16;
+    const size_t blockCount = (halfEdgeCount + grain - 1) / grain;
+    std::vector<std::vector<int>> blocks(blockCount);
+    parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            for (size_t i = b * grain; i < std::min(halfEdgeCount, (b + 1) * grain); ++i) {
+                int h = static_cast<int>(i);
+                int t = mesh.twin[h];
+                if ((mesh.flags[h] & (kHalfEdgeDeleted | kHalfEdgeNonManifold)) || (t >= 0 && t < h)) {
+                    continue;
+                }
+                if (predicate(h)) {
+                    blocks[b].push_back(h);
+                }
+            }
+        }
+    });
+
+    std::vector<int> edges;
+    for (const auto& block : blocks) {
+        edges.insert(edges.end(), block.begin(), block.end());
+    }
+    return edges;
+}
+
+// Function to run an operation on candidate half-edges in rounds of
+// conflict-free batches. region(h, out) appends every vertex whose fan the
+// operation reads or whose half-edges it changes; stillValid(h) re-checks a
+// candidate after earlier rounds changed the mesh; prepare(count) runs
+// serially before each batch; apply(h, rank) runs the winners in parallel.
+// Returns how many operations were applied.
+template <typename StillValid, typename Region, typename Prepare, typename Apply>
+static size_t runConflictFreeBatches(std::vector<int> candidates, size_t vertexCapacity, StillValid stillValid,
+                                     Region region, Prepare prepare, Apply apply) {
+    std::unique_ptr<std::atomic<uint64_t>[]> owner(new std::atomic<uint64_t>[vertexCapacity]);
+    parallelFor(vertexCapacity, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            owner[v].store(0, std::memory_order_relaxed);
+        }
+    });
+
+    size_t applied = 0;
+    std::vector<unsigned char> keep;
+    std::vector<int> winners, losers;
+    for (uint32_t round = 0; round < kMaxBatchRounds && !candidates.empty(); ++round) {
+        // Drop candidates that earlier rounds invalidated
+        keep.assign(candidates.size(), 0);
+        parallelFor(candidates.size(), 1 << 12, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                keep[i] = stillValid(candidates[i]) ? 1 : 0;
+            }
+        });
+        size_t kept = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (keep[i]) {
+                candidates[kept++] = candidates[i];
+            }
+        }
+        candidates.resize(kept);
+        if (candidates.empty()) {
+            break;
+        }
+
+        // Random priorities, made unique by the candidate's position
+        auto priority = [&](size_t i) {
+            uint64_t random = hash32(static_cast<uint32_t>(candidates[i]) ^ hash32(round + 1));
+            return (random << 32) | static_cast<uint64_t>(i + 1);
+        };
+
+        // Claim: every vertex keeps the highest priority that wants it
+        parallelFor(candidates.size(), 1 << 12, [&](size_t begin, size_t end) {
+            std::vector<int> touched;
+            for (size_t i = begin; i < end; ++i) {
+                touched.clear();
+                region(candidates[i], touched);
+                uint64_t p = priority(i);
+                for (int v : touched) {
+                    uint64_t current = owner[v].load(std::memory_order_relaxed);
+                    while (current < p && !owner[v].compare_exchange_weak(current, p, std::memory_order_relaxed)) {
+                    }
+                }
+            }
+        });
+
+        // Verify: a candidate wins if it holds all of its vertices
+        parallelFor(candidates.size(), 1 << 12, [&](size_t begin, size_t end) {
+            std::vector<int> touched;
+            for (size_t i = begin; i < end; ++i) {
+                touched.clear();
+                region(candidates[i], touched);
+                uint64_t p = priority(i);
+                bool wins = true;
+                for (int v : touched) {
+                    wins = wins && owner[v].load(std::memory_order_relaxed) == p;
+                }
+                keep[i] = wins ? 1 : 0;
+            }
+        });
+
+        parallelFor(candidates.size(), 1 << 12, [&](size_t begin, size_t end) {
+            std::vector<int> touched;
+            for (size_t i = begin; i < end; ++i) {
+                touched.clear();
+                region(candidates[i], touched);
+                for (int v : touched) {
+                    owner[v].store(0, std::memory_order_relaxed);
+                }
+            }
+        });
+
+        winners.clear();
+        losers.clear();
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            (keep[i] ? winners : losers).push_back(candidates[i]);
+        }
+
+        prepare(winners.size());
+        parallelFor(winners.size(), 1 << 10, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                apply(winners[k], k);
+            }
+        });
+        applied += winners.size();
+        candidates.swap(losers);
+    }
+    return applied;
+}
+
+static int targetValence(const HalfEdgeMesh& mesh, int v) {
+    return isBoundaryVertex(mesh, v) ? 4 : 6;
+}
+
+static float edgeLengthSquared(const HalfEdgeMesh& mesh, const VertexArray& positions, int h) {
+    glm::vec3 d = position(positions[mesh.vertex[h]]) - position(positions[originVertex(mesh, h)]);
+    return glm::dot(d, d);
+}
+
+// Function to append the two endpoints and the opposite corners of h's edge
+static void edgeDiamond(const HalfEdgeMesh& mesh, int h, std::vector<int>& out) {
+    out.push_back(originVertex(mesh, h));
+    out.push_back(mesh.vertex[h]);
+    out.push_back(mesh.vertex[mesh.next[h]]);
+    int t = mesh.twin[h];
+    if (t >= 0) {
+        out.push_back(mesh.vertex[mesh.next[t]]);
+    }
+}
+
+// Function to pick which end of h's edge to merge into the other: returns the
+// half-edge to collapse, or -1 if neither direction keeps the mesh valid,
+// moves the boundary, creates edges above maxLengthSquared or flips a face
+static int chooseCollapse(const HalfEdgeMesh& mesh, const VertexArray& positions, int h, float maxLengthSquared) {
+    const int options[2] = {h, mesh.twin[h]};
+    for (int option : options) {
+        if (option < 0) {
+            continue;
+        }
+        int a = originVertex(mesh, option), b = mesh.vertex[option];
+        if (isBoundaryVertex(mesh, a) && !isBoundaryHalfEdge(mesh, option) && !isBoundaryHalfEdge(mesh, mesh.twin[option])) {
+            continue;
+        }
+        if (isBoundaryVertex(mesh, a) && !isBoundaryVertex(mesh, b)) {
+            continue;
+        }
+        if (!canCollapseEdge(mesh, option)) {
+            continue;
+        }
+
+        glm::vec3 pb = position(positions[b]);
+        bool ok = true;
+        forEachOutgoingHalfEdge(mesh, a, [&](int g) {
+            int c = mesh.vertex[g], d = mesh.vertex[mesh.next[g]];
+            glm::vec3 pc = position(positions[c]);
+            glm::vec3 offset = pc - pb;
+            if (glm::dot(offset, offset) > maxLengthSquared) {
+                ok = false;
+            }
+            if (c == b || d == b) {
+                return;
+            }
+            // Face (a, c, d) becomes (b, c, d); its normal must not turn over
+            glm::vec3 pa = position(positions[a]), pd = position(positions[d]);
+            glm::vec3 before = glm::cross(pc - pa, pd - pa);
+            glm::vec3 after = glm::cross(pc - pb, pd - pb);
+            if (glm::dot(before, after) <= 0.0f) {
+                ok = false;
+            }
+        });
+        if (ok) {
+            return option;
+        }
+    }
+    return -1;
+}
+
+// Function to test whether flipping h's edge lowers the valence deviation
+// without folding a face, given the current valence of every vertex
+static bool flipImproves(const HalfEdgeMesh& mesh, const VertexArray& positions, const std::vector<int>& valence, int h) {
+    int t = mesh.twin[h];
+    if (t < 0 || (mesh.flags[h] & (kHalfEdgeDeleted | kHalfEdgeNonManifold))) {
+        return false;
+    }
+    int a = originVertex(mesh, h), b = mesh.vertex[h];
+    int c = mesh.vertex[mesh.next[h]], d = mesh.vertex[mesh.next[t]];
+    if (c == d) {
+        return false;
+    }
+
+    int deviation[4], corners[4] = {a, b, c, d};
+    for (int k = 0; k < 4; ++k) {
+        deviation[k] = valence[corners[k]] - targetValence(mesh, corners[k]);
+    }
+    int before = 0, after = 0;
+    for (int k = 0; k < 4; ++k) {
+        int change = (k < 2) ? -1 : 1;
+        before += deviation[k] * deviation[k];
+        after += (deviation[k] + change) * (deviation[k] + change);
+    }
+    if (after >= before) {
+        return false;
+    }
+
+    glm::vec3 pa = position(positions[a]), pb = position(positions[b]);
+    glm::vec3 pc = position(positions[c]), pd = position(positions[d]);
+    glm::vec3 reference = glm::cross(pb - pa, pc - pa) + glm::cross(pa - pb, pd - pb);
+    glm::vec3 first = glm::cross(pc - pd, pa - pd);
+    glm::vec3 second = glm::cross(pd - pc, pb - pc);
+    return glm::dot(first, reference) > 0.0f && glm::dot(second, reference) > 0.0f;
+}
+
+RemeshStats remeshIsotropic(VertexArray& vertices, FaceArray& faces, float targetEdgeLength, int iterations) {
+    RemeshStats stats;
+    auto start = std::chrono::steady_clock::now();
+    if (faces.empty() || !(targetEdgeLength > 0.0f)) {
+        return stats;
+    }
+
+    // Vertices are projected back onto the input surface
+    TriangleBVH reference = buildBVH(vertices, faces);
+    HalfEdgeMesh mesh = buildHalfEdgeMesh(vertices.size(), faces);
+    VertexArray& positions = vertices;
+
+    const float high = targetEdgeLength * 4.0f / 3.0f;
+    const float low = targetEdgeLength * 4.0f / 5.0f;
+    const float highSquared = high * high, lowSquared = low * low;
+
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        // Split long edges at their midpoints until none are left
+        for (int sweep = 0; sweep < 8; ++sweep) {
+            auto isLong = [&](int h) { return edgeLengthSquared(mesh, positions, h) > highSquared; };
+            std::vector<int> candidates = collectEdges(mesh, isLong);
+            if (candidates.empty()) {
+                break;
+            }
+            size_t firstVertex = 0, firstFace = 0;
+            stats.splits += runConflictFreeBatches(
+                candidates, positions.size() + candidates.size(),
+                [&](int h) { return !(mesh.flags[h] & kHalfEdgeDeleted) && isLong(h); },
+                [&](int h, std::vector<int>& out) { edgeDiamond(mesh, h, out); },
+                [&](size_t count) {
+                    firstVertex = positions.size();
+                    firstFace = mesh.faceHalfEdge.size();
+                    growHalfEdgeMesh(mesh, firstVertex + count, firstFace + count * 2);
+                    positions.resize(firstVertex + count);
+                },
+                [&](int h, size_t rank) {
+                    int m = static_cast<int>(firstVertex + rank);
+                    glm::vec3 midpoint = 0.5f * (position(positions[originVertex(mesh, h)]) + position(positions[mesh.vertex[h]]));
+                    positions[m] = toVertex(midpoint);
+                    splitEdge(mesh, h, m, static_cast<int>(firstFace + rank * 2));
+                });
+        }
+
+        // Collapse short edges that don't create long ones
+        {
+            auto isShort = [&](int h) { return edgeLengthSquared(mesh, positions, h) < lowSquared; };
+            std::vector<int> candidates = collectEdges(mesh, isShort);
+            stats.collapses += runConflictFreeBatches(
+                candidates, positions.size(),
+                [&](int h) {
+                    return !(mesh.flags[h] & kHalfEdgeDeleted) && isShort(h) && chooseCollapse(mesh, positions, h, highSquared) >= 0;
+                },
+                [&](int h, std::vector<int>& out) {
+                    int ends[2] = {originVertex(mesh, h), mesh.vertex[h]};
+                    for (int v : ends) {
+                        out.push_back(v);
+                        forEachOneRingVertex(mesh, v, [&](int n) { out.push_back(n); });
+                    }
+                },
+                [](size_t) {},
+                [&](int h, size_t) { collapseEdge(mesh, chooseCollapse(mesh, positions, h, highSquared)); });
+        }
+
+        // Flip edges towards the target valences; winners own all four
+        // corners, so they update the cached valences without atomics
+        {
+            std::vector<int> valence(positions.size(), 0);
+            parallelFor(positions.size(), 1 << 12, [&](size_t begin, size_t end) {
+                for (size_t v = begin; v < end; ++v) {
+                    if (!(mesh.vertexFlags[v] & kVertexDeleted)) {
+                        valence[v] = vertexValence(mesh, static_cast<int>(v));
+                    }
+                }
+            });
+            std::vector<int> candidates = collectEdges(mesh, [&](int h) { return flipImproves(mesh, positions, valence, h); });
+            stats.flips += runConflictFreeBatches(
+                candidates, positions.size(),
+                [&](int h) { return flipImproves(mesh, positions, valence, h); },
+                [&](int h, std::vector<int>& out) { edgeDiamond(mesh, h, out); },
+                [](size_t) {},
+                [&](int h, size_t) {
+                    int a = originVertex(mesh, h), b = mesh.vertex[h];
+                    int c = mesh.vertex[mesh.next[h]], d = mesh.vertex[mesh.next[mesh.twin[h]]];
+                    if (flipEdge(mesh, h)) {
+                        valence[a]--;
+                        valence[b]--;
+                        valence[c]++;
+                        valence[d]++;
+                    }
+                });
+        }
+
+        // Tangential relaxation towards the one-ring centroid, then reprojection
+        VertexArray relaxed(positions.size());
+        parallelFor(positions.size(), 1 << 12, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                int v = static_cast<int>(i);
+                relaxed[i] = positions[i];
+                if ((mesh.vertexFlags[v] & kVertexDeleted) || mesh.vertexHalfEdge[v] < 0 || isBoundaryVertex(mesh, v)) {
+                    continue;
+                }
+
+                glm::vec3 p = position(positions[v]);
+                glm::vec3 centroid(0.0f), normal(0.0f);
+                int count = 0;
+                forEachOutgoingHalfEdge(mesh, v, [&](int g) {
+                    glm::vec3 q = position(positions[mesh.vertex[g]]);
+                    glm::vec3 r = position(positions[mesh.vertex[mesh.next[g]]]);
+                    centroid += q;
+                    normal += glm::cross(q - p, r - p);
+                    count++;
+                });
+                float normalLength = glm::length(normal);
+                if (count == 0 || normalLength <= 0.0f) {
+                    continue;
+                }
+                normal /= normalLength;
+                glm::vec3 offset = centroid / static_cast<float>(count) - p;
+                glm::vec3 moved = p + offset - normal * glm::dot(normal, offset);
+
+                ClosestHit hit;
+                if (closestPointBVH(reference, moved, hit)) {
+                    moved = hit.point;
+                }
+                relaxed[i] = toVertex(moved);
+            }
+        });
+        positions.swap(relaxed);
+    }
+
+    extractMesh(mesh, vertices, faces);
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
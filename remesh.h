@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "mesh.h"
+
+struct RemeshStats {
+    size_t splits = 0;
+    size_t collapses = 0;
+    size_t flips = 0;
+    double milliseconds = 0.0;
+};
+
+// Function to remesh towards equal edges of the target length (Botsch and
+// Kobbelt): each iteration splits edges longer than 4/3 of the target,
+// collapses edges shorter than 4/5 of it, flips edges towards valence 6
+// (4 on the boundary), relaxes vertices tangentially and projects them back
+// onto the input surface with closest-point queries on a BVH. Splits,
+// collapses and flips run as rounds of conflict-free batches: every candidate
+// claims the vertices it touches with a random priority, and the candidates
+// that hold all of their claims run in parallel. Boundary vertices are only
+// created by splits and never moved.
+RemeshStats remeshIsotropic(VertexArray& vertices, FaceArray& faces, float targetEdgeLength, int iterations = 5);
@@ -0,0 +1,215 @@
+#include "scratch.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Threads count into one of these slots each, so counting rarely contends
+const size_t kAllocationCounterSlots = 64;
+
+struct alignas(64) AllocationCounterSlot {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+static AllocationCounterSlot allocationSlots[kAllocationCounterSlots];
+static std::atomic<size_t> nextAllocationSlot{0};
+
+static AllocationCounterSlot& threadAllocationSlot() {
+    thread_local size_t slot = nextAllocationSlot.fetch_add(1, std::memory_order_relaxed) % kAllocationCounterSlots;
+    return allocationSlots[slot];
+}
+
+AllocationCounters allocationCounters() {
+    AllocationCounters counters;
+    for (const AllocationCounterSlot& slot : allocationSlots) {
+        counters.allocations += slot.allocations.load(std::memory_order_relaxed);
+        counters.frees += slot.frees.load(std::memory_order_relaxed);
+        counters.bytes += slot.bytes.load(std::memory_order_relaxed);
+    }
+    return counters;
+}
+
+AllocationCounters allocationsSince(const AllocationCounters& start) {
+    AllocationCounters now = allocationCounters();
+    now.allocations -= start.allocations;
+    now.frees -= start.frees;
+    now.bytes -= start.bytes;
+    return now;
+}
+
+#if !defined(MESH_ALLOCATION_COUNTERS_DISABLED)
+
+static void* countedAllocate(size_t bytes, size_t alignment, bool nothrow) {
+    for (;;) {
+        void* p = nullptr;
+        if (alignment <= alignof(std::max_align_t)) {
+            p = std::malloc(bytes ? bytes : 1);
+        } else if (posix_memalign(&p, alignment, bytes ? bytes : 1) != 0) {
+            p = nullptr;
+        }
+        if (p) {
+            AllocationCounterSlot& slot = threadAllocationSlot();
+            slot.allocations.fetch_add(1, std::memory_order_relaxed);
+            slot.bytes.fetch_add(bytes, std::memory_order_relaxed);
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            if (nothrow) {
+                return nullptr;
+            }
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void countedFree(void* p) {
+    if (p) {
+        threadAllocationSlot().frees.fetch_add(1, std::memory_order_relaxed);
+        std::free(p);
+    }
+}
+
+void* operator new(size_t bytes) { return countedAllocate(bytes, 0, false); }
+void* operator new[](size_t bytes) { return countedAllocate(bytes, 0, false); }
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept { return countedAllocate(bytes, 0, true); }
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept { return countedAllocate(bytes, 0, true); }
+void* operator new(size_t bytes, std::align_val_t alignment) {
+    return countedAllocate(bytes, static_cast<size_t>(alignment), false);
+}
+void* operator new[](size_t bytes, std::align_val_t alignment) {
+    return countedAllocate(bytes, static_cast<size_t>(alignment), false);
+}
+void* operator new(size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocate(bytes, static_cast<size_t>(alignment), true);
+}
+void* operator new[](size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocate(bytes, static_cast<size_t>(alignment), true);
+}
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(p); }
+
+#endif
+
+// Scratch buffers are at least this big, and sized in powers of two, so
+// slightly different requests reuse the same buffer
+const size_t kMinScratchBytes = 4096;
+// Free buffers and bytes kept per thread; beyond either the smallest buffers
+// are freed, and a buffer bigger than the byte limit is never kept
+const size_t kMaxPooledScratchBuffers = 16;
+const size_t kMaxPooledScratchBytes = size_t(64) << 20;
+
+struct ScratchPool {
+    struct Buffer {
+        void* data;
+        size_t capacity;
+    };
+    std::vector<Buffer> free;
+    size_t freeBytes = 0;
+
+    ~ScratchPool() {
+        for (const Buffer& buffer : free) {
+            ::operator delete(buffer.data);
+        }
+    }
+};
+
+static ScratchPool& threadScratchPool() {
+    thread_local ScratchPool pool;
+    return pool;
+}
+
+void* acquireScratch(size_t bytes, size_t& capacity) {
+    ScratchPool& pool = threadScratchPool();
+    // Best fit among the free buffers
+    size_t best = pool.free.size();
+    for (size_t i = 0; i < pool.free.size(); ++i) {
+        if (pool.free[i].capacity >= bytes && (best == pool.free.size() || pool.free[i].capacity < pool.free[best].capacity)) {
+            best = i;
+        }
+    }
+    if (best < pool.free.size()) {
+        ScratchPool::Buffer buffer = pool.free[best];
+        pool.free[best] = pool.free.back();
+        pool.free.pop_back();
+        pool.freeBytes -= buffer.capacity;
+        capacity = buffer.capacity;
+        return buffer.data;
+    }
+    capacity = kMinScratchBytes;
+    while (capacity < bytes) {
+        capacity *= 2;
+    }
+    return ::operator new(capacity);
+}
+
+void releaseScratch(void* buffer, size_t capacity) {
+    if (capacity > kMaxPooledScratchBytes) {
+        ::operator delete(buffer);
+        return;
+    }
+    ScratchPool& pool = threadScratchPool();
+    if (pool.free.capacity() == 0) {
+        pool.free.reserve(kMaxPooledScratchBuffers + 1);
+    }
+    pool.free.push_back({buffer, capacity});
+    pool.freeBytes += capacity;
+    while (pool.free.size() > kMaxPooledScratchBuffers || pool.freeBytes > kMaxPooledScratchBytes) {
+        auto smallest = std::min_element(pool.free.begin(), pool.free.end(),
+                                         [](const ScratchPool::Buffer& a, const ScratchPool::Buffer& b) {
+                                             return a.capacity < b.capacity;
+                                         });
+        pool.freeBytes -= smallest->capacity;
+        ::operator delete(smallest->data);
+        *smallest = pool.free.back();
+        pool.free.pop_back();
+    }
+}
+
+ScratchArena::~ScratchArena() {
+    resetArena(*this);
+    ::operator delete(block);
+}
+
+void* arenaAllocate(ScratchArena& arena, size_t bytes, size_t alignment) {
+    size_t offset = (arena.used + alignment - 1) & ~(alignment - 1);
+    if (arena.block && offset + bytes <= arena.capacity) {
+        arena.used = offset + bytes;
+        return arena.block + offset;
+    }
+    // Does not fit: an extra block, counted toward the size of the next one
+    char* extra = static_cast<char*>(::operator new(bytes + alignment));
+    arena.overflow.push_back(extra);
+    arena.overflowBytes += bytes + alignment;
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(extra) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    return reinterpret_cast<void*>(aligned);
+}
+
+void resetArena(ScratchArena& arena) {
+    if (!arena.overflow.empty()) {
+        for (char* extra : arena.overflow) {
+            ::operator delete(extra);
+        }
+        arena.overflow.clear();
+        size_t peak = arena.used + arena.overflowBytes;
+        ::operator delete(arena.block);
+        arena.capacity = std::max(kMinScratchBytes, peak + peak / 2);
+        arena.block = static_cast<char*>(::operator new(arena.capacity));
+        arena.overflowBytes = 0;
+    }
+    arena.used = 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Temporary memory that is reused instead of allocated again on every call.
+//
+// Kernels take their temporaries as ScratchBuffers, leased from a pool kept
+// per thread: once every buffer size a kernel needs has been seen, repeated
+// calls on the same thread touch the heap no more. The render loop has a
+// ScratchArena for memory that only lives for one frame; resetting it frees
+// everything at once, and after the first few frames one block covers it.
+//
+// Every heap allocation in the process goes through counters (the global
+// operator new is replaced), so allocations in a frame or a kernel call can
+// be checked to be zero. Building with MESH_ALLOCATION_COUNTERS_DISABLED
+// leaves operator new alone.
+
+struct AllocationCounters {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;
+};
+
+// Function to read the heap allocations made by all threads since the start
+// (all zero when the counters are compiled out)
+AllocationCounters allocationCounters();
+
+// Function to count the allocations made since an earlier reading
+AllocationCounters allocationsSince(const AllocationCounters& start);
+
+// Function to lease a buffer of at least bytes from the calling thread's
+// pool, setting capacity to its actual size
+void* acquireScratch(size_t bytes, size_t& capacity);
+
+// Function to return a leased buffer to the calling thread's pool. A pool
+// keeps at most 64 MB; buffers past that are freed.
+void releaseScratch(void* buffer, size_t capacity);
+
+// Temporary array of count uninitialized elements, leased from the calling
+// thread's pool and returned (to the pool of the thread destroying it) when
+// it goes out of scope
+template <typename T>
+class ScratchBuffer {
+    static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+                  "scratch buffers hold plain data");
+
+public:
+    explicit ScratchBuffer(size_t count) : count_(count) {
+        data_ = static_cast<T*>(acquireScratch(count * sizeof(T), capacity_));
+    }
+    ScratchBuffer(size_t count, const T& value) : ScratchBuffer(count) {
+        for (size_t i = 0; i < count; ++i) {
+            data_[i] = value;
+        }
+    }
+    ~ScratchBuffer() { releaseScratch(data_, capacity_); }
+    ScratchBuffer(const ScratchBuffer&) = delete;
+    ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    size_t size() const { return count_; }
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    T* begin() { return data_; }
+    T* end() { return data_ + count_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + count_; }
+
+private:
+    T* data_ = nullptr;
+    size_t count_ = 0;
+    size_t capacity_ = 0;
+};
+
+// Monotonic allocator for memory that is all released together. Allocations
+// that do not fit the block go to extra blocks; reset frees those and grows
+// the block to the peak, so a steady workload runs from a single block.
+struct ScratchArena {
+    char* block = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    std::vector<char*> overflow;
+    size_t overflowBytes = 0;
+
+    ScratchArena() = default;
+    ~ScratchArena();
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+};
+
+// Function to take bytes from the arena, aligned to alignment (a power of two)
+void* arenaAllocate(ScratchArena& arena, size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+// Function to take an uninitialized array of count elements from the arena
+template <typename T>
+T* arenaArray(ScratchArena& arena, size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed element by element");
+    return static_cast<T*>(arenaAllocate(arena, count * sizeof(T), alignof(T)));
+}
+
+// Function to release everything allocated from the arena
+void resetArena(ScratchArena& arena);
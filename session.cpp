@@ -0,0 +1,224 @@
+#include "session.h"
+#include "trace.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+const char kSessionMagic[8] = {'M', 'E', 'S', 'H', 'S', 'E', 'S', 'S'};
+const uint32_t kSessionVersion = 1;
+
+template <typename T>
+static void writeValue(std::ostream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T, typename Allocator>
+static void writeArray(std::ostream& file, const std::vector<T, Allocator>& records) {
+    writeValue(file, static_cast<uint64_t>(records.size()));
+    file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(T)));
+}
+
+static void writeString(std::ostream& file, const std::string& text) {
+    writeValue(file, static_cast<uint64_t>(text.size()));
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+static void writeEntry(std::ostream& file, const HistoryEntry& entry) {
+    writeString(file, entry.label);
+    writeValue(file, static_cast<uint8_t>(entry.topology));
+    writeValue(file, static_cast<uint64_t>(entry.delta.vertexCount));
+    writeArray(file, entry.delta.blocks);
+    writeArray(file, entry.delta.byteOffsets);
+    writeArray(file, entry.delta.bytes);
+    writeArray(file, entry.vertices);
+    writeArray(file, entry.faces);
+}
+
+static void writeEntries(std::ostream& file, const std::deque<HistoryEntry>& entries) {
+    writeValue(file, static_cast<uint64_t>(entries.size()));
+    for (const HistoryEntry& entry : entries) {
+        writeEntry(file, entry);
+    }
+}
+
+// Reads keep track of the bytes left in the file, so a damaged count fails
+// the load instead of asking for a huge allocation
+struct SessionReader {
+    std::ifstream file;
+    uint64_t remaining = 0;
+};
+
+template <typename T>
+static bool readValue(SessionReader& reader, T& value) {
+    if (reader.remaining < sizeof(T)) {
+        return false;
+    }
+    reader.remaining -= sizeof(T);
+    return static_cast<bool>(reader.file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+static bool readCount(SessionReader& reader, size_t recordBytes, uint64_t& count) {
+    return readValue(reader, count) && count <= reader.remaining / recordBytes;
+}
+
+template <typename T, typename Allocator>
+static bool readArray(SessionReader& reader, std::vector<T, Allocator>& records) {
+    uint64_t count = 0;
+    if (!readCount(reader, sizeof(T), count)) {
+        return false;
+    }
+    records.resize(static_cast<size_t>(count));
+    reader.remaining -= count * sizeof(T);
+    return static_cast<bool>(
+        reader.file.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(count * sizeof(T))));
+}
+
+static bool readString(SessionReader& reader, std::string& text) {
+    uint64_t count = 0;
+    if (!readCount(reader, 1, count)) {
+        return false;
+    }
+    text.resize(static_cast<size_t>(count));
+    reader.remaining -= count;
+    return static_cast<bool>(reader.file.read(&text[0], static_cast<std::streamsize>(count)));
+}
+
+static bool readEntry(SessionReader& reader, HistoryEntry& entry) {
+    uint8_t topology = 0;
+    uint64_t vertexCount = 0;
+    if (!readString(reader, entry.label) || !readValue(reader, topology) || !readValue(reader, vertexCount)) {
+        return false;
+    }
+    entry.topology = topology != 0;
+    entry.delta.vertexCount = static_cast<size_t>(vertexCount);
+    return readArray(reader, entry.delta.blocks) && readArray(reader, entry.delta.byteOffsets) &&
+           readArray(reader, entry.delta.bytes) && readArray(reader, entry.vertices) && readArray(reader, entry.faces) &&
+           (entry.topology || checkVertexDelta(entry.delta));
+}
+
+static bool readEntries(SessionReader& reader, std::deque<HistoryEntry>& entries) {
+    uint64_t count = 0;
+    // Every entry takes at least its label length, flag and delta header
+    if (!readCount(reader, 2 * sizeof(uint64_t) + 1, count)) {
+        return false;
+    }
+    entries.clear();
+    entries.resize(static_cast<size_t>(count));
+    for (HistoryEntry& entry : entries) {
+        if (!readEntry(reader, entry)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool facesInRange(const FaceArray& faces, size_t vertexCount) {
+    for (const Face& face : faces) {
+        if (face.v1 < 0 || face.v2 < 0 || face.v3 < 0 || static_cast<size_t>(face.v1) >= vertexCount ||
+            static_cast<size_t>(face.v2) >= vertexCount || static_cast<size_t>(face.v3) >= vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to check that each entry, stepped through from the top of its
+// stack, applies to a mesh of the size the steps before it leave
+static bool entriesMatch(const std::deque<HistoryEntry>& entries, size_t vertexCount) {
+    for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry) {
+        if (entry->topology) {
+            if (!facesInRange(entry->faces, entry->vertices.size())) {
+                return false;
+            }
+            vertexCount = entry->vertices.size();
+        } else if (entry->delta.vertexCount != vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool saveSession(const std::string& filename, const VertexArray& vertices, const FaceArray& faces,
+                 const std::vector<Normal>& normals, const VertexArray& originalVertices, int denoiseLevel,
+                 const EditHistory& history) {
+    TRACE_SCOPE("saveSession");
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    file.write(kSessionMagic, sizeof(kSessionMagic));
+    writeValue(file, kSessionVersion);
+    writeArray(file, vertices);
+    writeArray(file, faces);
+    writeArray(file, normals);
+    writeArray(file, originalVertices);
+    writeValue(file, static_cast<int32_t>(denoiseLevel));
+    writeValue(file, static_cast<uint64_t>(history.memoryBudget));
+    writeArray(file, history.committed);
+    writeEntries(file, history.undo);
+    writeEntries(file, history.redo);
+    file.close();
+    if (!file) {
+        std::cerr << "Error writing " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadSession(const std::string& filename, VertexArray& vertices, FaceArray& faces, std::vector<Normal>& normals,
+                 VertexArray& originalVertices, int& denoiseLevel, EditHistory& history) {
+    TRACE_SCOPE("loadSession");
+    SessionReader reader;
+    reader.file.open(filename, std::ios::binary | std::ios::ate);
+    if (!reader.file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    reader.remaining = static_cast<uint64_t>(reader.file.tellg());
+    reader.file.seekg(0);
+
+    char magic[sizeof(kSessionMagic)] = {};
+    uint32_t version = 0;
+    if (reader.remaining < sizeof(magic) || !reader.file.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kSessionMagic, sizeof(magic)) != 0) {
+        std::cerr << filename << " is not a session file" << std::endl;
+        return false;
+    }
+    reader.remaining -= sizeof(magic);
+    if (!readValue(reader, version) || version != kSessionVersion) {
+        std::cerr << filename << " has unsupported session version " << version << std::endl;
+        return false;
+    }
+
+    int32_t level = 0;
+    uint64_t memoryBudget = 0;
+    bool read = readArray(reader, vertices) && readArray(reader, faces) && readArray(reader, normals) &&
+                readArray(reader, originalVertices) && readValue(reader, level) && readValue(reader, memoryBudget) &&
+                readArray(reader, history.committed) && readEntries(reader, history.undo) &&
+                readEntries(reader, history.redo);
+    if (!read) {
+        std::cerr << "Error reading session " << filename << ": the file is damaged or cut short" << std::endl;
+        return false;
+    }
+    if (!facesInRange(faces, vertices.size())) {
+        std::cerr << "Error reading session " << filename << ": a face refers to a vertex past the end" << std::endl;
+        return false;
+    }
+    if (level < 0 || level > kMaxDenoiseLevel) {
+        std::cerr << "Error reading session " << filename << ": denoise level " << level << " is out of range"
+                  << std::endl;
+        return false;
+    }
+    bool consistent = originalVertices.size() == vertices.size() && history.committed.size() == vertices.size() && entriesMatch(history.undo, vertices.size()) &&
+                      entriesMatch(history.redo, vertices.size());
+    if (!consistent) {
+        std::cerr << "Error reading session " << filename << ": the mesh and its history do not match" << std::endl;
+        return false;
+    }
+    denoiseLevel = level;
+    history.memoryBudget = static_cast<size_t>(memoryBudget);
+    recountEditHistoryMemory(history);
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "history.h"
+#include "mesh.h"
+
+// A session file keeps everything needed to pick up editing where it was
+// left: the mesh, its normals, the positions the denoise slider starts from,
+// the denoise level and the undo and redo stacks. Arrays are stored as raw
+// records, in the byte order of the machine, behind a count, so loading is
+// a few large reads.
+
+// Denoise levels run from 0 (the original positions) up to this one
+const int kMaxDenoiseLevel = 3;
+
+// Function to write a session file
+bool saveSession(const std::string& filename, const VertexArray& vertices, const FaceArray& faces,
+                 const std::vector<Normal>& normals, const VertexArray& originalVertices, int denoiseLevel,
+                 const EditHistory& history);
+
+// Function to read a session file written by saveSession. Returns false, and
+// leaves the arguments unspecified, if the file is not a session, is cut short
+// or holds faces, a denoise level or history that do not fit its mesh.
+bool loadSession(const std::string& filename, VertexArray& vertices, FaceArray& faces, std::vector<Normal>& normals,
+                 VertexArray& originalVertices, int& denoiseLevel, EditHistory& history);
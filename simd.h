@@ -0,0 +1,149 @@
+#pragma once
+
+// Minimal 4-wide float vector used by the culling and ray kernels.
+// Maps to SSE on x86, NEON on ARM and plain arrays everywhere else.
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESH_SIMD_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MESH_SIMD_NEON 1
+#else
+#include <cmath>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+struct Float4 {
+#if defined(MESH_SIMD_SSE)
+    __m128 v;
+#elif defined(MESH_SIMD_NEON)
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+};
+
+// Lane masks are stored as floats with all bits set or cleared
+typedef Float4 Mask4;
+
+#if defined(MESH_SIMD_SSE)
+
+inline Float4 load4(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void store4(float* p, Float4 a) { _mm_storeu_ps(p, a.v); }
+inline Float4 splat4(float x) { return {_mm_set1_ps(x)}; }
+inline Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Float4 min4(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Float4 max4(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+inline Float4 sqrt4(Float4 a) { return {_mm_sqrt_ps(a.v)}; }
+inline Mask4 operator<(Float4 a, Float4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Mask4 operator<=(Float4 a, Float4 b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline Mask4 operator>(Float4 a, Float4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Mask4 operator>=(Float4 a, Float4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline Mask4 operator&(Mask4 a, Mask4 b) { return {_mm_and_ps(a.v, b.v)}; }
+inline Mask4 operator|(Mask4 a, Mask4 b) { return {_mm_or_ps(a.v, b.v)}; }
+// a & ~b
+inline Mask4 andNot4(Mask4 a, Mask4 b) { return {_mm_andnot_ps(b.v, a.v)}; }
+inline Float4 select4(Mask4 mask, Float4 a, Float4 b) { return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))}; }
+inline int maskBits4(Mask4 mask) { return _mm_movemask_ps(mask.v); }
+
+#elif defined(MESH_SIMD_NEON)
+
+inline Float4 load4(const float* p) { return {vld1q_f32(p)}; }
+inline void store4(float* p, Float4 a) { vst1q_f32(p, a.v); }
+inline Float4 splat4(float x) { return {vdupq_n_f32(x)}; }
+inline Float4 operator+(Float4 a, Float4 b) { return {vaddq_f32(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {vsubq_f32(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {vmulq_f32(a.v, b.v)}; }
+inline Float4 operator/(Float4 a, Float4 b) { return {vdivq_f32(a.v, b.v)}; }
+inline Float4 min4(Float4 a, Float4 b) { return {vminq_f32(a.v, b.v)}; }
+inline Float4 max4(Float4 a, Float4 b) { return {vmaxq_f32(a.v, b.v)}; }
+inline Float4 sqrt4(Float4 a) { return {vsqrtq_f32(a.v)}; }
+inline Mask4 operator<(Float4 a, Float4 b) { return {vreinterpretq_f32_u32(vcltq_f32(a.v, b.v))}; }
+inline Mask4 operator<=(Float4 a, Float4 b) { return {vreinterpretq_f32_u32(vcleq_f32(a.v, b.v))}; }
+inline Mask4 operator>(Float4 a, Float4 b) { return {vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v))}; }
+inline Mask4 operator>=(Float4 a, Float4 b) { return {vreinterpretq_f32_u32(vcgeq_f32(a.v, b.v))}; }
+inline Mask4 operator&(Mask4 a, Mask4 b) {
+    return {vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)))};
+}
+inline Mask4 operator|(Mask4 a, Mask4 b) {
+    return {vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)))};
+}
+// a & ~b
+inline Mask4 andNot4(Mask4 a, Mask4 b) {
+    return {vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v)))};
+}
+inline Float4 select4(Mask4 mask, Float4 a, Float4 b) { return {vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v)}; }
+inline int maskBits4(Mask4 mask) {
+    static const int32_t shifts[4] = {0, 1, 2, 3};
+    uint32x4_t bits = vshlq_u32(vshrq_n_u32(vreinterpretq_u32_f32(mask.v), 31), vld1q_s32(shifts));
+    return static_cast<int>(vaddvq_u32(bits));
+}
+
+#else
+
+#include <cstring>
+
+inline Float4 load4(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store4(float* p, Float4 a) { for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+inline Float4 splat4(float x) { return {{x, x, x, x}}; }
+
+#define MESH_SIMD_LANEWISE(expr) Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = (expr); return r;
+inline Float4 operator+(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(a.v[i] + b.v[i]) }
+inline Float4 operator-(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(a.v[i] - b.v[i]) }
+inline Float4 operator*(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(a.v[i] * b.v[i]) }
+inline Float4 operator/(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(a.v[i] / b.v[i]) }
+inline Float4 min4(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline Float4 max4(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline Float4 sqrt4(Float4 a) { MESH_SIMD_LANEWISE(std::sqrt(a.v[i])) }
+
+inline float maskLane(bool set) {
+    unsigned int bits = set ? 0xffffffffu : 0u;
+    float lane;
+    std::memcpy(&lane, &bits, sizeof(lane));
+    return lane;
+}
+inline unsigned int laneBits(float lane) {
+    unsigned int bits;
+    std::memcpy(&bits, &lane, sizeof(bits));
+    return bits;
+}
+
+inline Mask4 operator<(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(maskLane(a.v[i] < b.v[i])) }
+inline Mask4 operator<=(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(maskLane(a.v[i] <= b.v[i])) }
+inline Mask4 operator>(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(maskLane(a.v[i] > b.v[i])) }
+inline Mask4 operator>=(Float4 a, Float4 b) { MESH_SIMD_LANEWISE(maskLane(a.v[i] >= b.v[i])) }
+inline Mask4 operator&(Mask4 a, Mask4 b) { MESH_SIMD_LANEWISE(maskLane(laneBits(a.v[i]) & laneBits(b.v[i]))) }
+inline Mask4 operator|(Mask4 a, Mask4 b) { MESH_SIMD_LANEWISE(maskLane(laneBits(a.v[i]) | laneBits(b.v[i]))) }
+// a & ~b
+inline Mask4 andNot4(Mask4 a, Mask4 b) { MESH_SIMD_LANEWISE(maskLane(laneBits(a.v[i]) && !laneBits(b.v[i]))) }
+inline Float4 select4(Mask4 mask, Float4 a, Float4 b) { MESH_SIMD_LANEWISE(laneBits(mask.v[i]) ? a.v[i] : b.v[i]) }
+inline int maskBits4(Mask4 mask) {
+    int bits = 0;
+    for (int i = 0; i < 4; ++i) {
+        bits |= (laneBits(mask.v[i]) ? 1 : 0) << i;
+    }
+    return bits;
+}
+#undef MESH_SIMD_LANEWISE
+
+#endif
+
+// Function to find the lowest set lane of a nonzero maskBits4 result
+inline int lowestLane(int bits) {
+#if defined(_MSC_VER)
+    unsigned long lane;
+    _BitScanForward(&lane, static_cast<unsigned long>(bits));
+    return static_cast<int>(lane);
+#else
+    return __builtin_ctz(static_cast<unsigned int>(bits));
+#endif
+}
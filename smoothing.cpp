@@ -0,0 +1,44 @@
+#include "smoothing.h"
+#include "parallel.h"
+
+bool gaussSeidelSmoothing(VertexArray& vertices, const Adjacency& neighbors,
+                          const GraphColoring& coloring, float smoothingFactor, int iterations,
+                          const std::function<bool(float)>& progress) {
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        for (int c = 0; c < coloring.colorCount; ++c) {
+            const unsigned int* members = coloring.classes.indices.data() + coloring.classes.offsets[c];
+            size_t memberCount = coloring.classes.offsets[c + 1] - coloring.classes.offsets[c];
+            parallelFor(memberCount, 1 << 12, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    unsigned int v = members[i];
+                    unsigned int first = neighbors.offsets[v];
+                    unsigned int last = neighbors.offsets[v + 1];
+                    if (first == last) {
+                        continue;
+                    }
+
+                    float sumX = 0.0f, sumY = 0.0f, sumZ = 0.0f;
+                    for (unsigned int k = first; k < last; ++k) {
+                        const Vertex& n = vertices[neighbors.indices[k]];
+                        sumX += n.x;
+                        sumY += n.y;
+                        sumZ += n.z;
+                    }
+                    float inverseCount = 1.0f / static_cast<float>(last - first);
+
+                    // Move the vertex towards the average position of its neighbors
+                    Vertex& p = vertices[v];
+                    p.x += (sumX * inverseCount - p.x) * smoothingFactor;
+                    p.y += (sumY * inverseCount - p.y) * smoothingFactor;
+                    p.z += (sumZ * inverseCount - p.z) * smoothingFactor;
+                }
+            });
+
+            if (progress && !progress(static_cast<float>(iteration * coloring.colorCount + c + 1) /
+                                      static_cast<float>(iterations * coloring.colorCount))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "adjacency.h"
+#include "mesh.h"
+
+// Function to run Laplacian smoothing as a multicolor Gauss-Seidel sweep: the
+// color classes are visited in order and each class moves in place, in
+// parallel, towards the average of its neighbors. No two neighbors share a
+// class, so every update reads positions that are final for this pass, and
+// later classes already see the moved ones. No second vertex buffer is needed.
+// neighbors comes from buildVertexAdjacency and coloring from colorGraph on it.
+// progress, if set, gets the fraction done after every class and stops the
+// sweep by returning false; the function then returns false as well.
+bool gaussSeidelSmoothing(VertexArray& vertices, const Adjacency& neighbors,
+                          const GraphColoring& coloring, float smoothingFactor, int iterations = 1,
+                          const std::function<bool(float)>& progress = nullptr);
+
+// The neighbor graph and its coloring, built once per topology
+struct SmoothingGraph {
+    Adjacency neighbors;
+    GraphColoring coloring;
+};
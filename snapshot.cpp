@@ -0,0 +1,242 @@
+#include "snapshot.h"
+#include "parallel.h"
+#include "scratch.h"
+#include <algorithm>
+#include <cstring>
+
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bitsFloat(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint32_t readVarint(const uint8_t*& in) {
+    uint32_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+VertexDelta encodeVertexDelta(const VertexArray& before, const VertexArray& after) {
+    VertexDelta delta;
+    delta.vertexCount = after.size();
+    delta.byteOffsets.push_back(0);
+    if (before.size() != after.size()) {
+        return delta;
+    }
+
+    // Encode every changed block into its own buffer, then concatenate in order
+    const size_t blockCount = (after.size() + kDeltaBlockVertices - 1) / kDeltaBlockVertices;
+    std::vector<std::vector<uint8_t>> blockBytes(blockCount);
+    parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t first = b * kDeltaBlockVertices;
+            size_t last = std::min(after.size(), first + kDeltaBlockVertices);
+            if (std::memcmp(&before[first], &after[first], (last - first) * sizeof(Vertex)) == 0) {
+                continue;
+            }
+            std::vector<uint8_t>& out = blockBytes[b];
+            out.reserve((last - first) * 6);
+            for (size_t i = first; i < last; ++i) {
+                writeVarint(out, floatBits(before[i].x) ^ floatBits(after[i].x));
+                writeVarint(out, floatBits(before[i].y) ^ floatBits(after[i].y));
+                writeVarint(out, floatBits(before[i].z) ^ floatBits(after[i].z));
+            }
+        }
+    });
+
+    for (size_t b = 0; b < blockCount; ++b) {
+        if (!blockBytes[b].empty()) {
+            delta.blocks.push_back(static_cast<uint32_t>(b));
+            delta.byteOffsets.push_back(delta.byteOffsets.back() + static_cast<uint32_t>(blockBytes[b].size()));
+        }
+    }
+    delta.bytes.resize(delta.byteOffsets.back());
+    parallelFor(delta.blocks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            std::vector<uint8_t>& block = blockBytes[delta.blocks[i]];
+            std::memcpy(delta.bytes.data() + delta.byteOffsets[i], block.data(), block.size());
+        }
+    });
+    return delta;
+}
+
+bool applyVertexDelta(const VertexDelta& delta, VertexArray& vertices) {
+    if (vertices.size() != delta.vertexCount) {
+        return false;
+    }
+    parallelFor(delta.blocks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint8_t* in = delta.bytes.data() + delta.byteOffsets[i];
+            size_t first = static_cast<size_t>(delta.blocks[i]) * kDeltaBlockVertices;
+            size_t last = std::min(vertices.size(), first + kDeltaBlockVertices);
+            for (size_t v = first; v < last; ++v) {
+                vertices[v].x = bitsFloat(floatBits(vertices[v].x) ^ readVarint(in));
+                vertices[v].y = bitsFloat(floatBits(vertices[v].y) ^ readVarint(in));
+                vertices[v].z = bitsFloat(floatBits(vertices[v].z) ^ readVarint(in));
+            }
+        }
+    });
+    return true;
+}
+
+// Function to step over one varint of at most five bytes that ends before end
+static bool skipVarint(const uint8_t*& in, const uint8_t* end) {
+    for (int i = 0; i < 5 && in < end; ++i) {
+        if (!(*in++ & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool checkVertexDelta(const VertexDelta& delta) {
+    if (delta.byteOffsets.size() != delta.blocks.size() + 1 || delta.byteOffsets.back() > delta.bytes.size()) {
+        return false;
+    }
+    const size_t blockCount = (delta.vertexCount + kDeltaBlockVertices - 1) / kDeltaBlockVertices;
+    for (size_t i = 0; i < delta.blocks.size(); ++i) {
+        if (delta.blocks[i] >= blockCount || delta.byteOffsets[i] > delta.byteOffsets[i + 1]) {
+            return false;
+        }
+        const uint8_t* in = delta.bytes.data() + delta.byteOffsets[i];
+        const uint8_t* end = delta.bytes.data() + delta.byteOffsets[i + 1];
+        size_t first = static_cast<size_t>(delta.blocks[i]) * kDeltaBlockVertices;
+        size_t coordinates = 3 * (std::min(delta.vertexCount, first + kDeltaBlockVertices) - first);
+        for (size_t c = 0; c < coordinates; ++c) {
+            if (!skipVarint(in, end)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t vertexDeltaBytes(const VertexDelta& delta) {
+    return delta.blocks.capacity() * sizeof(uint32_t) + delta.byteOffsets.capacity() * sizeof(uint32_t) +
+           delta.bytes.capacity();
+}
+
+uint64_t hashVertices(const VertexArray& vertices) {
+    // FNV-1a style hash per block, folded together in block order
+    const size_t blockCount = (vertices.size() + kDeltaBlockVertices - 1) / kDeltaBlockVertices;
+    ScratchBuffer<uint64_t> blockHashes(blockCount);
+    parallelFor(blockCount, 16, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t first = b * kDeltaBlockVertices;
+            size_t last = std::min(vertices.size(), first + kDeltaBlockVertices);
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (size_t i = first; i < last; ++i) {
+                hash = (hash ^ floatBits(vertices[i].x)) * 0x100000001b3ull;
+                hash = (hash ^ floatBits(vertices[i].y)) * 0x100000001b3ull;
+                hash = (hash ^ floatBits(vertices[i].z)) * 0x100000001b3ull;
+            }
+            blockHashes[b] = hash;
+        }
+    });
+
+    uint64_t hash = 0xcbf29ce484222325ull ^ vertices.size();
+    for (uint64_t blockHash : blockHashes) {
+        hash = (hash ^ blockHash) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+static void dropEntry(SnapshotCache& cache, SnapshotCacheEntry& entry) {
+    if (entry.valid) {
+        cache.memoryUsed -= vertexDeltaBytes(entry.delta);
+    }
+    entry = SnapshotCacheEntry();
+}
+
+void storeSnapshot(SnapshotCache& cache, int level, const VertexArray& previous,
+                   const VertexArray& current) {
+    if (level < 0) {
+        return;
+    }
+    if (cache.levels.size() <= static_cast<size_t>(level)) {
+        cache.levels.resize(level + 1);
+    }
+    dropEntry(cache, cache.levels[level]);
+
+    SnapshotCacheEntry entry;
+    entry.delta = encodeVertexDelta(previous, current);
+    entry.delta.bytes.shrink_to_fit();
+    size_t bytes = vertexDeltaBytes(entry.delta);
+    if (bytes > cache.memoryBudget) {
+        return;
+    }
+
+    // Evict the least recently used levels until the new one fits
+    while (cache.memoryUsed + bytes > cache.memoryBudget) {
+        SnapshotCacheEntry* oldest = nullptr;
+        for (auto& candidate : cache.levels) {
+            if (candidate.valid && (!oldest || candidate.lastUse < oldest->lastUse)) {
+                oldest = &candidate;
+            }
+        }
+        dropEntry(cache, *oldest);
+    }
+
+    entry.baseHash = hashVertices(previous);
+    entry.resultHash = hashVertices(current);
+    entry.lastUse = ++cache.clock;
+    entry.valid = true;
+    cache.memoryUsed += bytes;
+    cache.levels[level] = std::move(entry);
+}
+
+bool restoreSnapshot(SnapshotCache& cache, int currentLevel, uint64_t currentHash, int targetLevel,
+                     VertexArray& vertices) {
+    if (currentLevel < 0 || targetLevel < 0) {
+        return false;
+    }
+
+    // Check the whole path first: stepping up applies the deltas of levels
+    // currentLevel + 1 .. targetLevel, stepping down those of currentLevel .. targetLevel + 1
+    int step = (targetLevel > currentLevel) ? 1 : -1;
+    uint64_t hash = currentHash;
+    for (int level = currentLevel; level != targetLevel; level += step) {
+        size_t index = static_cast<size_t>(step > 0 ? level + 1 : level);
+        if (index >= cache.levels.size() || !cache.levels[index].valid) {
+            return false;
+        }
+        const SnapshotCacheEntry& entry = cache.levels[index];
+        if (entry.delta.vertexCount != vertices.size() || hash != (step > 0 ? entry.baseHash : entry.resultHash)) {
+            return false;
+        }
+        hash = (step > 0) ? entry.resultHash : entry.baseHash;
+    }
+
+    for (int level = currentLevel; level != targetLevel; level += step) {
+        SnapshotCacheEntry& entry = cache.levels[step > 0 ? level + 1 : level];
+        applyVertexDelta(entry.delta, vertices);
+        entry.lastUse = ++cache.clock;
+    }
+    return true;
+}
+
+void clearSnapshotCache(SnapshotCache& cache) {
+    cache.levels.clear();
+    cache.memoryUsed = 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh.h"
+
+// Vertices are diffed in blocks of this many; unchanged blocks cost nothing
+const size_t kDeltaBlockVertices = 1024;
+
+// Lossless difference between two vertex arrays of the same size. Only the
+// changed blocks are stored: every coordinate of such a block as the XOR of
+// the old and new float bits, written as a varint. Small moves leave the sign,
+// exponent and top mantissa bits alone, so most coordinates take one to three
+// bytes. XOR is its own inverse, so the same delta steps either way.
+struct VertexDelta {
+    size_t vertexCount = 0;
+    // Block blocks[i] is encoded in bytes[byteOffsets[i], byteOffsets[i + 1])
+    std::vector<uint32_t> blocks;
+    std::vector<uint32_t> byteOffsets;
+    std::vector<uint8_t> bytes;
+};
+
+// Function to encode the difference between before and after, in parallel
+VertexDelta encodeVertexDelta(const VertexArray& before, const VertexArray& after);
+
+// Function to turn before into after or after into before, touching only the
+// changed blocks. Returns false if the vertex count does not match.
+bool applyVertexDelta(const VertexDelta& delta, VertexArray& vertices);
+
+// Function to check that a delta read from outside (a session file) stays
+// within its own bytes and vertex count when applied
+bool checkVertexDelta(const VertexDelta& delta);
+
+// Function to count the heap bytes held by a delta
+size_t vertexDeltaBytes(const VertexDelta& delta);
+
+// Function to hash the exact float bits of the positions, in parallel
+uint64_t hashVertices(const VertexArray& vertices);
+
+struct SnapshotCacheEntry {
+    VertexDelta delta;
+    uint64_t baseHash = 0;   // positions the delta applies to
+    uint64_t resultHash = 0; // positions it produces
+    uint64_t lastUse = 0;
+    bool valid = false;
+};
+
+// Cache of numbered levels, each stored as a delta from the level before it.
+// Entries know the hashes of the positions on both sides, so a level is only
+// restored onto the positions it was computed from. Once the deltas exceed
+// memoryBudget bytes, the least recently used levels are evicted.
+struct SnapshotCache {
+    std::vector<SnapshotCacheEntry> levels;
+    size_t memoryBudget = 256u << 20;
+    size_t memoryUsed = 0;
+    uint64_t clock = 0;
+};
+
+// Function to record level as the step from previous (level - 1) to current,
+// replacing what was cached for it before
+void storeSnapshot(SnapshotCache& cache, int level, const VertexArray& previous,
+                   const VertexArray& current);
+
+// Function to move vertices, which hold level currentLevel with hash
+// currentHash, to targetLevel by stepping through the cached deltas. Returns
+// false (and leaves vertices untouched) if a level on the way is missing or
+// was computed from different positions.
+bool restoreSnapshot(SnapshotCache& cache, int currentLevel, uint64_t currentHash, int targetLevel,
+                     VertexArray& vertices);
+
+// Function to drop every cached level
+void clearSnapshotCache(SnapshotCache& cache);
@@ -0,0 +1,88 @@
+#include "storage.h"
+#include <cstdint>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    if (descriptor >= 0) {
+        ::close(descriptor);
+    }
+}
+
+std::shared_ptr<MappedFile> openMappedFile(const std::string& path, bool writeBack) {
+    int descriptor = writeBack ? ::open(path.c_str(), O_RDWR | O_CREAT, 0644) : ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return nullptr;
+    }
+    struct stat status;
+    if (::fstat(descriptor, &status) != 0) {
+        std::cerr << "Error reading the size of " << path << std::endl;
+        ::close(descriptor);
+        return nullptr;
+    }
+    auto file = std::make_shared<MappedFile>();
+    file->descriptor = descriptor;
+    file->path = path;
+    file->size = static_cast<size_t>(status.st_size);
+    file->writeBack = writeBack;
+    return file;
+}
+
+void* mapFileRegion(MappedFile& file, size_t bytes) {
+    void* region = MAP_FAILED;
+    if (file.writeBack) {
+        if (bytes > file.size) {
+            if (::ftruncate(file.descriptor, static_cast<off_t>(bytes)) != 0) {
+                std::cerr << "Error growing " << file.path << " to " << bytes << " bytes" << std::endl;
+                return nullptr;
+            }
+            file.size = bytes;
+        }
+        region = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file.descriptor, 0);
+    } else if (bytes <= file.size) {
+        region = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, file.descriptor, 0);
+    } else {
+        region = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (region == MAP_FAILED) {
+        std::cerr << "Error mapping " << bytes << " bytes of " << file.path << std::endl;
+        return nullptr;
+    }
+    return region;
+}
+
+void unmapFileRegion(void* region, size_t bytes) {
+    ::munmap(region, bytes);
+}
+
+bool truncateMappedFile(MappedFile& file, size_t bytes) {
+    if (::ftruncate(file.descriptor, static_cast<off_t>(bytes)) != 0) {
+        std::cerr << "Error resizing " << file.path << " to " << bytes << " bytes" << std::endl;
+        return false;
+    }
+    file.size = bytes;
+    return true;
+}
+
+bool syncFileRegion(void* region, size_t bytes) {
+    return ::msync(region, bytes, MS_SYNC) == 0;
+}
+
+void adviseFileRegion(const void* region, size_t bytes, StorageAdvice advice) {
+    // madvise wants a page-aligned start
+    const uintptr_t pageSize = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(region);
+    uintptr_t alignedBegin = begin & ~(pageSize - 1);
+    int flag = MADV_NORMAL;
+    switch (advice) {
+        case StorageAdvice::Normal: flag = MADV_NORMAL; break;
+        case StorageAdvice::Sequential: flag = MADV_SEQUENTIAL; break;
+        case StorageAdvice::Random: flag = MADV_RANDOM; break;
+        case StorageAdvice::WillNeed: flag = MADV_WILLNEED; break;
+    }
+    ::madvise(reinterpret_cast<void*>(alignedBegin), bytes + (begin - alignedBegin), flag);
+}
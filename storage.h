@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Storage for the big mesh arrays. Vertex and face arrays are std::vectors
+// with StorageAllocator, which keeps them on the heap by default. An array
+// can instead be backed by a file mapped into memory, so a mesh larger than
+// RAM is paged in and out by the OS on demand while every kernel keeps
+// working on it as a plain vector.
+//
+// With writeBack, the file is mapped shared: edits land in the file and the
+// file grows with the array. Without it, the mapping is private: edits stay
+// in memory and the file is never changed.
+//
+// Copies of a mapped array are made on the heap, and moving or swapping a
+// heap array into a mapped one replaces the mapping (takeArrayContents
+// keeps it). Growing a mapped array remaps the
+// file, which copies it onto itself page by page, so reserve the final size
+// up front where it is known.
+
+// An open file that arrays are mapped from
+struct MappedFile {
+    int descriptor = -1;
+    std::string path;
+    size_t size = 0;
+    bool writeBack = false;
+    // Set while an array takes over the existing contents, so they are not
+    // overwritten with zeros
+    bool adopting = false;
+
+    ~MappedFile();
+};
+
+// Function to open (with writeBack, create) a file to map arrays from.
+// Returns null on failure.
+std::shared_ptr<MappedFile> openMappedFile(const std::string& path, bool writeBack);
+
+// Function to map the first bytes of the file, growing it if needed. Without
+// writeBack, bytes past the end of the file come from anonymous memory.
+// Returns null on failure.
+void* mapFileRegion(MappedFile& file, size_t bytes);
+
+// Function to unmap a region returned by mapFileRegion
+void unmapFileRegion(void* region, size_t bytes);
+
+// Function to cut a file opened with writeBack to the given size
+bool truncateMappedFile(MappedFile& file, size_t bytes);
+
+// Function to write the dirty pages of a region back to its file
+bool syncFileRegion(void* region, size_t bytes);
+
+enum class StorageAdvice {
+    Normal,
+    // Pages will be read in order: read ahead more, drop pages behind
+    Sequential,
+    Random,
+    // Pages will be needed soon: start reading them in now
+    WillNeed
+};
+
+// Function to pass access advice for a byte range of a region to the OS
+void adviseFileRegion(const void* region, size_t bytes, StorageAdvice advice);
+
+template <typename T>
+class StorageAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using is_always_equal = std::false_type;
+
+    StorageAllocator() = default;
+    explicit StorageAllocator(std::shared_ptr<MappedFile> mappedFile) : file(std::move(mappedFile)) {}
+    template <typename U>
+    StorageAllocator(const StorageAllocator<U>& other) : file(other.file) {}
+
+    T* allocate(size_t n) {
+        if (!file) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        void* region = mapFileRegion(*file, n * sizeof(T));
+        if (!region) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(region);
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (!file) {
+            ::operator delete(p);
+        } else {
+            unmapFileRegion(p, n * sizeof(T));
+        }
+    }
+
+    // Copies of an array go to the heap rather than to the same file
+    StorageAllocator select_on_container_copy_construction() const { return StorageAllocator(); }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void construct(U* p) {
+        if (file && file->adopting) {
+            ::new (static_cast<void*>(p)) U;
+        } else {
+            ::new (static_cast<void*>(p)) U();
+        }
+    }
+
+    template <typename U>
+    bool operator==(const StorageAllocator<U>& other) const { return file == other.file; }
+    template <typename U>
+    bool operator!=(const StorageAllocator<U>& other) const { return file != other.file; }
+
+    // Null for heap storage
+    std::shared_ptr<MappedFile> file;
+};
+
+template <typename T>
+using StorageVector = std::vector<T, StorageAllocator<T>>;
+
+template <typename T>
+bool isMappedArray(const StorageVector<T>& array) {
+    return static_cast<bool>(array.get_allocator().file);
+}
+
+// Function to back array with a file of raw records, taking over its
+// contents (array's own contents are dropped). A file that does not exist
+// is created empty with writeBack.
+template <typename T>
+bool openMappedArray(const std::string& path, StorageVector<T>& array, bool writeBack) {
+    static_assert(std::is_trivially_copyable<T>::value, "mapped arrays hold raw records");
+    std::shared_ptr<MappedFile> file = openMappedFile(path, writeBack);
+    if (!file) {
+        return false;
+    }
+    StorageVector<T> mapped{StorageAllocator<T>(file)};
+    file->adopting = true;
+    mapped.resize(file->size / sizeof(T));
+    file->adopting = false;
+    array = std::move(mapped);
+    return true;
+}
+
+// Function to move array into a new file at path, which it is then mapped from
+template <typename T>
+bool storeMappedArray(const std::string& path, StorageVector<T>& array) {
+    static_assert(std::is_trivially_copyable<T>::value, "mapped arrays hold raw records");
+    std::shared_ptr<MappedFile> file = openMappedFile(path, true);
+    if (!file || !truncateMappedFile(*file, 0)) {
+        return false;
+    }
+    StorageVector<T> mapped{StorageAllocator<T>(file)};
+    mapped.reserve(array.size());
+    mapped.assign(array.begin(), array.end());
+    array = std::move(mapped);
+    return true;
+}
+
+// Function to write the edits of a mapped array back to its file
+template <typename T>
+bool syncMappedArray(StorageVector<T>& array) {
+    if (!isMappedArray(array) || !array.get_allocator().file->writeBack || array.empty()) {
+        return true;
+    }
+    return syncFileRegion(array.data(), array.size() * sizeof(T));
+}
+
+// Function to unmap array, leaving it empty on the heap. With writeBack the
+// file is cut to the array's size, dropping any spare capacity.
+template <typename T>
+bool closeMappedArray(StorageVector<T>& array) {
+    std::shared_ptr<MappedFile> file = array.get_allocator().file;
+    if (!file) {
+        return true;
+    }
+    size_t bytes = array.size() * sizeof(T);
+    bool synced = syncMappedArray(array);
+    array = StorageVector<T>();
+    return synced && (!file->writeBack || truncateMappedFile(*file, bytes));
+}
+
+// Function to give array the contents of source. A heap array swaps with it;
+// a mapped array copies them in and keeps its file.
+template <typename T>
+void takeArrayContents(StorageVector<T>& array, StorageVector<T>& source) {
+    if (isMappedArray(array)) {
+        array.assign(source.begin(), source.end());
+    } else {
+        array.swap(source);
+    }
+}
+
+// Function to move a mapped array onto the heap. Its edits are written back
+// first, so the file keeps the array as it was at this point.
+template <typename T>
+bool moveArrayToHeap(StorageVector<T>& array) {
+    if (!isMappedArray(array)) {
+        return true;
+    }
+    StorageVector<T> heap(array.begin(), array.end());
+    bool closed = closeMappedArray(array);
+    array = std::move(heap);
+    return closed;
+}
+
+// Function to advise the OS how count elements from first will be accessed.
+// Sequential kernels call this before their pass; on heap storage it does
+// nothing.
+template <typename T>
+void adviseArray(const StorageVector<T>& array, StorageAdvice advice, size_t first = 0,
+                 size_t count = std::numeric_limits<size_t>::max()) {
+    if (!isMappedArray(array) || first >= array.size()) {
+        return;
+    }
+    count = std::min(count, array.size() - first);
+    adviseFileRegion(array.data() + first, count * sizeof(T), advice);
+}
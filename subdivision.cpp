@@ -0,0 +1,428 @@
+#include "subdivision.h"
+#include "halfedge.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Connectivity carried from level to level. Half-edge 3f + k runs from corner
+// k to corner k + 1 of face f, as in HalfEdgeMesh, so next and prev are
+// implicit; twin is -1 on boundary and non-manifold edges.
+struct SubdivisionTopology {
+    std::vector<int> twin;
+    // Outgoing half-edge per vertex, the boundary one if there is one
+    std::vector<int> vertexHalfEdge;
+    // Loop only: unique edge id of every half-edge
+    std::vector<int> halfEdgeEdge;
+    size_t edgeCount = 0;
+};
+
+static int faceCorner(const Face& face, int k) {
+    return k == 0 ? face.v1 : (k == 1 ? face.v2 : face.v3);
+}
+
+static int nextHalfEdge(int h) {
+    return h - h % 3 + (h % 3 + 1) % 3;
+}
+
+static int prevHalfEdge(int h) {
+    return h - h % 3 + (h % 3 + 2) % 3;
+}
+
+// A half-edge owns its edge when it has no twin or the smaller index
+static bool ownsEdge(const std::vector<int>& twin, int h) {
+    return twin[h] < 0 || h < twin[h];
+}
+
+static void accumulate(Vertex& sum, const Vertex& v, float weight) {
+    sum.x += v.x * weight;
+    sum.y += v.y * weight;
+    sum.z += v.z * weight;
+}
+
+// Sum of the one-ring around v; an open fan also reports its two boundary neighbors
+struct OneRing {
+    Vertex sum = {0, 0, 0};
+    int valence = 0;
+    bool open = false;
+    int firstNeighbor = -1;
+    int lastNeighbor = -1;
+};
+
+static OneRing gatherOneRing(const VertexArray& vertices, const FaceArray& faces,
+                             const SubdivisionTopology& topology, int v) {
+    OneRing ring;
+    const int start = topology.vertexHalfEdge[v];
+    int h = start;
+    ring.firstNeighbor = faceCorner(faces[h / 3], (h % 3 + 1) % 3);
+    const size_t limit = topology.twin.size();
+    for (size_t steps = 0; steps <= limit; ++steps) {
+        int neighbor = faceCorner(faces[h / 3], (h % 3 + 1) % 3);
+        accumulate(ring.sum, vertices[neighbor], 1.0f);
+        ring.valence++;
+
+        int following = topology.twin[prevHalfEdge(h)];
+        if (following < 0) {
+            // Open fan: the last neighbor sits across the closing boundary edge
+            ring.lastNeighbor = faceCorner(faces[h / 3], (h % 3 + 2) % 3);
+            accumulate(ring.sum, vertices[ring.lastNeighbor], 1.0f);
+            ring.valence++;
+            ring.open = true;
+            return ring;
+        }
+        if (following == start) {
+            return ring;
+        }
+        h = following;
+    }
+    return ring;
+}
+
+// Function to number the unique edges, owners first, then copy ids to twins
+static size_t assignEdgeIds(const std::vector<int>& twin, std::vector<int>& halfEdgeEdge) {
+    const size_t halfEdgeCount = twin.size();
+    const size_t grain = 1 << 16;
+    const size_t blockCount = std::max<size_t>(1, (halfEdgeCount + grain - 1) / grain);
+    std::vector<size_t> blockOffsets(blockCount + 1, 0);
+    halfEdgeEdge.resize(halfEdgeCount);
+
+    parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t count = 0;
+            for (size_t h = b * grain; h < std::min(halfEdgeCount, (b + 1) * grain); ++h) {
+                count += ownsEdge(twin, static_cast<int>(h)) ? 1 : 0;
+            }
+            blockOffsets[b + 1] = count;
+        }
+    });
+    for (size_t b = 0; b < blockCount; ++b) {
+        blockOffsets[b + 1] += blockOffsets[b];
+    }
+    parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            int id = static_cast<int>(blockOffsets[b]);
+            for (size_t h = b * grain; h < std::min(halfEdgeCount, (b + 1) * grain); ++h) {
+                if (ownsEdge(twin, static_cast<int>(h))) {
+                    halfEdgeEdge[h] = id++;
+                }
+            }
+        }
+    });
+    parallelFor(halfEdgeCount, 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t h = begin; h < end; ++h) {
+            if (!ownsEdge(twin, static_cast<int>(h))) {
+                halfEdgeEdge[h] = halfEdgeEdge[twin[h]];
+            }
+        }
+    });
+    return blockOffsets[blockCount];
+}
+
+// Function to derive the level-0 connectivity from the indexed faces
+static void buildTopology(size_t vertexCount, const FaceArray& faces, bool withEdges, SubdivisionTopology& topology) {
+    HalfEdgeMesh mesh = buildHalfEdgeMesh(vertexCount, faces);
+    topology.twin.assign(mesh.twin.begin(), mesh.twin.end());
+    topology.vertexHalfEdge.assign(mesh.vertexHalfEdge.begin(), mesh.vertexHalfEdge.end());
+    if (withEdges) {
+        topology.edgeCount = assignEdgeIds(topology.twin, topology.halfEdgeEdge);
+    }
+}
+
+// Function to run one Loop level; outTopology may be null on the last level
+static void loopLevel(const VertexArray& vertices, const FaceArray& faces, const SubdivisionTopology& topology,
+                      VertexArray& outVertices, FaceArray& outFaces, SubdivisionTopology* outTopology) {
+    const size_t vertexCount = vertices.size();
+    const size_t faceCount = faces.size();
+    const size_t edgeCount = topology.edgeCount;
+    outVertices.resize(vertexCount + edgeCount);
+    outFaces.resize(faceCount * 4);
+    if (outTopology) {
+        outTopology->twin.resize(faceCount * 12);
+        outTopology->halfEdgeEdge.resize(faceCount * 12);
+        outTopology->vertexHalfEdge.resize(vertexCount + edgeCount);
+        outTopology->edgeCount = edgeCount * 2 + faceCount * 3;
+    }
+
+    // Vertex points
+    parallelFor(vertexCount, 1 << 12, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            int h = topology.vertexHalfEdge[v];
+            if (outTopology) {
+                // The first half of an outgoing half-edge keeps its boundary status
+                outTopology->vertexHalfEdge[v] = (h < 0) ? -1 : 3 * (4 * (h / 3) + h % 3);
+            }
+            if (h < 0) {
+                outVertices[v] = vertices[v];
+                continue;
+            }
+
+            OneRing ring = gatherOneRing(vertices, faces, topology, static_cast<int>(v));
+            Vertex result = {0, 0, 0};
+            if (ring.open) {
+                accumulate(result, vertices[v], 0.75f);
+                accumulate(result, vertices[ring.firstNeighbor], 0.125f);
+                accumulate(result, vertices[ring.lastNeighbor], 0.125f);
+            } else {
+                float n = static_cast<float>(ring.valence);
+                float c = 0.375f + 0.25f * std::cos(2.0f * 3.14159265f / n);
+                float beta = (0.625f - c * c) / n;
+                accumulate(result, vertices[v], 1.0f - n * beta);
+                accumulate(result, ring.sum, beta);
+            }
+            outVertices[v] = result;
+        }
+    });
+
+    // Edge points, written by the owning half-edge
+    parallelFor(faceCount * 3, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int h = static_cast<int>(i);
+            if (!ownsEdge(topology.twin, h)) {
+                continue;
+            }
+            const Face& face = faces[h / 3];
+            const int k = h % 3;
+            const Vertex& a = vertices[faceCorner(face, k)];
+            const Vertex& b = vertices[faceCorner(face, (k + 1) % 3)];
+            const int edge = topology.halfEdgeEdge[h];
+            const int t = topology.twin[h];
+
+            Vertex result = {0, 0, 0};
+            if (t < 0) {
+                accumulate(result, a, 0.5f);
+                accumulate(result, b, 0.5f);
+            } else {
+                accumulate(result, a, 0.375f);
+                accumulate(result, b, 0.375f);
+                accumulate(result, vertices[faceCorner(face, (k + 2) % 3)], 0.125f);
+                accumulate(result, vertices[faceCorner(faces[t / 3], (t % 3 + 2) % 3)], 0.125f);
+            }
+            outVertices[vertexCount + edge] = result;
+            if (outTopology) {
+                // Second half of the owner; boundary if the edge was
+                outTopology->vertexHalfEdge[vertexCount + edge] = 3 * (4 * (h / 3) + (k + 1) % 3) + 2;
+            }
+        }
+    });
+
+    // Children of face f: (a, e0, e2), (b, e1, e0), (c, e2, e1), (e0, e1, e2).
+    // Old half-edge k splits into child k's half-edge 0 and child (k + 1) % 3's half-edge 2.
+    parallelFor(faceCount, 1 << 13, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            const Face& face = faces[f];
+            const int base = static_cast<int>(f * 3);
+            const int e0 = static_cast<int>(vertexCount) + topology.halfEdgeEdge[base];
+            const int e1 = static_cast<int>(vertexCount) + topology.halfEdgeEdge[base + 1];
+            const int e2 = static_cast<int>(vertexCount) + topology.halfEdgeEdge[base + 2];
+            outFaces[f * 4 + 0] = {face.v1, e0, e2};
+            outFaces[f * 4 + 1] = {face.v2, e1, e0};
+            outFaces[f * 4 + 2] = {face.v3, e2, e1};
+            outFaces[f * 4 + 3] = {e0, e1, e2};
+            if (!outTopology) {
+                continue;
+            }
+
+            std::vector<int>& twin = outTopology->twin;
+            std::vector<int>& edgeIds = outTopology->halfEdgeEdge;
+            auto child = [](size_t face, int c, int k) { return static_cast<int>(3 * (4 * face + c) + k); };
+            const int inner = static_cast<int>(edgeCount * 2 + f * 3);
+            const int innerPairs[3][2] = {{child(f, 0, 1), child(f, 3, 2)},
+                                          {child(f, 1, 1), child(f, 3, 0)},
+                                          {child(f, 2, 1), child(f, 3, 1)}};
+            for (int j = 0; j < 3; ++j) {
+                twin[innerPairs[j][0]] = innerPairs[j][1];
+                twin[innerPairs[j][1]] = innerPairs[j][0];
+                edgeIds[innerPairs[j][0]] = edgeIds[innerPairs[j][1]] = inner + j;
+            }
+
+            for (int k = 0; k < 3; ++k) {
+                const int h = base + k;
+                const int t = topology.twin[h];
+                const int firstHalf = child(f, k, 0);
+                const int secondHalf = child(f, (k + 1) % 3, 2);
+                if (t < 0) {
+                    twin[firstHalf] = twin[secondHalf] = -1;
+                } else {
+                    const size_t g = t / 3;
+                    const int j = t % 3;
+                    twin[firstHalf] = child(g, (j + 1) % 3, 2);
+                    twin[secondHalf] = child(g, j, 0);
+                }
+                // The half next to the owner's origin gets the even id
+                const int edge = topology.halfEdgeEdge[h];
+                const bool owner = ownsEdge(topology.twin, h);
+                edgeIds[firstHalf] = 2 * edge + (owner ? 0 : 1);
+                edgeIds[secondHalf] = 2 * edge + (owner ? 1 : 0);
+            }
+        }
+    });
+}
+
+// Function to run one sqrt(3) level; outTopology may be null on the last level.
+// New face h (one per old half-edge a -> b in face f, twin in face g) is
+// (a, m_g, m_f), or the unflipped (a, b, m_f) when there is no twin.
+static void sqrt3Level(const VertexArray& vertices, const FaceArray& faces, const SubdivisionTopology& topology,
+                       VertexArray& outVertices, FaceArray& outFaces, SubdivisionTopology* outTopology) {
+    const size_t vertexCount = vertices.size();
+    const size_t faceCount = faces.size();
+    const size_t halfEdgeCount = faceCount * 3;
+    outVertices.resize(vertexCount + faceCount);
+    outFaces.resize(halfEdgeCount);
+    if (outTopology) {
+        outTopology->twin.resize(halfEdgeCount * 3);
+        outTopology->vertexHalfEdge.resize(vertexCount + faceCount);
+    }
+
+    // Relaxed old vertices
+    parallelFor(vertexCount, 1 << 12, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            int h = topology.vertexHalfEdge[v];
+            if (outTopology) {
+                outTopology->vertexHalfEdge[v] = (h < 0) ? -1 : 3 * h;
+            }
+            if (h < 0) {
+                outVertices[v] = vertices[v];
+                continue;
+            }
+
+            OneRing ring = gatherOneRing(vertices, faces, topology, static_cast<int>(v));
+            if (ring.open) {
+                outVertices[v] = vertices[v];
+                continue;
+            }
+            float n = static_cast<float>(ring.valence);
+            float alpha = (4.0f - 2.0f * std::cos(2.0f * 3.14159265f / n)) / 9.0f;
+            Vertex result = {0, 0, 0};
+            accumulate(result, vertices[v], 1.0f - alpha);
+            accumulate(result, ring.sum, alpha / n);
+            outVertices[v] = result;
+        }
+    });
+
+    // Face centroids
+    parallelFor(faceCount, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            Vertex centroid = {0, 0, 0};
+            accumulate(centroid, vertices[faces[f].v1], 1.0f / 3.0f);
+            accumulate(centroid, vertices[faces[f].v2], 1.0f / 3.0f);
+            accumulate(centroid, vertices[faces[f].v3], 1.0f / 3.0f);
+            outVertices[vertexCount + f] = centroid;
+            if (outTopology) {
+                // m_f -> first corner in the face of half-edge 3f
+                outTopology->vertexHalfEdge[vertexCount + f] = 3 * static_cast<int>(f * 3) + 2;
+            }
+        }
+    });
+
+    // Flipped faces and their connectivity
+    parallelFor(halfEdgeCount, 1 << 14, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const int h = static_cast<int>(i);
+            const Face& face = faces[h / 3];
+            const int k = h % 3;
+            const int a = faceCorner(face, k);
+            const int t = topology.twin[h];
+            const int centroid = static_cast<int>(vertexCount) + h / 3;
+            if (t >= 0) {
+                outFaces[h] = {a, static_cast<int>(vertexCount) + t / 3, centroid};
+            } else {
+                outFaces[h] = {a, faceCorner(face, (k + 1) % 3), centroid};
+            }
+            if (!outTopology) {
+                continue;
+            }
+
+            std::vector<int>& twin = outTopology->twin;
+            const int prevTwin = topology.twin[prevHalfEdge(h)];
+            twin[3 * h] = (t >= 0) ? 3 * nextHalfEdge(t) + 2 : -1;
+            twin[3 * h + 1] = (t >= 0) ? 3 * t + 1 : 3 * nextHalfEdge(h) + 2;
+            twin[3 * h + 2] = (prevTwin >= 0) ? 3 * prevTwin : 3 * prevHalfEdge(h) + 1;
+        }
+    });
+}
+
+template <typename T, typename Allocator>
+static size_t capacityBytes(const std::vector<T, Allocator>& values) {
+    return values.capacity() * sizeof(T);
+}
+
+// Function to run the levels, ping-ponging between two sets of buffers that
+// are reserved for the largest level they will hold before the first level
+template <typename LevelFn>
+static SubdivisionStats subdivide(VertexArray& vertices, FaceArray& faces, int levels, bool loop, LevelFn level) {
+    SubdivisionStats stats;
+    auto start = std::chrono::steady_clock::now();
+
+    VertexArray positions[2];
+    FaceArray faceLists[2];
+    SubdivisionTopology topologies[2];
+    positions[0].swap(vertices);
+    faceLists[0].swap(faces);
+
+    if (levels > 0) {
+        buildTopology(positions[0].size(), faceLists[0], loop, topologies[0]);
+
+        // Exact sizes of every level: Loop has V + E vertices, 4F faces and 2E + 3F edges,
+        // sqrt(3) has V + F vertices and 3F faces
+        std::vector<size_t> vertexCounts(levels + 1), faceCounts(levels + 1);
+        vertexCounts[0] = positions[0].size();
+        faceCounts[0] = faceLists[0].size();
+        size_t edgeCount = topologies[0].edgeCount;
+        for (int l = 0; l < levels; ++l) {
+            if (loop) {
+                vertexCounts[l + 1] = vertexCounts[l] + edgeCount;
+                faceCounts[l + 1] = faceCounts[l] * 4;
+                edgeCount = edgeCount * 2 + faceCounts[l] * 3;
+            } else {
+                vertexCounts[l + 1] = vertexCounts[l] + faceCounts[l];
+                faceCounts[l + 1] = faceCounts[l] * 3;
+            }
+        }
+
+        for (int b = 0; b < 2; ++b) {
+            // Connectivity is only needed for levels that get subdivided again
+            size_t maxVertices = 0, maxFaces = 0, maxTopologyVertices = 0, maxHalfEdges = 0;
+            for (int l = b; l <= levels; l += 2) {
+                maxVertices = std::max(maxVertices, vertexCounts[l]);
+                maxFaces = std::max(maxFaces, faceCounts[l]);
+                if (l < levels) {
+                    maxTopologyVertices = std::max(maxTopologyVertices, vertexCounts[l]);
+                    maxHalfEdges = std::max(maxHalfEdges, faceCounts[l] * 3);
+                }
+            }
+            positions[b].reserve(maxVertices);
+            faceLists[b].reserve(maxFaces);
+            topologies[b].twin.reserve(maxHalfEdges);
+            topologies[b].vertexHalfEdge.reserve(maxTopologyVertices);
+            if (loop) {
+                topologies[b].halfEdgeEdge.reserve(maxHalfEdges);
+            }
+        }
+        for (int b = 0; b < 2; ++b) {
+            stats.peakBytes += capacityBytes(positions[b]) + capacityBytes(faceLists[b]) + capacityBytes(topologies[b].twin) +
+                               capacityBytes(topologies[b].vertexHalfEdge) + capacityBytes(topologies[b].halfEdgeEdge);
+        }
+
+        for (int l = 0; l < levels; ++l) {
+            const int in = l % 2, out = 1 - in;
+            level(positions[in], faceLists[in], topologies[in], positions[out], faceLists[out],
+                  (l + 1 < levels) ? &topologies[out] : nullptr);
+        }
+    }
+
+    const int result = levels > 0 ? levels % 2 : 0;
+    vertices.swap(positions[result]);
+    faces.swap(faceLists[result]);
+    stats.vertexCount = vertices.size();
+    stats.faceCount = faces.size();
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+SubdivisionStats loopSubdivide(VertexArray& vertices, FaceArray& faces, int levels) {
+    return subdivide(vertices, faces, levels, true, loopLevel);
+}
+
+SubdivisionStats sqrt3Subdivide(VertexArray& vertices, FaceArray& faces, int levels) {
+    return subdivide(vertices, faces, levels, false, sqrt3Level);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "mesh.h"
+
+// Result of a subdivision run
+struct SubdivisionStats {
+    size_t vertexCount = 0;
+    size_t faceCount = 0;
+    // Bytes held by every position, face and connectivity buffer at the peak
+    size_t peakBytes = 0;
+    double milliseconds = 0.0;
+};
+
+// Function to apply levels of Loop subdivision in place: every face splits
+// into four, edge points take 3/8 of the edge ends and 1/8 of the opposite
+// corners, and old vertices move by Loop's beta weights (boundaries use the
+// cubic B-spline rule). Each level has exactly V + E vertices and 4F faces.
+// Connectivity is derived once and then carried analytically from level to
+// level, and all buffers are sized for the final level before the first one
+// runs, so no level reallocates. Non-manifold edges are treated as boundaries.
+SubdivisionStats loopSubdivide(VertexArray& vertices, FaceArray& faces, int levels);
+
+// Function to apply levels of sqrt(3) subdivision in place (Kobbelt): a
+// centroid is inserted in every face, old edges are flipped to connect
+// neighboring centroids, and interior old vertices are relaxed. Each level has
+// exactly V + F vertices and 3F faces. Boundary edges are kept rather than
+// using the alternating boundary rule, and boundary vertices stay fixed.
+SubdivisionStats sqrt3Subdivide(VertexArray& vertices, FaceArray& faces, int levels);
@@ -0,0 +1,155 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+std::atomic<bool> traceActive{false};
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// One thread's events. The owning thread is the only writer; the lock is
+// uncontended except while the trace is being written out.
+struct TraceBuffer {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint64_t recorded = 0; // events[recorded % kTraceBufferEvents] is written next
+    const char* threadName = nullptr;
+    unsigned int threadId = 0;
+};
+
+// Buffers are shared with the registry, so events outlive the threads that recorded them
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+static TraceRegistry& traceRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+static thread_local std::shared_ptr<TraceBuffer> threadBuffer;
+static thread_local const char* threadName = nullptr;
+
+static TraceBuffer& currentTraceBuffer() {
+    if (!threadBuffer) {
+        auto buffer = std::make_shared<TraceBuffer>();
+        buffer->events.resize(kTraceBufferEvents);
+        buffer->threadName = threadName;
+        TraceRegistry& registry = traceRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffer->threadId = static_cast<unsigned int>(registry.buffers.size()) + 1;
+        registry.buffers.push_back(buffer);
+        threadBuffer = std::move(buffer);
+    }
+    return *threadBuffer;
+}
+
+void setTraceEnabled(bool enabled) {
+    traceRegistry();
+    traceActive.store(enabled, std::memory_order_relaxed);
+}
+
+void setTraceThreadName(const char* name) {
+    threadName = name;
+    if (threadBuffer) {
+        std::lock_guard<std::mutex> lock(threadBuffer->mutex);
+        threadBuffer->threadName = name;
+    }
+}
+
+uint64_t traceNow() {
+    auto elapsed = std::chrono::steady_clock::now() - traceRegistry().epoch;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void recordTraceEvent(const char* name, uint64_t startNanoseconds, uint64_t endNanoseconds) {
+    TraceBuffer& buffer = currentTraceBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events[buffer.recorded % kTraceBufferEvents] = {name, startNanoseconds, endNanoseconds};
+    buffer.recorded++;
+}
+
+// Function to write s as a JSON string
+static void writeJSONString(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        char c = *s;
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+bool writeChromeTrace(const std::string& filename) {
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    {
+        TraceRegistry& registry = traceRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffers = registry.buffers;
+    }
+
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    size_t dropped = 0;
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if (buffer->threadName) {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"args\":{\"name\":";
+            writeJSONString(out, buffer->threadName);
+            out << "}}";
+            first = false;
+        }
+
+        // Oldest first: once the ring has wrapped, the oldest event sits at the write position
+        uint64_t kept = std::min<uint64_t>(buffer->recorded, kTraceBufferEvents);
+        dropped += static_cast<size_t>(buffer->recorded - kept);
+        for (uint64_t i = buffer->recorded - kept; i < buffer->recorded; ++i) {
+            const TraceEvent& event = buffer->events[i % kTraceBufferEvents];
+            // Chrome wants microseconds
+            out << (first ? "" : ",") << "\n{\"name\":";
+            writeJSONString(out, event.name);
+            out << ",\"cat\":\"mesh\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+
+    if (dropped > 0) {
+        std::cerr << "Trace buffers wrapped: dropped the oldest " << dropped << " events." << std::endl;
+    }
+    if (filename == "-") {
+        std::cout << out.str();
+        return true;
+    }
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    file << out.str();
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped timers for finding out where the time goes. Every thread that
+// records gets its own fixed-size ring buffer (the oldest events are dropped
+// when it wraps), so recording never contends with other threads. While
+// tracing is off a scope costs one relaxed load; building with
+// MESH_TRACE_DISABLED removes the scopes altogether.
+
+// Events kept per thread before the oldest are overwritten
+const size_t kTraceBufferEvents = 1 << 15;
+
+extern std::atomic<bool> traceActive;
+
+inline bool traceEnabled() {
+    return traceActive.load(std::memory_order_relaxed);
+}
+
+// Function to start or stop recording
+void setTraceEnabled(bool enabled);
+
+// Function to name the calling thread in the trace. name must outlive the trace.
+void setTraceThreadName(const char* name);
+
+// Nanoseconds on the trace clock
+uint64_t traceNow();
+
+// Function to record a finished span on the calling thread. name must outlive the trace.
+void recordTraceEvent(const char* name, uint64_t startNanoseconds, uint64_t endNanoseconds);
+
+// Function to write every recorded span as Chrome trace-event JSON (for
+// chrome://tracing or Perfetto). Writes to standard output if filename is "-".
+bool writeChromeTrace(const std::string& filename);
+
+// Records the time between its construction and destruction
+struct TraceScope {
+    const char* name;
+    uint64_t start;
+
+    explicit TraceScope(const char* scopeName) : name(traceEnabled() ? scopeName : nullptr), start(name ? traceNow() : 0) {}
+    ~TraceScope() {
+        if (name) {
+            recordTraceEvent(name, start, traceNow());
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define MESH_TRACE_CONCAT_INNER(a, b) a##b
+#define MESH_TRACE_CONCAT(a, b) MESH_TRACE_CONCAT_INNER(a, b)
+
+#if defined(MESH_TRACE_DISABLED)
+#define TRACE_SCOPE(name) ((void)0)
+#else
+#define TRACE_SCOPE(name) TraceScope MESH_TRACE_CONCAT(traceScope, __LINE__)(name)
+#endif